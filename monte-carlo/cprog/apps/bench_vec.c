@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/**********************************************************/
+/* Micro-benchmark of the vector API: Out-of-line calls   */
+/* of 'vector.c' against the inline 'vector_inline.h',    */
+/* and the box intersections built on them. Build once    */
+/* with -DVECTOR_INLINE=OFF to see the out-of-line        */
+/* geometry.                                              */
+/**********************************************************/
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sphere/sphere.h"
+#include "rng/rng.h"
+#include "vector/vector_inline.h"
+#include "geometry/geometry.h"
+
+/* Prototypes */
+static void usage(const char* name);
+static double now_ns(void);
+
+/* Implementations */
+static void usage(const char* name)
+{
+   printf("Usage:\n%s [-e <num>] [-h]\n", name);
+   printf("\n-- Options:\n");
+   printf("-e <num>    : Set the number of lines per pass. (Default is 100,000)\n");
+   printf("-h          : Print this help text.\n");
+}
+
+static double now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return 1.0E9 * (double)ts.tv_sec + (double)ts.tv_nsec;
+}
+
+/* Main */
+int main(int argc, char *argv[])
+{
+   const int passes = 20;
+   int       total = 100000;
+   int       c, i, p, n;
+
+   opterr = 0;
+   while ((c = getopt (argc, argv, "e:h")) != -1)
+      switch (c)
+      {
+      case 'e':
+         total = atoi(optarg);
+         break;
+      case 'h':
+         usage(argv[0]);
+         return 0;
+      case '?':
+         if (strchr("e", optopt) != 0)
+            fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+         else if (isprint (optopt))
+            fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+         else
+            fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+         return 1;
+      default:
+         abort();
+      }
+
+   if (total <= 0)
+   {
+      fprintf(stderr, "Number of lines must be positive: %d\n", total);
+      return 1;
+   }
+
+   /* Lines through the unit cube around a tilted box */
+   g_line         *lines = (g_line*)malloc(sizeof(g_line)*total);
+   rng_stream     rng;
+   g_box          box;
+   g_box_prepared box_p;
+   const vec3     e1 = { 1.0, 0.0, 0.0 };
+   const vec3     e2 = { 0.0, 1.0, 0.0 };
+   const vec3     e3 = { 0.0, 0.0, 1.0 };
+   const vec3     axis = { 0.0, 0.6, 0.8 };
+
+   rng_seed(&rng, rng_default_seed, 0);
+   for (i = 0; i < total; ++i)
+   {
+      double cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+
+      for (n = 0; n < 3; ++n)
+         lines[i].origin[n] = rng_uniform(&rng) - 0.5;
+      lines[i].direction[0] = sin_t * cos(phi);
+      lines[i].direction[1] = sin_t * sin(phi);
+      lines[i].direction[2] = cos_t;
+   }
+
+   rotate_vec(box.edge1, e1, axis, 0.4);
+   rotate_vec(box.edge2, e2, axis, 0.4);
+   rotate_vec(box.edge3, e3, axis, 0.4);
+   box.origin[0] = 0.05;
+   box.origin[1] = -0.1;
+   box.origin[2] = 0.0;
+   box.edge1_len = 0.2;
+   box.edge2_len = 0.3;
+   box.edge3_len = 0.1;
+   prepare_box(&box_p, &box);
+
+   /* Dot products of neighbouring directions */
+   {
+      double sum[2] = { 0.0, 0.0 };
+      double t[3];
+
+      t[0] = now_ns();
+      for (p = 0; p < passes; ++p)
+         for (i = 1; i < total; ++i)
+            sum[0] += (dot_vec)(lines[i].direction, lines[i - 1].direction);
+      t[1] = now_ns();
+      for (p = 0; p < passes; ++p)
+         for (i = 1; i < total; ++i)
+            sum[1] += dot_vec_inline(lines[i].direction, lines[i - 1].direction);
+      t[2] = now_ns();
+
+      printf("dot_vec out-of-line : %.2f ns\n", (t[1] - t[0]) / ((double)passes * total));
+      printf("dot_vec inline      : %.2f ns\n", (t[2] - t[1]) / ((double)passes * total));
+      if (sum[0] != sum[1])
+      {
+         fprintf(stderr, "Different sums: %e %e\n", sum[0], sum[1]);
+         return 1;
+      }
+   }
+
+   /* Box intersections, on the vector API of the build */
+   {
+      double tr[2], l1[2], l2[2], l3[2];
+      int    hit, hits[2] = { 0, 0 };
+      double t[3];
+
+      t[0] = now_ns();
+      for (p = 0; p < passes; ++p)
+         for (i = 0; i < total; ++i)
+         {
+            intersect_box(lines[i], box, tr, &hit, l1, l2, l3);
+            hits[0] += hit;
+         }
+      t[1] = now_ns();
+      for (p = 0; p < passes; ++p)
+         for (i = 0; i < total; ++i)
+         {
+            intersect_box_prepared(&lines[i], &box_p, tr, &hit, l1, l2, l3);
+            hits[1] += hit;
+         }
+      t[2] = now_ns();
+
+      printf("intersect_box          : %.2f ns (%d crossings)\n", (t[1] - t[0]) / ((double)passes * total), hits[0]);
+      printf("intersect_box_prepared : %.2f ns (%d crossings)\n", (t[2] - t[1]) / ((double)passes * total), hits[1]);
+   }
+
+   free(lines);
+
+   return 0;
+}
@@ -22,6 +22,7 @@
 
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,6 +37,9 @@
 #include "gun/gun_iso.h"
 #include "gun/gun_pdg.h"
 #include "gun/gun_range.h"
+#include "gun/gun_table.h"
+#include "gun/gun_energy.h"
+#include "strata/strata.h"
 
 /* Prototypes */
 static void usage(const char* name);
@@ -43,22 +47,39 @@ static void usage(const char* name);
 /* Implementations */
 static void usage(const char* name)
 {
-   printf("Usage:\n%s [-d <double>] [-e <num>] [-f <num>] [-h] [-l <double>] [-t >double>] [-w <double>] <theta>\n", name);
+   printf("Usage:\n%s [-a <num>] [-d <double>] [-e <num>] [-f <num>] [-g <num>] [-h] [-l <double>] [-n] [-q <num>] [-S <num>] [-t >double>] [-w <double>] <theta>\n", name);
    printf("\n-- Options:\n");
+   printf("-a <num>    : Set the arithmetic of the intersections. (Default is 0)\n");
+   printf("              0 = Double precision.\n");
+   printf("              1 = Single precision. (Twice the vector lanes)\n");
+   printf("              2 = Both: Count in double precision, report the difference of single precision.\n");
    printf("-b <num>    : Set number of bins. Default is 100.\n");
+   printf("-c <path>   : Cache file for the tables of the spectra with energy. (Default is none)\n");
    printf("-d <double> : Set the depth of the detector [m]. (Default is 0.01 m)\n");
    printf("-e <num>    : Set the number of events to simulate. (Default is 1,000,000)\n");
    printf("-f <num>    : Set the simulated flux of particle. (Default is 0 = PDG)\n");
    printf("              0 = PDG flux. (~ cos^2 theta)\n");
    printf("              1 = Isotropic flux.\n");
+   printf("              2 = Point source at zenith. (Tabulated)\n");
+   printf("              3 = Sea level spectrum of Reyna, with energy. (Tabulated)\n");
+   printf("              4 = Sea level spectrum of Gaisser, with energy. (Tabulated)\n");
+   printf("-g <num>    : Stratify the events into <num> parts of each of x, y, cos(theta) and phi. (Default is not to)\n");
    printf("-h          : Print this help text.\n");
    printf("-l <double> : Set the (longer) length of the detector [m]. (Default is 0.1 m)\n");
    printf("-o <double> : Set the 'world' scaled length relative to detector length. (Default is 8.0)\n");
    printf("-p <type>   : Save histogram data for given type. (Default is 0 = 'none')\n");
    printf("              bit0 = hit (x,y) at center plane of detector (normal=up)\n");
    printf("              bit1 = track length inside of detector\n");
+   printf("-m <double> : Set the minimal energy of the muons of the spectra with energy [GeV]. (Default is 1.0 GeV)\n");
+   printf("-n          : With strata, reallocate 90%% of the events by the variances of a pilot pass (Neyman).\n");
+   printf("-q <num>    : Use quasi-random (scrambled Sobol) events in <num> independent replicas. (Default is pseudo-random)\n");
+   printf("              The error is taken from the spread of the replicas. Needs <num> >= 2, not with '-r'.\n");
+   printf("-r          : Apply the 'foreshortening' rule by rejecting events. (Default is to sample it directly)\n");
+   printf("-S <num>    : Seed of all random streams, quasi-random replicas and strata, e.g. 0x1F for independent runs.\n");
+   printf("              (Default is the library default)\n");
    printf("-t <double> : Set the minimal length of the track 'inside' the solid to count as a 'hit' [m]. (Default is 0.003)\n");
    printf("-u          : Disable 'foreshortening' rule on particles. (Default is to use it)\n");
+   printf("-x          : Latin hypercube sampling inside of the strata. The error is then an upper bound.\n");
    printf("-w <double> : Set the (shorter) width of the detector [m]. (Default is 0.1 m)\n");
    printf("\n-- Positional arguments:\n");
    printf("<theta>          : Angle to zenith [radians].\n");
@@ -69,6 +90,7 @@ int main(int argc, char *argv[])
 {
    const int bins_xy = 31;
    const double total_rate_per_m2 = mu_pdg_i * pi / 2.0; /* Hz/m^2 */
+   const double energy_max = 1.0E5; /* GeV */
 
    const int plot_xy = 1<<0;
    const int plot_tr = 1<<1;
@@ -83,7 +105,16 @@ int main(int argc, char *argv[])
    double width = 0.1;
    double track = 0.003;
    int    use_f = 1;
+   int    use_r = 0;
+   int    replicas = 0;
+   int    strata_div = 0;
+   int    neyman = 0;
+   int    lhs = 0;
+   double e_min = 1.0;
+   char   *cache = NULL;
    int bins     = 100;
+   int precision = 0;
+   uint64_t seed = rng_default_seed;
 
    unsigned long bins_X_Y[bins_xy][bins_xy];
 
@@ -91,13 +122,19 @@ int main(int argc, char *argv[])
    int c;
 
    opterr = 0;
-   while ((c = getopt (argc, argv, "b:d:e:f:hl:o:p:t:uw:")) != -1)
+   while ((c = getopt (argc, argv, "a:b:c:d:e:f:g:hl:m:no:p:q:rS:t:uw:x")) != -1)
       switch (c)
       {
+      case 'a':
+         precision = atoi(optarg);
+         break;
       case 'b':
          bins = atoi(optarg);
          printf("Set bin #: %d\n", bins);
          break;
+      case 'c':
+         cache = optarg;
+         break;
       case 'd':
          depth = strtod(optarg, NULL);
          break;
@@ -107,6 +144,9 @@ int main(int argc, char *argv[])
       case 'f':
          flux = atoi(optarg);
          break;
+      case 'g':
+         strata_div = atoi(optarg);
+         break;
       case 'h':
          usage(argv[0]);
          return 0;
@@ -119,6 +159,21 @@ int main(int argc, char *argv[])
       case 'p':
          plot = atoi(optarg);
          break;
+      case 'm':
+         e_min = strtod(optarg, NULL);
+         break;
+      case 'n':
+         neyman = 1;
+         break;
+      case 'q':
+         replicas = atoi(optarg);
+         break;
+      case 'r':
+         use_r = 1;
+         break;
+      case 'S':
+         seed = strtoull(optarg, NULL, 0);
+         break;
       case 't':
          track = strtod(optarg, NULL);
          break;
@@ -128,8 +183,11 @@ int main(int argc, char *argv[])
       case 'w':
          width = strtod(optarg, NULL);
          break;
+      case 'x':
+         lhs = 1;
+         break;
       case '?':
-         if (strchr("deflptw", optopt) != 0)
+         if (strchr("acdefglmpqStw", optopt) != 0)
             fprintf(stderr, "Option -%c requires an argument.\n", optopt);
          else if (isprint (optopt))
             fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -153,6 +211,34 @@ int main(int argc, char *argv[])
 
    memset(bins_tr, 0, sizeof(unsigned long)*bins);
    
+   if ((replicas == 1) || (replicas < 0) || ((replicas > 0) && use_r))
+   {
+      fprintf(stderr, "Quasi-random mode needs at least 2 replicas and no rejection.\n");
+      return 1;
+   }
+
+   if ((replicas > 0) && (total < replicas))
+   {
+      fprintf(stderr, "Quasi-random mode needs at least one event per replica.\n");
+      return 1;
+   }
+
+   if ((precision < 0) || (precision > 2))
+   {
+      fprintf(stderr, "Unknown arithmetic: %d\n", precision);
+      return 1;
+   }
+
+   /* Latin hypercube alone is a single stratum */
+   if (lhs && (strata_div == 0))
+      strata_div = 1;
+
+   if ((strata_div < 0) || ((strata_div > 0) && (use_r || (replicas > 0))))
+   {
+      fprintf(stderr, "Stratified sampling does not work with rejection or quasi-random mode.\n");
+      return 1;
+   }
+
    /* Read positional arguments */
    type = 0;
    for (index = optind; index < argc; index++)
@@ -171,6 +257,8 @@ int main(int argc, char *argv[])
 
    /* Detector box setup */
    g_box  box;
+   g_box_prepared box_p;
+   g_box_prepared_f box_f;
 
    /* World edge's normal */
    double w_n[3];
@@ -183,31 +271,61 @@ int main(int argc, char *argv[])
    gun_ctx contextL = NULL;
    gun_ctx contextW = NULL;
 
+   /* Return coordinate on 'world' edge = larger than solid size */
+   contextL = gun_range_init(-length*(world_scale/2.0), length*(world_scale/2.0));
+   contextW = gun_range_init(-width*(world_scale/2.0), width*(world_scale/2.0));
+
+   rate_w = total_rate_per_m2 * (length * world_scale) * (width * world_scale);
+
+   /* World's edge normal points up to zenith */
+   w_n[x_c] = 0.0;
+   w_n[y_c] = 0.0;
+   w_n[z_c] = 1.0;
+
    if (flux == 0)
    {
       /* Set PDFs for particle gun */
-      /* Return theta = 0, cos(theta) = 1 */
-      contextI = gun_pdg_init(0);
+      if (use_f && !use_r)
+         contextI = gun_pdg_flux_init(w_n);
+      else
+         contextI = gun_pdg_dir_init();
       flux_scale = 1.0;
    }
    if (flux == 1)
    {
       /* Set PDFs for particle gun */
-      /* Return theta = 0, cos(theta) = 1 */
-      contextI = gun_iso_init(0);
+      if (use_f && !use_r)
+         contextI = gun_iso_flux_init(w_n);
+      else
+         contextI = gun_iso_dir_init();
       flux_scale = 1.0;
    }
+   if (flux == 2)
+   {
+      /* Tabulated intensity, sampled with the alias method */
+      contextI = gun_table_init(j_val_ZEN, w_n, (use_f && !use_r), 1024, 256);
+      rate_w = gun_table_norm(contextI) * (length * world_scale) * (width * world_scale);
+      flux_scale = 1.0;
+   }
+   if ((flux == 3) || (flux == 4))
+   {
+      /* Joint direction and energy above e_min */
+      contextI = gun_energy_init((flux == 3) ? 1 : 0, w_n, (use_f && !use_r), e_min, energy_max, cache);
+      if (NULL != contextI)
+         rate_w = gun_energy_norm(contextI) * (length * world_scale) * (width * world_scale);
+      flux_scale = 1.0;
+   }
+   if (NULL == contextI)
+   {
+      fprintf(stderr, "Unknown flux: %d\n", flux);
+      return 1;
+   }
 
-   /* Return coordinate on 'world' edge = larger than solid size */
-   contextL = gun_range_init(-length*(world_scale/2.0), length*(world_scale/2.0));
-   contextW = gun_range_init(-width*(world_scale/2.0), width*(world_scale/2.0));
-
-   rate_w = total_rate_per_m2 * (length * world_scale) * (width * world_scale);
+   /* Streams of the guns: The same as without seed for the default one */
+   gun_seed(contextL, seed, 0);
+   gun_seed(contextW, seed, 1);
+   gun_seed(contextI, seed, 2);
 
-   /* World's edge normal points up to zenith */
-   w_n[x_c] = 0.0;
-   w_n[y_c] = 0.0;
-   w_n[z_c] = 1.0;
 
    /* Detector box setup */
    box.origin[x_c] = 0.0;
@@ -250,6 +368,10 @@ int main(int argc, char *argv[])
    box.edge1_len = length/2.0;
    box.edge2_len = width/2.0;
    box.edge3_len = depth/2.0;
+
+   /* Frame of the box, once for all events */
+   prepare_box(&box_p, &box);
+   prepare_box_f(&box_f, &box_p);
    
    /* Hit counter */
    int    count = 0;
@@ -277,49 +399,166 @@ int main(int argc, char *argv[])
       xy_scale = 1.20*width;
    }
 
+   /* Event data, generated one block at a time */
+   const int block = 4096;
+   double *evt_ux = (double*)malloc(sizeof(double)*block);
+   double *evt_uy = (double*)malloc(sizeof(double)*block);
+   double *evt_uz = (double*)malloc(sizeof(double)*block);
+   double *evt_e = (double*)malloc(sizeof(double)*block);
+   double *evt_x = (double*)malloc(sizeof(double)*block);
+   double *evt_y = (double*)malloc(sizeof(double)*block);
+   double *evt_I[4] = { evt_ux, evt_uy, evt_uz, evt_e };
+
+   /* Single precision: Particles of a block and their track lengths, intersected all at once */
+   float  *evt_f = (float*)malloc(sizeof(float)*6*block);
+   float  *evt_len_f = (float*)malloc(sizeof(float)*block);
+   int    *evt_hit_f = (int*)malloc(sizeof(int)*block);
+   const float *evt_org_f[3] = { evt_f, evt_f + block, evt_f + 2*block };
+   const float *evt_dir_f[3] = { evt_f + 3*block, evt_f + 4*block, evt_f + 5*block };
+
+   /* Cross-check: Hits in single precision, and events with different results */
+   int    count_f = 0;
+   int    count_diff = 0;
+
+   /* Energy of the hits, for the spectra with energy */
+   double sum_e = 0.0;
+   int    k = block;
+
+   /* Quasi-random replicas: Events per replica and spread of their ratios */
+   int    n_rep = total;
+   int    count_rep = 0;
+   double sum_rep = 0.0;
+   double sum2_rep = 0.0;
+
+   if (replicas > 0)
+   {
+      n_rep = total / replicas;
+      total = n_rep * replicas;
+   }
+
+   /* Strata of the joint (x, y, direction) uniform values */
+   strata_ctx strat = NULL;
+   int    pass_end = 0;
+   int    count_tally = 0;
+
+   if (strata_div > 0)
+   {
+      int divs[STRATA_MAX_DIM];
+      int dims = 2 + gun_draws(contextI);
+      int d;
+
+      /* Leading draws of the direction: cos(theta) and phi */
+      for (d = 0; d < dims; d++)
+         divs[d] = (d < 4) ? strata_div : 1;
+
+      strat = strata_init(dims, divs, lhs, seed);
+      d = strata_attach(strat, contextL, 0);
+      d = strata_attach(strat, contextW, d);
+      d = strata_attach(strat, contextI, d);
+      if (d < 0)
+      {
+         fprintf(stderr, "Strata Failure!\n");
+         return 1;
+      }
+   }
+
    int i;
-   for (i=0; i < total; ++i)
+   for (i=0; i < total; ++i, ++k)
    {
-      iso_event evt_i;
-      pdg_event evt_p;
       double    x_0, y_0;
-      double    t, p;
       double    trans[2];
       double    l1[2], l2[2], l3[2];
+      double    track_len = 0.0;
       int       hit, retVal;
 
-      /* Get new event data */
-      if (flux == 0)
+      /* Start the next replica: Joint (x, y, direction) points of one Sobol sequence */
+      if ((replicas > 0) && (i % n_rep == 0))
       {
-         if (0 != gun_event(contextI, evt_p.pars))
+         int d;
+
+         if (i > 0)
          {
-            fprintf(stderr, "PDG PDF Failure!\n");
-            return 1;
+            double r = (double)(count - count_rep)/(double)n_rep;
+
+            sum_rep += r;
+            sum2_rep += r*r;
+            count_rep = count;
          }
-         t = evt_p.out_t.theta;
-         p = evt_p.out_t.phi;
-      }
-      else if (flux == 1)
-      {
-         if (0 != gun_event(contextI, evt_i.pars))
+
+         d = gun_qmc(contextL, seed, (uint64_t)(i / n_rep), 0);
+         d = gun_qmc(contextW, seed, (uint64_t)(i / n_rep), d);
+         d = gun_qmc(contextI, seed, (uint64_t)(i / n_rep), d);
+         if (d < 0)
          {
-            fprintf(stderr, "ISO PDF Failure!\n");
+            fprintf(stderr, "QMC Failure!\n");
             return 1;
          }
-         t = evt_i.out_t.theta;
-         p = evt_i.out_t.phi;
+         k = block;
       }
 
-      if (0 != gun_event(contextL, &x_0))
+      if (NULL != strat)
       {
-         fprintf(stderr, "X0 PDF Failure!\n");
-         return 1;
+         /* Value of the previous event is known */
+         if (i > 0)
+         {
+            strata_tally(strat, (double)(count - count_tally));
+            count_tally = count;
+         }
+
+         /* Pilot pass with evenly spread events, then the rest by Neyman allocation */
+         if (i == pass_end)
+         {
+            int n_pass = total - i;
+
+            if (neyman && (i == 0))
+               n_pass = (total/10 > 2*strata_num(strat)) ? total/10 : 2*strata_num(strat);
+
+            if (0 != strata_plan(strat, n_pass, (i > 0)))
+            {
+               fprintf(stderr, "Too few events for %d strata!\n", strata_num(strat));
+               return 1;
+            }
+            pass_end += n_pass;
+            k = block;
+         }
       }
-      if (0 != gun_event(contextW, &y_0))
+
+      /* Get new event data */
+      if (k == block)
       {
-         fprintf(stderr, "Y0 PDF Failure!\n");
-         return 1;
+         if (0 != gun_event_n(contextI, block, evt_I))
+         {
+            fprintf(stderr, (flux == 0) ? "PDG PDF Failure!\n" : (flux == 1) ? "ISO PDF Failure!\n" :
+                    (flux == 2) ? "ZEN PDF Failure!\n" : "SPEC PDF Failure!\n");
+            return 1;
+         }
+         if (0 != gun_event_n(contextL, block, &evt_x))
+         {
+            fprintf(stderr, "X0 PDF Failure!\n");
+            return 1;
+         }
+         if (0 != gun_event_n(contextW, block, &evt_y))
+         {
+            fprintf(stderr, "Y0 PDF Failure!\n");
+            return 1;
+         }
+         if (precision != 0)
+         {
+            for (k = 0; k < block; ++k)
+            {
+               evt_f[k] = (float)evt_x[k];
+               evt_f[k + block] = (float)evt_y[k];
+               evt_f[k + 2*block] = (float)(length+depth);
+               evt_f[k + 3*block] = (float)evt_ux[k];
+               evt_f[k + 4*block] = (float)evt_uy[k];
+               evt_f[k + 5*block] = (float)evt_uz[k];
+            }
+            intersect_box_nf(&box_f, block, evt_org_f, evt_dir_f, evt_hit_f, evt_len_f);
+         }
+         k = 0;
       }
+      x_0 = evt_x[k];
+      y_0 = evt_y[k];
 
       /* Set particle values at world's edge */
       part.origin[x_c] = x_0;
@@ -327,16 +566,16 @@ int main(int argc, char *argv[])
       part.origin[z_c] = length+depth;
 
       /* Set particle direction */
-      part.direction[x_c] = sin(t)*cos(p);
-      part.direction[y_c] = sin(t)*sin(p);
-      part.direction[z_c] = cos(t);
+      part.direction[x_c] = evt_ux[k];
+      part.direction[y_c] = evt_uy[k];
+      part.direction[z_c] = evt_uz[k];
 
-      if (use_f)
+      if (use_f && use_r)
       {
          /* Obtain dot product to normal of world edge to enforce foreshortening effect */
          double f_size = fabs(dot_vec(w_n, part.direction));
 
-         if (f_size < drand48())
+         if (f_size < rng_uniform(gun_rng(contextI)))
          {
             /* Address over-density of angled particles due to foreshortening by rejecting this event */
             --i;
@@ -344,47 +583,81 @@ int main(int argc, char *argv[])
          }
       }
 
-      /* Find geometric intersection */
-      retVal = intersect_box(part, box,
-                             trans, &hit,
-                             l1, l2, l3);
-
-      if (retVal == 0)
+      /* Find geometric intersection: A 'hit' has a long enough track inside */
+      hit = 0;
+      if (precision != 1)
+      {
+         retVal = intersect_box_prepared(&part, &box_p,
+                                         trans, &hit,
+                                         l1, l2, l3);
+         track_len = fabs(trans[0] - trans[1]);
+         hit = (retVal == 0) && hit && (track_len > track);
+      }
+      if (precision != 0)
       {
-         if (hit)
+         int hit_f = evt_hit_f[k] && (evt_len_f[k] > track);
+
+         if (precision == 2)
+         {
+            count_f += hit_f;
+            count_diff += (hit_f != hit);
+         }
+         else
          {
-            double track_len = fabs(trans[0] - trans[1]);
-            if (track_len > track)
-               count++;
-            else
-               continue;
+            hit = hit_f;
+            track_len = evt_len_f[k];
 
-            if (plot & plot_tr)
-            {
-               /* Add bin count in theta */
-               int    b;
+            /* Position of the hit in double precision, only when needed */
+            if (hit && (plot & plot_xy))
+               intersect_box_prepared(&part, &box_p, trans, &retVal, l1, l2, l3);
+         }
+      }
 
-               b = (int)floor((double)bins * (track_len/tr_scale));
-               if ((0 <= b)&&(b <= bins-1))
-                  ++bins_tr[b];
-            }
+      if (hit)
+      {
+         count++;
+         if (flux >= 3)
+            sum_e += evt_e[k];
 
-            if (plot & plot_xy)
-            {
-               /* Add bin count in X/Y plane */
-               int    x_b, y_b;
+         if (plot & plot_tr)
+         {
+            /* Add bin count in theta */
+            int    b;
+
+            b = (int)floor((double)bins * (track_len/tr_scale));
+            if ((0 <= b)&&(b <= bins-1))
+               ++bins_tr[b];
+         }
+
+         if (plot & plot_xy)
+         {
+            /* Add bin count in X/Y plane */
+            int    x_b, y_b;
 
-               x_b = (int)floor((double)bins_xy * ((l1[0]+(xy_scale/2.0))/xy_scale));
-               y_b = (int)floor((double)bins_xy * ((l2[0]+(xy_scale/2.0))/xy_scale));
+            x_b = (int)floor((double)bins_xy * ((l1[0]+(xy_scale/2.0))/xy_scale));
+            y_b = (int)floor((double)bins_xy * ((l2[0]+(xy_scale/2.0))/xy_scale));
 
-               if ((0 <= x_b)&&(x_b <= bins_xy-1) &&
-                   (0 <= y_b)&&(y_b <= bins_xy-1))
-                  ++bins_X_Y[x_b][y_b];
-            }
+            if ((0 <= x_b)&&(x_b <= bins_xy-1) &&
+                (0 <= y_b)&&(y_b <= bins_xy-1))
+               ++bins_X_Y[x_b][y_b];
          }
       }
    }
 
+   gun_delete(contextI);
+   gun_delete(contextL);
+   gun_delete(contextW);
+
+   free(evt_ux);
+   free(evt_uy);
+   free(evt_uz);
+   free(evt_e);
+   free(evt_x);
+   free(evt_y);
+   free(evt_f);
+   free(evt_len_f);
+   free(evt_hit_f);
+
    if (f_outTrans != NULL)
    {
       /* Print data */
@@ -420,8 +693,40 @@ int main(int argc, char *argv[])
 
    double ratio = (double)count/(double)total;
    double ratio_err = sqrt((double)count)/(double)total;
+
+   if (replicas > 0)
+   {
+      /* Standard error of the mean over the replicas */
+      double r = (double)(count - count_rep)/(double)n_rep;
+      double var;
+
+      sum_rep += r;
+      sum2_rep += r*r;
+      var = (sum2_rep - sum_rep*sum_rep/(double)replicas)/(double)(replicas - 1);
+      ratio_err = sqrt(((var > 0.0) ? var : 0.0)/(double)replicas);
+   }
+   if (NULL != strat)
+   {
+      /* Stratified estimate */
+      strata_tally(strat, (double)(count - count_tally));
+      if (0 != strata_estimate(strat, &ratio, &ratio_err))
+      {
+         fprintf(stderr, "Strata Failure!\n");
+         return 1;
+      }
+      strata_delete(strat);
+   }
    printf("Ratio:             %e +- %e\n", ratio, ratio_err);
 
    printf("Rate in world:     %e Hz\n", rate_w);
    printf("Rate in detector : %e Hz +- %e Hz\n", rate_w*flux_scale*ratio, rate_w*flux_scale*ratio_err);
+   if ((flux >= 3) && (count > 0))
+      printf("Mean energy of hits: %e GeV\n", sum_e/(double)count);
+   if (precision == 2)
+   {
+      /* Error of the difference from the events with different results */
+      printf("Single precision : %d hits, %d events differ\n", count_f, count_diff);
+      printf("Ratio difference : %e +- %e (single - double)\n",
+             (double)(count_f - count)/(double)total, sqrt((double)count_diff)/(double)total);
+   }
 }
@@ -22,6 +22,8 @@
 
 #include <ctype.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,34 +33,335 @@
 #include "pdg/pdg.h"
 #include "vector/vector.h"
 #include "geometry/geometry.h"
+#include "accept/accept.h"
 #include "pdf/pdf.h"
 #include "gun/gun.h"
 #include "gun/gun_iso.h"
 #include "gun/gun_pdg.h"
 #include "gun/gun_range.h"
+#include "gun/gun_table.h"
+#include "gun/gun_energy.h"
+#include "strata/strata.h"
+
+/* Setup of the run, shared by all workers */
+typedef struct tele_setup
+{
+   const g_rect_prepared   *rect_p;
+   const g_rect_prepared_f *rect_f;
+   const g_pose            *pose_d1;
+   const double            *normal;
+   int    flux;
+   int    precision;
+   int    use_f;
+   int    use_r;
+   int    replicas;
+   int    n_rep;
+   int    neyman;
+   uint64_t seed;
+} tele_setup;
+
+/* Events of one worker: Its own guns and strata, and its tallies */
+typedef struct tele_job
+{
+   const tele_setup *set;
+   gun_ctx    contextI;
+   gun_ctx    contextL;
+   gun_ctx    contextW;
+   strata_ctx strat;
+   FILE      *f_outH;
+   int        events;
+   int        rep_first;
+   double    *rep_ratio;
+   int        count;
+   int        count_f;
+   int        count_diff;
+   double     sum_e;
+   double     ratio;
+   double     ratio_err;
+   int        status;
+   int        started;
+   pthread_t  thread;
+} tele_job;
 
 /* Prototypes */
 static void usage(const char* name);
+static void *tele_run(void *arg);
 
 /* Implementations */
 static void usage(const char* name)
 {
-   printf("Usage:\n%s [-e <num>] [-h] [-s <double>] [-w <double>] <theta>\n", name);
+   printf("Usage:\n%s [-a <num>] [-e <num>] [-g <num>] [-h] [-j <num>] [-k] [-n] [-p <double>] [-q <num>] [-s <double>] [-S <num>] [-w <double>] [-y] <theta>\n", name);
    printf("\n-- Options:\n");
+   printf("-a <num>    : Set the arithmetic of the intersections. (Default is 0)\n");
+   printf("              0 = Double precision.\n");
+   printf("              1 = Single precision. (Twice the vector lanes)\n");
+   printf("              2 = Both: Count in double precision, report the difference of single precision.\n");
+   printf("-c <path>   : Cache file for the tables of the spectra with energy. (Default is none)\n");
    printf("-e <num>    : Set the number of events to simulate. (Default is 1,000,000)\n");
    printf("-f <num>    : Set the simulated flux of particle.\n");
    printf("              0 = PDG flux. (~ cos^2 theta)\n");
    printf("              1 = Isotropic flux.\n");
+   printf("              2 = Point source at zenith. (Tabulated)\n");
+   printf("              3 = Sea level spectrum of Reyna, with energy. (Tabulated)\n");
+   printf("              4 = Sea level spectrum of Gaisser, with energy. (Tabulated)\n");
+   printf("-g <num>    : Stratify the events into <num> parts of each of x, y, cos(theta) and phi. (Default is not to)\n");
    printf("-h          : Print this help text.\n");
+   printf("-j <num>    : Split the events between <num> threads, all processors for 0. (Default is 1)\n");
+   printf("              Each has its own random streams and strata, so the results depend on <num> (not with '-q'),\n");
+   printf("              but are the same for every run with the same <num>.\n");
+   printf("-k          : Sample only directions inside of the acceptance cone of the telescope, and weight the ratio\n");
+   printf("              by the share of the flux in the cone. (PDG or isotropic flux with 'foreshortening' only)\n");
    printf("-l <double> : Set the (longer) length of the detectors [m]. (Default is 0.1 m)\n");
+   printf("-m <double> : Set the minimal energy of the muons of the spectra with energy [GeV]. (Default is 1.0 GeV)\n");
+   printf("-n          : With strata, reallocate 90%% of the events by the variances of a pilot pass (Neyman).\n");
+   printf("-p <double> : Set the azimuth of the telescope, turned around the zenith after the tilt [radians]. (Default is 0)\n");
+   printf("-q <num>    : Use quasi-random (scrambled Sobol) events in <num> independent replicas. (Default is pseudo-random)\n");
+   printf("              The error is taken from the spread of the replicas. Needs <num> >= 2, not with '-r'.\n");
+   printf("-r          : Apply the 'foreshortening' rule by rejecting events. (Default is to sample it directly)\n");
    printf("-s <double> : Set the separation between detectors [m]. (Default is 1.0 m)\n");
-   printf("-t <path>   : Change logic to record 'hit' in give file as theta,phi. (Default is not to do that)\n");
+   printf("-S <num>    : Seed of all random streams, quasi-random replicas and strata, e.g. 0x1F for independent runs.\n");
+   printf("              (Default is the library default)\n");
+   printf("-t <path>   : Change logic to record 'hit' in give file as theta,phi (and energy). (Default is not to do that)\n");
    printf("-u          : Disable 'foreshortening' rule on particles in first detector. (Default is to use it)\n");
+   printf("-x          : Latin hypercube sampling inside of the strata. The error is then an upper bound.\n");
    printf("-w <double> : Set the (shorter) width of the detectors [m]. (Default is 0.1 m)\n");
+   printf("-y          : Evaluate the rate in closed form instead of simulating it. (PDG or isotropic flux only)\n");
    printf("\n-- Positional arguments:\n");
    printf("<theta>          : Angle to zenith [radians].\n");
 }
 
+/* Event loop of one worker */
+static void *tele_run(void *arg)
+{
+   tele_job *job = (tele_job*)arg;
+   const tele_setup *set = job->set;
+   int    i, k;
+
+   /* Event data, generated one block at a time */
+   const int block = 4096;
+   double *evt_ux = (double*)malloc(sizeof(double)*block);
+   double *evt_uy = (double*)malloc(sizeof(double)*block);
+   double *evt_uz = (double*)malloc(sizeof(double)*block);
+   double *evt_e = (double*)malloc(sizeof(double)*block);
+   double *evt_x = (double*)malloc(sizeof(double)*block);
+   double *evt_y = (double*)malloc(sizeof(double)*block);
+   double *evt_I[4] = { evt_ux, evt_uy, evt_uz, evt_e };
+
+   /* Particle origins and the hits of a block, intersected all at once */
+   double *evt_ox = (double*)malloc(sizeof(double)*block);
+   double *evt_oy = (double*)malloc(sizeof(double)*block);
+   double *evt_oz = (double*)malloc(sizeof(double)*block);
+   int    *evt_hit = (int*)malloc(sizeof(int)*block);
+   const double *evt_org[3] = { evt_ox, evt_oy, evt_oz };
+   const double *evt_loc[3] = { evt_x, evt_y, NULL };
+   double *const evt_out[3] = { evt_ox, evt_oy, evt_oz };
+   const double *evt_dir[3] = { evt_ux, evt_uy, evt_uz };
+
+   /* Same in single precision */
+   float  *evt_f = (float*)malloc(sizeof(float)*6*block);
+   int    *evt_hit_f = (int*)malloc(sizeof(int)*block);
+   const float *evt_org_f[3] = { evt_f, evt_f + block, evt_f + 2*block };
+   const float *evt_dir_f[3] = { evt_f + 3*block, evt_f + 4*block, evt_f + 5*block };
+
+   /* Hit counter, and the cross-check of single precision */
+   int    count = 0;
+   int    count_f = 0;
+   int    count_diff = 0;
+
+   /* Energy of the hits, for the spectra with energy */
+   double sum_e = 0.0;
+
+   /* Hits before the current replica, and before the current event of the strata */
+   int    count_rep = 0;
+   int    pass_end = 0;
+   int    count_tally = 0;
+
+   job->status = 0;
+   if ((NULL == evt_ux) || (NULL == evt_uy) || (NULL == evt_uz) || (NULL == evt_e) ||
+       (NULL == evt_x) || (NULL == evt_y) || (NULL == evt_ox) || (NULL == evt_oy) ||
+       (NULL == evt_oz) || (NULL == evt_hit) || (NULL == evt_f) || (NULL == evt_hit_f))
+   {
+      fprintf(stderr, "Out of memory!\n");
+      job->status = 1;
+   }
+
+   k = block;
+   for (i=0; (i < job->events) && (0 == job->status); ++i, ++k)
+   {
+      /* Start the next replica: Joint (x, y, direction) points of one Sobol sequence */
+      if ((set->replicas > 0) && (i % set->n_rep == 0))
+      {
+         uint64_t rep = (uint64_t)(job->rep_first + i / set->n_rep);
+         int d;
+
+         if (i > 0)
+         {
+            job->rep_ratio[i / set->n_rep - 1] = (double)(count - count_rep)/(double)set->n_rep;
+            count_rep = count;
+         }
+
+         d = gun_qmc(job->contextL, set->seed, rep, 0);
+         d = gun_qmc(job->contextW, set->seed, rep, d);
+         d = gun_qmc(job->contextI, set->seed, rep, d);
+         if (d < 0)
+         {
+            fprintf(stderr, "QMC Failure!\n");
+            job->status = 1;
+            break;
+         }
+         k = block;
+      }
+
+      if (NULL != job->strat)
+      {
+         /* Value of the previous event is known */
+         if (i > 0)
+         {
+            strata_tally(job->strat, (double)(count - count_tally));
+            count_tally = count;
+         }
+
+         /* Pilot pass with evenly spread events, then the rest by Neyman allocation */
+         if (i == pass_end)
+         {
+            int n_pass = job->events - i;
+            int n_min = 2*strata_num(job->strat);
+
+            if (set->neyman && (i == 0))
+               n_pass = (job->events/10 > n_min) ? job->events/10 : n_min;
+
+            if (0 != strata_plan(job->strat, n_pass, (i > 0)))
+            {
+               fprintf(stderr, "Too few events for %d strata!\n", strata_num(job->strat));
+               job->status = 1;
+               break;
+            }
+            pass_end += n_pass;
+            k = block;
+         }
+      }
+
+      /* Get new event data */
+      if (k == block)
+      {
+         if (0 != gun_event_n(job->contextI, block, evt_I))
+         {
+            fprintf(stderr, (set->flux == 0) ? "PDG PDF Failure!\n" : (set->flux == 1) ? "ISO PDF Failure!\n" :
+                    (set->flux == 2) ? "ZEN PDF Failure!\n" : "SPEC PDF Failure!\n");
+            job->status = 1;
+            break;
+         }
+         if (0 != gun_event_n(job->contextL, block, &evt_x))
+         {
+            fprintf(stderr, "X0 PDF Failure!\n");
+            job->status = 1;
+            break;
+         }
+         if (0 != gun_event_n(job->contextW, block, &evt_y))
+         {
+            fprintf(stderr, "Y0 PDF Failure!\n");
+            job->status = 1;
+            break;
+         }
+
+         /* Particles start on detector 1, then intersect the block with detector 2 */
+         pose_apply_n(set->pose_d1, block, evt_loc, evt_out);
+         if (set->precision != 1)
+            intersect_rect_n(set->rect_p, block, evt_org, evt_dir, evt_hit, NULL, NULL, NULL);
+         if (set->precision != 0)
+         {
+            for (k = 0; k < block; ++k)
+            {
+               evt_f[k] = (float)evt_ox[k];
+               evt_f[k + block] = (float)evt_oy[k];
+               evt_f[k + 2*block] = (float)evt_oz[k];
+               evt_f[k + 3*block] = (float)evt_ux[k];
+               evt_f[k + 4*block] = (float)evt_uy[k];
+               evt_f[k + 5*block] = (float)evt_uz[k];
+            }
+            intersect_rect_nf(set->rect_f, block, evt_org_f, evt_dir_f, evt_hit_f);
+            if (set->precision == 1)
+               memcpy(evt_hit, evt_hit_f, sizeof(int)*block);
+         }
+         k = 0;
+      }
+
+      if (set->use_f && set->use_r)
+      {
+         /* Obtain dot product to normal to enforce foreshortening effect */
+         double f_size = fabs(set->normal[x_c]*evt_ux[k] + set->normal[y_c]*evt_uy[k]
+                              + set->normal[z_c]*evt_uz[k]);
+
+         if (f_size < rng_uniform(gun_rng(job->contextI)))
+         {
+            /* Address over-density of angled particles due to foreshortening by rejecting this event */
+            --i;
+            continue;
+         }
+      }
+
+      if (set->precision == 2)
+      {
+         count_f += evt_hit_f[k];
+         count_diff += (evt_hit_f[k] != evt_hit[k]);
+      }
+
+      if (evt_hit[k])
+      {
+         if (job->f_outH != NULL)
+         {
+            /* Polar and azimuth angle of the direction */
+            double t = acos(evt_uz[k]);
+            double p = atan2(evt_uy[k], evt_ux[k]);
+
+            if (p < 0.0)
+               p += 2.0 * pi;
+            if (set->flux >= 3)
+               fprintf(job->f_outH, "%e \t %e \t %e\n", t, p, evt_e[k]);
+            else
+               fprintf(job->f_outH, "%e \t %e\n", t, p);
+         }
+         if (set->flux >= 3)
+            sum_e += evt_e[k];
+         ++count;
+      }
+   }
+
+   /* Ratio of the last replica */
+   if ((0 == job->status) && (set->replicas > 0) && (job->events > 0))
+      job->rep_ratio[job->events / set->n_rep - 1] = (double)(count - count_rep)/(double)set->n_rep;
+
+   if ((0 == job->status) && (NULL != job->strat) && (job->events > 0))
+   {
+      /* Stratified estimate of the events of this worker */
+      strata_tally(job->strat, (double)(count - count_tally));
+      if (0 != strata_estimate(job->strat, &job->ratio, &job->ratio_err))
+      {
+         fprintf(stderr, "Strata Failure!\n");
+         job->status = 1;
+      }
+   }
+
+   free(evt_ux);
+   free(evt_uy);
+   free(evt_uz);
+   free(evt_e);
+   free(evt_x);
+   free(evt_y);
+   free(evt_ox);
+   free(evt_oy);
+   free(evt_oz);
+   free(evt_hit);
+   free(evt_f);
+   free(evt_hit_f);
+
+   job->count = count;
+   job->count_f = count_f;
+   job->count_diff = count_diff;
+   job->sum_e = sum_e;
+   return NULL;
+}
+
 /* Main */
 int main(int argc, char *argv[])
 {
@@ -66,8 +369,10 @@ int main(int argc, char *argv[])
    FILE   *f_outR = NULL;
    FILE   *f_outH = NULL;
    double theta_d = 0.0;
+   double phi_d = 0.0;
    int    flux = 0;
    double total_rate_per_m2 = mu_pdg_i * pi / 2.0; /* Hz/m^2 */
+   const double energy_max = 1.0E5; /* GeV */
 
    int index, type;
    int c;
@@ -77,26 +382,72 @@ int main(int argc, char *argv[])
    double length = 0.1;
    double width = 0.1;
    int    use_f = 1;
+   int    use_r = 0;
+   int    replicas = 0;
+   int    strata_div = 0;
+   int    neyman = 0;
+   int    lhs = 0;
+   double e_min = 1.0;
+   char   *cache = NULL;
+   int    precision = 0;
+   int    use_k = 0;
+   int    use_y = 0;
+   int    threads = 1;
+   uint64_t seed = rng_default_seed;
+   double rate_det1;
 
    opterr = 0;
-   while ((c = getopt (argc, argv, "e:f:hl:s:t:uw:")) != -1)
+   while ((c = getopt (argc, argv, "a:c:e:f:g:hj:kl:m:np:q:rs:S:t:uw:xy")) != -1)
       switch (c)
       {
+      case 'a':
+         precision = atoi(optarg);
+         break;
+      case 'c':
+         cache = optarg;
+         break;
       case 'e':
          total = atoi(optarg);
          break;
       case 'f':
          flux = atoi(optarg);
          break;
+      case 'g':
+         strata_div = atoi(optarg);
+         break;
       case 'h':
          usage(argv[0]);
          return 0;
+      case 'j':
+         threads = atoi(optarg);
+         break;
+      case 'k':
+         use_k = 1;
+         break;
       case 'l':
          length = strtod(optarg, NULL);
          break;
+      case 'm':
+         e_min = strtod(optarg, NULL);
+         break;
+      case 'n':
+         neyman = 1;
+         break;
+      case 'p':
+         phi_d = strtod(optarg, NULL);
+         break;
+      case 'q':
+         replicas = atoi(optarg);
+         break;
+      case 'r':
+         use_r = 1;
+         break;
       case 's':
          separation = strtod(optarg, NULL);
          break;
+      case 'S':
+         seed = strtoull(optarg, NULL, 0);
+         break;
       case 't':
          f_outH = fopen(optarg, "w");
          break;
@@ -106,8 +457,14 @@ int main(int argc, char *argv[])
       case 'w':
          width = strtod(optarg, NULL);
          break;
+      case 'x':
+         lhs = 1;
+         break;
+      case 'y':
+         use_y = 1;
+         break;
       case '?':
-         if (strchr("e", optopt) != 0)
+         if (strchr("acegjmpqS", optopt) != 0)
             fprintf(stderr, "Option -%c requires an argument.\n", optopt);
          else if (isprint (optopt))
             fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -126,6 +483,49 @@ int main(int argc, char *argv[])
       return 1;
    }
 
+   if ((replicas == 1) || (replicas < 0) || ((replicas > 0) && use_r))
+   {
+      fprintf(stderr, "Quasi-random mode needs at least 2 replicas and no rejection.\n");
+      return 1;
+   }
+
+   if ((replicas > 0) && (total < replicas))
+   {
+      fprintf(stderr, "Quasi-random mode needs at least one event per replica.\n");
+      return 1;
+   }
+
+   if ((precision < 0) || (precision > 2))
+   {
+      fprintf(stderr, "Unknown arithmetic: %d\n", precision);
+      return 1;
+   }
+
+   if (use_k && (((flux != 0) && (flux != 1)) || !use_f || use_r))
+   {
+      fprintf(stderr, "Cone sampling needs the PDG or isotropic flux with 'foreshortening' and no rejection.\n");
+      return 1;
+   }
+
+   /* All processors for 0 */
+   if (threads == 0)
+      threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if (threads < 1)
+   {
+      fprintf(stderr, "Needs at least one thread: %d\n", threads);
+      return 1;
+   }
+
+   /* Latin hypercube alone is a single stratum */
+   if (lhs && (strata_div == 0))
+      strata_div = 1;
+
+   if ((strata_div < 0) || ((strata_div > 0) && (use_r || (replicas > 0))))
+   {
+      fprintf(stderr, "Stratified sampling does not work with rejection or quasi-random mode.\n");
+      return 1;
+   }
+
    /* Read positional arguments */
    type = 0;
    for (index = optind; index < argc; index++)
@@ -139,11 +539,28 @@ int main(int argc, char *argv[])
       ++type;
    }
 
-   /* Particle event data */
-   g_line part;
+   /* Closed form of the same telescope: No events needed */
+   if (use_y)
+   {
+      double rate = accept_tele_rate(flux, length, width, separation, theta_d);
+
+      if (!use_f || (rate < 0.0))
+      {
+         fprintf(stderr, "Closed form needs the PDG or isotropic flux with 'foreshortening' and positive sizes.\n");
+         return 1;
+      }
+      rate_det1 = (flux == 0) ? r_tot_PDG(theta_d, width*length) : total_rate_per_m2 * width * length;
+      printf("Ratio: %e +- %e\n", rate/rate_det1, 0.0);
+      printf("Rate in detector 1: %e Hz\n", rate_det1);
+      printf("Rate in telescope : %e Hz +- %e Hz\n", rate, 0.0);
+      return 0;
+   }
 
    /* Geometry descripton of the telesope */
    g_rectangle rectangle;
+   g_rectangle rect_d1;
+   g_rect_prepared rect_p;
+   g_rect_prepared_f rect_f;
 
    vec3 r_e1, r_e2;
    double l_e1, l_e2;
@@ -151,23 +568,13 @@ int main(int argc, char *argv[])
    gun_ctx contextL = NULL;
    gun_ctx contextW = NULL;
 
+   /* Acceptance cone of the telescope: |cos| to the normal, and share of the flux inside */
+   double  cos_cone;
+   double  cone_weight = 1.0;
+
    /* Scaling factor due to flux model. Default is 1.0 */
    double  flux_scale = 1.0;
-   double  rate_det1;
-
-   if (flux == 0)
-   {
-      /* Set PDFs for particle gun */
-      /* Return theta = 0, cos(theta) = 1 */
-      contextI = gun_pdg_init(0);
-   }
-   if (flux == 1)
-   {
-      /* Set PDFs for particle gun */
-      /* Return theta = 0, cos(theta) = 1 */
-      contextI = gun_iso_init(0);
-      flux_scale = 1.0;
-   }
+   double  rate_table = 0.0;
 
    if (f_outH == NULL)
    {
@@ -185,13 +592,28 @@ int main(int argc, char *argv[])
       contextW = gun_range_init(-width/2000.0, width/2000.0);
    }
    
-   /* Hit counter */
-   int    count = 0;
+   /* Pose of the telescope: Tilt to theta around the x-axis, then turn to the azimuth */
+   const vec3 rot_axis = { 1.0, 0.0, 0.0 };
+   const vec3 az_axis = { 0.0, 0.0, 1.0 };
+   g_pose pose_t, pose_d1;
 
-   /* Rotational axis when point the telescope -> x-axis */
-   vec3 rot_axis = { 1.0, 0.0, 0.0 };
-   
-   /* Set fixed values for rectangle (2nd detector) */
+   pose_identity(&pose_t);
+   if (fabs(theta_d) > 1E-10)
+      pose_rotation(&pose_t, rot_axis, theta_d);
+   if (fabs(phi_d) > 1E-10)
+   {
+      g_pose pose_az;
+
+      pose_rotation(&pose_az, az_axis, phi_d);
+      pose_compose(&pose_t, &pose_az, &pose_t);
+   }
+
+   /* Detector 1: Above the center of the telescope */
+   pose_identity(&pose_d1);
+   pose_d1.trans[z_c] = separation/2.0;
+   pose_compose(&pose_d1, &pose_t, &pose_d1);
+
+   /* Set fixed values for rectangle (2nd detector), then place it with the telescope */
    rectangle.origin[x_c] = 0.0;
    rectangle.origin[y_c] = 0.0;
    rectangle.origin[z_c] = -separation/2.0;
@@ -206,107 +628,236 @@ int main(int argc, char *argv[])
    rectangle.edge2[z_c] = 0.0;
    rectangle.edge2_len = width/2.0;
 
-   /* Rotate telescope detector 2 */
-   if (fabs(theta_d) > 1E-10)
+   rectangle.normal[x_c] = 0.0;
+   rectangle.normal[y_c] = 0.0;
+   rectangle.normal[z_c] = 1.0;
+
+   /* Detector 1 is the same rectangle above the center */
+   rect_d1 = rectangle;
+   rect_d1.origin[z_c] = separation/2.0;
+
+   pose_rect(&rectangle, &pose_t, &rectangle);
+   pose_rect(&rect_d1, &pose_t, &rect_d1);
+   cos_cone = accept_cos_rect(&rect_d1, &rectangle);
+
+   /* Fixed for the whole run: Prepare it once for the intersections */
+   prepare_rect(&rect_p, &rectangle);
+   prepare_rect_f(&rect_f, &rect_p);
+
+   /* Both detectors are parallel: Normal of detector 1 is the same */
+   if (flux == 0)
+   {
+      /* Set PDFs for particle gun */
+      if (use_k)
+      {
+         contextI = gun_pdg_flux_cone_init(rectangle.normal, cos_cone);
+         cone_weight = gun_pdg_flux_cone_weight(rectangle.normal, cos_cone);
+      }
+      else if (use_f && !use_r)
+         contextI = gun_pdg_flux_init(rectangle.normal);
+      else
+         contextI = gun_pdg_dir_init();
+   }
+   if (flux == 1)
    {
-      vec3 out;
-      
-      rotate_vec(out, rectangle.origin, rot_axis, theta_d);
-      copy_vec(rectangle.origin, out);
-      rotate_vec(out, rectangle.edge1, rot_axis, theta_d);
-      copy_vec(rectangle.edge1, out);
-      rotate_vec(out, rectangle.edge2, rot_axis, theta_d);
-      copy_vec(rectangle.edge2, out);
+      /* Set PDFs for particle gun */
+      if (use_k)
+      {
+         contextI = gun_iso_flux_cone_init(rectangle.normal, cos_cone);
+         cone_weight = gun_iso_flux_cone_weight(rectangle.normal, cos_cone);
+      }
+      else if (use_f && !use_r)
+         contextI = gun_iso_flux_init(rectangle.normal);
+      else
+         contextI = gun_iso_dir_init();
+      flux_scale = 1.0;
+   }
+   if (flux == 2)
+   {
+      /* Tabulated intensity, sampled with the alias method */
+      contextI = gun_table_init(j_val_ZEN, rectangle.normal, (use_f && !use_r), 1024, 256);
+      rate_table = gun_table_norm(contextI) * width * length;
+      flux_scale = 1.0;
    }
+   if ((flux == 3) || (flux == 4))
+   {
+      /* Joint direction and energy above e_min */
+      contextI = gun_energy_init((flux == 3) ? 1 : 0, rectangle.normal, (use_f && !use_r), e_min, energy_max, cache);
+      if (NULL != contextI)
+         rate_table = gun_energy_norm(contextI) * width * length;
+      flux_scale = 1.0;
+   }
+   if (NULL == contextI)
+   {
+      fprintf(stderr, "Unknown flux: %d\n", flux);
+      return 1;
+   }
+
 
-   /* Find normal for detector 2 */
-   cross_vec(rectangle.normal, rectangle.edge1, rectangle.edge2);
+   /* Quasi-random replicas: Events per replica */
+   int    n_rep = total;
 
-   for (i=0; i < total; ++i)
+   if (replicas > 0)
    {
-      int        hit, retVal;
-      double     trans, l1, l2;
-      double     x_0, y_0;
-      iso_event  evt_i;
-      pdg_event  evt_p;
-      double     t, p;
+      n_rep = total / replicas;
+      total = n_rep * replicas;
 
-      /* Get new event data */
-      if (flux == 0)
+      /* Whole replicas for each worker */
+      if (threads > replicas)
+         threads = replicas;
+   }
+
+   tele_setup set;
+
+   set.rect_p = &rect_p;
+   set.rect_f = &rect_f;
+   set.pose_d1 = &pose_d1;
+   set.normal = rectangle.normal;
+   set.flux = flux;
+   set.precision = precision;
+   set.use_f = use_f;
+   set.use_r = use_r;
+   set.replicas = replicas;
+   set.n_rep = n_rep;
+   set.neyman = neyman;
+   set.seed = seed;
+
+   /* Workers: The first one with the guns from above, the others with copies on streams of their own */
+   tele_job *jobs = (tele_job*)calloc(threads, sizeof(tele_job));
+   double *rep_ratio = (double*)calloc((replicas > 0) ? replicas : 1, sizeof(double));
+   int    rep_first = 0;
+   int    t;
+
+   if ((NULL == jobs) || (NULL == rep_ratio))
+   {
+      fprintf(stderr, "Out of memory!\n");
+      return 1;
+   }
+
+   for (t = 0; t < threads; ++t)
+   {
+      tele_job *job = &jobs[t];
+
+      job->set = &set;
+      if (t == 0)
       {
-         if (0 != gun_event(contextI, evt_p.pars))
-         {
-            fprintf(stderr, "PDG PDF Failure!\n");
-            return 1;
-         }
-         t = evt_p.out_t.theta;
-         p = evt_p.out_t.phi;
+         job->contextI = contextI;
+         job->contextL = contextL;
+         job->contextW = contextW;
+         job->f_outH = f_outH;
       }
-      else if (flux == 1)
+      else
       {
-         if (0 != gun_event(contextI, evt_i.pars))
+         /* Copies start on new streams, all of them are seeded below */
+         job->contextI = gun_copy(contextI);
+         job->contextL = gun_copy(contextL);
+         job->contextW = gun_copy(contextW);
+         if ((NULL == job->contextI) || (NULL == job->contextL) || (NULL == job->contextW))
          {
-            fprintf(stderr, "ISO PDF Failure!\n");
+            fprintf(stderr, "Out of memory!\n");
             return 1;
          }
-         t = evt_i.out_t.theta;
-         p = evt_i.out_t.phi;
-      }
 
-      if (0 != gun_event(contextL, &x_0))
-      {
-         fprintf(stderr, "X0 PDF Failure!\n");
-         return 1;
-      }
-      if (0 != gun_event(contextW, &y_0))
-      {
-         fprintf(stderr, "Y0 PDF Failure!\n");
-         return 1;
+         /* Hits are recorded aside, and appended in the order of the workers */
+         if (f_outH != NULL)
+         {
+            job->f_outH = tmpfile();
+            if (NULL == job->f_outH)
+            {
+               fprintf(stderr, "Can not record the hits of worker %d!\n", t);
+               return 1;
+            }
+         }
       }
 
-      /* Set particle values */
-      part.origin[x_c] = x_0;
-      part.origin[y_c] = y_0;
-      part.origin[z_c] = separation/2.0;
+      /* Streams of the worker: The first one keeps those of the guns created without seed */
+      gun_seed(job->contextL, seed, ((uint64_t)t << 32) + 0);
+      gun_seed(job->contextW, seed, ((uint64_t)t << 32) + 1);
+      gun_seed(job->contextI, seed, ((uint64_t)t << 32) + 2);
 
-      /* Rotate telescope detector 1 */
-      if (fabs(theta_d) > 1E-10)
+      /* Share of the events, or of the replicas */
+      if (replicas > 0)
       {
-         vec3 out;
-      
-         rotate_vec(out, part.origin, rot_axis, theta_d);
-         copy_vec(part.origin, out);
-      }
+         int num = replicas / threads + ((t < replicas % threads) ? 1 : 0);
 
-      /* Set particle direction */
-      part.direction[x_c] = sin(t)*cos(p);
-      part.direction[y_c] = sin(t)*sin(p);
-      part.direction[z_c] = cos(t);
+         job->rep_first = rep_first;
+         job->rep_ratio = rep_ratio + rep_first;
+         job->events = num * n_rep;
+         rep_first += num;
+      }
+      else
+         job->events = total / threads + ((t < total % threads) ? 1 : 0);
 
-      if (use_f)
+      /* Strata of the joint (x, y, direction) uniform values */
+      if (strata_div > 0)
       {
-         /* Obtain dot product to normal to enforce foreshortening effect */
-         double f_size = fabs(dot_vec(rectangle.normal, part.direction));
-
-         if (f_size < drand48())
+         int divs[STRATA_MAX_DIM];
+         int dims = 2 + gun_draws(job->contextI);
+         int d;
+
+         /* Leading draws of the direction: cos(theta) and phi */
+         for (d = 0; d < dims; d++)
+            divs[d] = (d < 4) ? strata_div : 1;
+
+         job->strat = strata_init(dims, divs, lhs, seed + (uint64_t)t);
+         d = strata_attach(job->strat, job->contextL, 0);
+         d = strata_attach(job->strat, job->contextW, d);
+         d = strata_attach(job->strat, job->contextI, d);
+         if (d < 0)
          {
-            /* Address over-density of angled particles due to foreshortening by rejecting this event */
-            --i;
-            continue;
+            fprintf(stderr, "Strata Failure!\n");
+            return 1;
          }
       }
-      
-      retVal = intersect_rect(part, rectangle,
-                              &trans, &hit, &l1, &l2);
-      if ((0 == retVal)&&(1 == hit))
+   }
+
+   /* Run the workers, the first one on this thread. Without a thread of its own, a worker runs here too */
+   for (t = 1; t < threads; ++t)
+   {
+      jobs[t].started = (0 == pthread_create(&jobs[t].thread, NULL, tele_run, &jobs[t]));
+      if (!jobs[t].started)
+         tele_run(&jobs[t]);
+   }
+   tele_run(&jobs[0]);
+   for (t = 1; t < threads; ++t)
+      if (jobs[t].started)
+         pthread_join(jobs[t].thread, NULL);
+
+   /* Merge the tallies in the order of the workers */
+   int    count = 0;
+   int    count_f = 0;
+   int    count_diff = 0;
+   double sum_e = 0.0;
+   int    status = 0;
+   char   buf[4096];
+   size_t len;
+
+   for (t = 0; t < threads; ++t)
+   {
+      tele_job *job = &jobs[t];
+
+      count += job->count;
+      count_f += job->count_f;
+      count_diff += job->count_diff;
+      sum_e += job->sum_e;
+      status |= job->status;
+
+      if (t > 0)
       {
-         if (f_outH != NULL)
+         if (job->f_outH != NULL)
          {
-            fprintf(f_outH, "%e \t %e\n", t, p);
+            rewind(job->f_outH);
+            while ((len = fread(buf, 1, sizeof(buf), job->f_outH)) > 0)
+               fwrite(buf, 1, len, f_outH);
+            fclose(job->f_outH);
          }
-         ++count;
+         gun_delete(job->contextI);
+         gun_delete(job->contextL);
+         gun_delete(job->contextW);
       }
    }
+   if (0 != status)
+      return 1;
 
    gun_delete(contextI);
    gun_delete(contextL);
@@ -316,6 +867,44 @@ int main(int argc, char *argv[])
 
    double ratio = (double)count/(double)total;
    double ratio_err = sqrt((double)count)/(double)total;
+
+   if (replicas > 0)
+   {
+      /* Standard error of the mean over the replicas */
+      double sum_rep = 0.0;
+      double sum2_rep = 0.0;
+      double var;
+
+      for (i = 0; i < replicas; ++i)
+      {
+         sum_rep += rep_ratio[i];
+         sum2_rep += rep_ratio[i]*rep_ratio[i];
+      }
+      var = (sum2_rep - sum_rep*sum_rep/(double)replicas)/(double)(replicas - 1);
+      ratio_err = sqrt(((var > 0.0) ? var : 0.0)/(double)replicas);
+   }
+   if (strata_div > 0)
+   {
+      /* Stratified estimates of the workers, weighted by their share of the events */
+      double var = 0.0;
+
+      ratio = 0.0;
+      for (t = 0; t < threads; ++t)
+      {
+         double w = (double)jobs[t].events/(double)total;
+
+         ratio += w*jobs[t].ratio;
+         var += (w*jobs[t].ratio_err)*(w*jobs[t].ratio_err);
+         strata_delete(jobs[t].strat);
+      }
+      ratio_err = sqrt(var);
+   }
+   free(rep_ratio);
+   free(jobs);
+
+   /* Events inside of the cone stand for its share of the flux */
+   ratio *= cone_weight;
+   ratio_err *= cone_weight;
    printf("Ratio: %e +- %e\n", ratio, ratio_err);
 
    /* Scale for total flux through detector 1 */
@@ -327,9 +916,25 @@ int main(int argc, char *argv[])
    {
       rate_det1 = total_rate_per_m2 * width * length;
    }
+   else
+   {
+      rate_det1 = rate_table;
+   }
 
    printf("Rate in detector 1: %e Hz\n", rate_det1);
    printf("Rate in telescope : %e Hz +- %e Hz\n", rate_det1*flux_scale*ratio, rate_det1*flux_scale*ratio_err);
+   if ((flux >= 3) && (count > 0))
+      printf("Mean energy of hits: %e GeV\n", sum_e/(double)count);
+   if (precision == 2)
+   {
+      /* Error of the difference from the events with different results */
+      printf("Single precision  : %d hits, %d events differ\n", count_f, count_diff);
+      printf("Ratio difference  : %e +- %e (single - double)\n",
+             cone_weight*(double)(count_f - count)/(double)total, cone_weight*sqrt((double)count_diff)/(double)total);
+   }
+
+   if (use_k)
+      printf("Acceptance cone   : cos %e, %e of the flux\n", cos_cone, cone_weight);
 
    if (f_outR != NULL)
       fclose(f_outR);
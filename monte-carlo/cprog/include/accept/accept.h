@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ACCEPT_H_
+#define ACCEPT_H_
+
+/**************************************************/
+/* Closed form acceptance of a telescope of two   */
+/* identical, parallel rectangles (as in 'tele'). */
+/**************************************************/
+
+/* Geometric factor for an intensity ~ cos^n(zenith) [m^2 sr] */
+/**
+ ** 'length', 'width' : Full sides of the rectangles [m]. The telescope is tilted by
+ **                       'theta' around the side 'length', as in 'tele'.
+ ** 'separation'      : Distance between the rectangles [m].
+ ** 'n'               : Even power of cos(zenith): 0 is isotropic, 2 is PDG.
+ ** The rate is the vertical intensity times this factor. It is the integral over
+ ** the offsets (dx, dy) between the crossing points of the overlap area
+ ** (length - |dx|)(width - |dy|) times s^2 cos^n / r^4: The part in dx is done
+ ** in closed form, the part in dy by Gauss-Legendre quadrature, to ~1e-12.
+ ** Returns -1.0 for odd or negative 'n' and sizes that are not positive.
+ **/
+extern double accept_tele(double length, double width, double separation, double theta, int n);
+
+/* Rate of the telescope [Hz] for the PDG (0) or isotropic (1) flux of 'pdg' */
+/**
+ ** Same values as 'Rate in telescope' of 'tele' with the same flux, only without the
+ ** statistical error. Returns -1.0 for an unknown flux or wrong sizes.
+ **/
+extern double accept_tele_rate(int flux, double length, double width, double separation, double theta);
+
+#endif /* ACCEPT_H_ */
@@ -32,6 +32,14 @@ typedef struct g_line {
    vec3 direction;
 } g_line;
 
+/* A 'ray' is a line that is handed around by pointer */
+/**
+ ** Same layout and rules as 'g_line'. The '_prepared' functions take it by pointer,
+ ** so one ray can be filled once per particle and tested against many objects
+ ** without copies.
+ **/
+typedef g_line g_ray;
+
 /* Defines a 'plane' (with infinite area) in three dimensions */
 /**
  ** 'origin' : A point on the plane
@@ -65,6 +73,84 @@ typedef struct g_rectangle {
    double edge2_len;
 } g_rectangle;
 
+/* A 'plane' prepared for repeated intersections */
+/**
+ ** 'offset' : The dot-product of 'origin' and 'normal', i.e. the signed distance
+ **              of the plane from the coordinate origin.
+ ** Fill it once with 'prepare_plane' and keep it for as long as the plane does not move.
+ **/
+typedef struct g_plane_prepared {
+   vec3   origin;
+   vec3   normal;
+   double offset;
+} g_plane_prepared;
+
+/* A 'rectangle' prepared for repeated intersections */
+/**
+ ** Holds the plane of the rectangle and the dot-products of 'origin' with the edges,
+ ** so the local coordinates of a crossing point are one dot-product each.
+ ** 'len' are the half lengths 'edgeN_len'.
+ ** Fill it once with 'prepare_rect' and keep it for as long as the rectangle does not move.
+ **/
+typedef struct g_rect_prepared {
+   g_plane_prepared plane;
+   vec3   edge[2];
+   double edge_offset[2];
+   double len[2];
+} g_rect_prepared;
+
+/* Single precision copy of a prepared 'rectangle', for 'intersect_rect_nf' */
+typedef struct g_rect_prepared_f {
+   vec3f  normal;
+   float  offset;
+   vec3f  edge[2];
+   float  edge_offset[2];
+   float  len[2];
+} g_rect_prepared_f;
+
+/* Defines a 'disk' in three dimensions, e.g. a round scintillator */
+/**
+ ** 'origin' : The center point of the disk.
+ ** 'normal' : The vector normal to the disk, as for 'g_rectangle'.
+ ** 'edgeN'  : The N'th coordinate unit vector inside the plane of the disk, for the
+ **              local coordinates of a crossing point. As for 'g_rectangle'.
+ ** 'radius' : The radius of the disk.
+ **/
+typedef struct g_disk {
+   vec3 origin;
+   vec3 normal;
+   vec3 edge1;
+   vec3 edge2;
+   double radius;
+} g_disk;
+
+/* A 'disk' prepared for repeated intersections, as 'g_rect_prepared' */
+typedef struct g_disk_prepared {
+   g_plane_prepared plane;
+   vec3   edge[2];
+   double edge_offset[2];
+   double radius2;
+} g_disk_prepared;
+
+/* Defines a closed 'cylinder' in three dimensions, e.g. the housing of a PMT */
+/**
+ ** 'origin'   : The center point of the cylinder (halfway between the caps, on the axis).
+ ** 'axis'     : The unit vector along the axis.
+ ** 'edgeN'    : Two unit vectors orthogonal to 'axis' and to each other, for the local
+ **                coordinates across the axis.
+ ** 'radius'   : The radius of the wall.
+ ** 'axis_len' : The length along the axis, measured from the origin to one cap,
+ **                and therefore half the value of the total length.
+ **/
+typedef struct g_cylinder {
+   vec3 origin;
+   vec3 axis;
+   vec3 edge1;
+   vec3 edge2;
+   double radius;
+   double axis_len;
+} g_cylinder;
+
 /* Defines a 'box' in three dimensions */
 /**
  ** 'origin'    : The center point of the box (where the four diagonals cross).
@@ -84,10 +170,351 @@ typedef struct g_box {
    double edge3_len;
 } g_box;
 
+/* A rigid 'pose': Rotation and translation of a detector or a whole setup */
+/**
+ ** A point 'p' given in the local frame is at 'rot * p + trans' in the world frame,
+ ** a direction only takes the rotation. 'rot' *MUST* be orthonormal.
+ **/
+typedef struct g_pose {
+   mat33 rot;
+   vec3  trans;
+} g_pose;
+
+/* A 'box' prepared for repeated intersections */
+/**
+ ** Holds the box in its own frame: The rows of 'axis' are the unit 'edgeN' vectors,
+ ** so a point is moved into the box frame by a difference to 'origin' and three
+ ** dot-products. 'len' are the half lengths 'edgeN_len'.
+ ** Fill it once with 'prepare_box' and keep it for as long as the box does not move.
+ **/
+typedef struct g_box_prepared {
+   vec3   origin;
+   vec3   axis[3];
+   double len[3];
+} g_box_prepared;
+
+/* A 'cylinder' prepared for repeated intersections */
+/**
+ ** Holds the cylinder in its own frame, as 'g_box_prepared': The rows of 'axis'
+ ** are 'edge1', 'edge2' and the axis of the cylinder.
+ **/
+typedef struct g_cylinder_prepared {
+   vec3   origin;
+   vec3   axis[3];
+   double radius2;
+   double len;
+} g_cylinder_prepared;
+
+/* Maximum number of faces of a 'g_polyhedron' */
+#define G_POLY_MAX 16
+
+/* Defines a convex 'polyhedron' as the intersection of half-spaces, e.g. a trapezoidal bar */
+/**
+ ** 'faces' : Number of planes in 'face', 1 ... G_POLY_MAX.
+ ** 'face'  : The planes of the faces, with 'normal' pointing to the outside. The
+ **             inside of the polyhedron is on the inner side of all of them.
+ ** The faces must enclose a finite volume for the crossings to be finite.
+ **/
+typedef struct g_polyhedron {
+   int     faces;
+   g_plane face[G_POLY_MAX];
+} g_polyhedron;
+
+/* A 'polyhedron' prepared for repeated intersections: Its planes, as 'g_plane_prepared' */
+typedef struct g_poly_prepared {
+   int              faces;
+   g_plane_prepared face[G_POLY_MAX];
+} g_poly_prepared;
+
+/* Maximum number of layers of a 'g_stack_prepared' */
+#define G_STACK_MAX 32
+
+/* A stack of parallel rectangles prepared for repeated intersections, e.g. the layers of a hodoscope */
+/**
+ ** All layers share 'normal' and the edges, only their origin and size differ. The
+ ** projections of a ray onto these three vectors are then the same for all layers.
+ ** 'layers'      : Number of layers.
+ ** 'offset'      : Per layer, the dot-product of its origin and 'normal'.
+ ** 'edge_offset' : Per layer, the dot-products of its origin and the edges.
+ ** 'len'         : Per layer, the half lengths 'edgeN_len'.
+ ** Fill it once with 'prepare_stack'.
+ **/
+typedef struct g_stack_prepared {
+   vec3   normal;
+   vec3   edge[2];
+   int    layers;
+   double offset[G_STACK_MAX];
+   double edge_offset[2][G_STACK_MAX];
+   double len[2][G_STACK_MAX];
+} g_stack_prepared;
+
+/* Single precision copy of a prepared 'box', for 'intersect_box_nf' */
+typedef struct g_box_prepared_f {
+   vec3f  origin;
+   vec3f  axis[3];
+   float  len[3];
+} g_box_prepared_f;
+
 extern
 void rotate_vec(vec3 v_out, const vec3 v_in,
                 const vec3 rot_axis, double phi);
 
+/* Pose without rotation and translation */
+extern
+void pose_identity(g_pose *pose);
+
+/* Pose of the rotation of 'rotate_vec' by 'phi' around 'rot_axis' (no translation) */
+extern
+void pose_rotation(g_pose *pose, const vec3 rot_axis, double phi);
+
+/* Pose of 'inner' first, then 'outer'. 'out' may be one of them */
+extern
+void pose_compose(g_pose *out, const g_pose *outer, const g_pose *inner);
+
+/* Move a point, or turn a direction, from the local into the world frame */
+extern
+void pose_apply(vec3 out, const g_pose *pose, const vec3 in);
+
+extern
+void pose_apply_dir(vec3 out, const g_pose *pose, const vec3 in);
+
+/* Move the 'n' points given as arrays of their components (see 'intersect_rect_n') */
+/**
+ ** 'in' and 'out' may be the same arrays. 'in[2]' may be NULL for points on the
+ ** local xy-plane, e.g. on the surface of a detector.
+ **/
+extern
+void pose_apply_n(const g_pose *pose, int n,
+                  const double *const in[3], double *const out[3]);
+
+/* Place a rectangle or box given in the local frame into the world frame */
+extern
+void pose_rect(g_rectangle *out, const g_pose *pose, const g_rectangle *in);
+
+extern
+void pose_box(g_box *out, const g_pose *pose, const g_box *in);
+
+extern
+void pose_disk(g_disk *out, const g_pose *pose, const g_disk *in);
+
+extern
+void pose_cylinder(g_cylinder *out, const g_pose *pose, const g_cylinder *in);
+
+extern
+void pose_poly(g_polyhedron *out, const g_pose *pose, const g_polyhedron *in);
+
+extern
+void prepare_plane(g_plane_prepared *prepared, const g_plane *plane);
+
+extern
+void prepare_rect(g_rect_prepared *prepared, const g_rectangle *rectangle);
+
+/* Same results as 'intersect_plane' and 'intersect_rect', with cached dot-products */
+extern
+int intersect_plane_prepared(const g_ray *ray,
+                             const g_plane_prepared *plane,
+                             double *translation, vec3 cross_point);
+
+extern
+int intersect_rect_prepared(const g_ray *ray,
+                            const g_rect_prepared *rectangle,
+                            double *translation, int *hit,
+                            double *local_1, double *local_2);
+
+/* Intersect a block of 'n' rays with one rectangle */
+/**
+ ** The rays are given as arrays of their components: 'origin[0][i]' is the x value
+ ** of the origin of ray 'i'. For each ray 'hit' is set to 1 or 0, with the values
+ ** of 'intersect_rect_prepared' in 'translation', 'local_1' and 'local_2' (any of
+ ** these may be NULL). For rays parallel to the plane 'hit' is 0 and the other
+ ** values are undefined.
+ ** Runs on the vector units (AVX-512, AVX2 or scalar) chosen for 'vmath', with
+ ** the same results on all of them. Returns the number of hits.
+ **/
+extern
+int intersect_rect_n(const g_rect_prepared *rectangle, int n,
+                     const double *const origin[3],
+                     const double *const direction[3],
+                     int *hit, double *translation,
+                     double *local_1, double *local_2);
+
+/* Single precision variants of the block intersections */
+/**
+ ** Twice the lanes of the double kernels, for hit or miss decisions where float
+ ** precision is enough (e.g. paddles of cm size). The prepared objects are rounded
+ ** from the double ones with 'prepare_rect_f' and 'prepare_box_f'.
+ ** 'intersect_rect_nf' : Hit flags as 'intersect_rect_n'.
+ ** 'intersect_box_nf'  : 'hit' is 1 where the line crosses the box (two crossings of
+ **                         'intersect_box_prepared'), 'length' (may be NULL) is the
+ **                         distance between the crossings, else undefined.
+ ** Both return the number of hits.
+ **/
+extern
+void prepare_rect_f(g_rect_prepared_f *prepared, const g_rect_prepared *rectangle);
+
+extern
+void prepare_box_f(g_box_prepared_f *prepared, const g_box_prepared *box);
+
+extern
+int intersect_rect_nf(const g_rect_prepared_f *rectangle, int n,
+                      const float *const origin[3],
+                      const float *const direction[3],
+                      int *hit);
+
+extern
+int intersect_box_nf(const g_box_prepared_f *box, int n,
+                     const float *const origin[3],
+                     const float *const direction[3],
+                     int *hit, float *length);
+
+/* Intersections of a line with a disk */
+/**
+ ** As 'intersect_rect': Returns -1 or -2 if the line is parallel to the plane of the
+ ** disk (see 'intersect_plane'), else 0 with the crossing of the plane. 'hit' is 1
+ ** if it is inside of the radius, 'local_N' are the coordinates along 'edgeN'.
+ **/
+extern
+int intersect_disk(const g_line line,
+                   const g_disk disk,
+                   double *translation, int *hit,
+                   double *local_1, double *local_2);
+
+extern
+void prepare_disk(g_disk_prepared *prepared, const g_disk *disk);
+
+extern
+int intersect_disk_prepared(const g_ray *ray,
+                            const g_disk_prepared *disk,
+                            double *translation, int *hit,
+                            double *local_1, double *local_2);
+
+/* Block of 'n' rays with one disk, as 'intersect_rect_n' */
+extern
+int intersect_disk_n(const g_disk_prepared *disk, int n,
+                     const double *const origin[3],
+                     const double *const direction[3],
+                     int *hit, double *translation,
+                     double *local_1, double *local_2);
+
+/* Intersections of a line with a closed cylinder (wall and caps) */
+/**
+ ** As 'intersect_box': 'hit' is 2 if the line crosses the cylinder, else 0, and the
+ ** crossings are in 'translation', with the coordinates along 'edge1', 'edge2' and
+ ** the axis in 'local_N'. The crossings are ordered by 'translation'. On a cap the
+ ** axis coordinate is exactly +-'axis_len'. Lines that only touch the wall count
+ ** as crossing twice at the same point. Always returns 0.
+ **/
+extern
+int intersect_cylinder(const g_line line,
+                       const g_cylinder cylinder,
+                       double translation[2], int *hit,
+                       double local_1[2], double local_2[2], double local_3[2]);
+
+extern
+void prepare_cylinder(g_cylinder_prepared *prepared, const g_cylinder *cylinder);
+
+extern
+int intersect_cylinder_prepared(const g_ray *ray,
+                                const g_cylinder_prepared *cylinder,
+                                double translation[2], int *hit,
+                                double local_1[2], double local_2[2], double local_3[2]);
+
+/* Block of 'n' rays with one cylinder */
+/**
+ ** Rays as for 'intersect_rect_n'. 'hit' is 1 where the line crosses the cylinder,
+ ** with the entry and exit in 'translation_1' and 'translation_2' (same values as
+ ** 'intersect_cylinder_prepared', may be NULL), else 0 and undefined. Returns the
+ ** number of hits.
+ **/
+extern
+int intersect_cylinder_n(const g_cylinder_prepared *cylinder, int n,
+                         const double *const origin[3],
+                         const double *const direction[3],
+                         int *hit, double *translation_1, double *translation_2);
+
+/* Intersections of a line with a convex polyhedron */
+/**
+ ** Clips the line with the half-space of every face (Kay and Kajiya): 'hit' is 2 if
+ ** the line crosses the polyhedron, else 0. The entry and exit are in 'translation',
+ ** ordered, and the faces they are on in 'face' (may be NULL). A line parallel to a
+ ** face misses if it is outside of that face's plane. Returns 0, or -1 if 'faces' is
+ ** not within 1 ... G_POLY_MAX.
+ **/
+extern
+int intersect_poly(const g_line line,
+                   const g_polyhedron poly,
+                   double translation[2], int *hit, int face[2]);
+
+extern
+int prepare_poly(g_poly_prepared *prepared, const g_polyhedron *poly);
+
+extern
+int intersect_poly_prepared(const g_ray *ray,
+                            const g_poly_prepared *poly,
+                            double translation[2], int *hit, int face[2]);
+
+/* Block of 'n' rays with one polyhedron */
+/**
+ ** Rays as for 'intersect_rect_n'. 'hit' is 1 where the line crosses the polyhedron,
+ ** with the entry and exit in 'translation_1' and 'translation_2' (same values as
+ ** 'intersect_poly_prepared', may be NULL), else 0 and undefined. Returns the number
+ ** of hits.
+ **/
+extern
+int intersect_poly_n(const g_poly_prepared *poly, int n,
+                     const double *const origin[3],
+                     const double *const direction[3],
+                     int *hit, double *translation_1, double *translation_2);
+
+/* Prepare 'num' rectangles as one stack */
+/**
+ ** The rectangles must have the same 'normal', 'edge1' and 'edge2' (up to 1.0E-12
+ ** in each component), e.g. layers of paddles along x and y described as rectangles
+ ** with the same edges but swapped lengths. Returns 0, or -1 if the edges differ or
+ ** 'num' is not within 1 ... G_STACK_MAX.
+ **/
+extern
+int prepare_stack(g_stack_prepared *prepared, const g_rectangle *layers, int num);
+
+/* Intersect a line with all layers of a stack */
+/**
+ ** The projections of the line onto the normal and the edges are taken once, then
+ ** every layer is one multiply-add for the crossing and one for each local coordinate.
+ ** Per layer 'k', 'hit[k]' is 1 or 0 and 'translation[k]', 'local_1[k]', 'local_2[k]'
+ ** (may be NULL) are as for 'intersect_rect_prepared', up to rounding: The crossing
+ ** uses the reciprocal of the projection onto the normal. Returns the number of layers
+ ** hit, or -1 (with all 'hit' set to 0) if the line is parallel to the layers.
+ **/
+extern
+int intersect_stack_prepared(const g_ray *ray,
+                             const g_stack_prepared *stack,
+                             double *translation, int *hit,
+                             double *local_1, double *local_2);
+
+/* Block of 'n' rays with all layers of a stack */
+/**
+ ** Rays as for 'intersect_rect_n'. The results of ray 'i' with layer 'k' are at
+ ** index k*n + i of 'hit', 'translation', 'local_1' and 'local_2' (the last three may
+ ** be NULL), with the same values as 'intersect_stack_prepared'. Returns the number of
+ ** rays that hit all layers.
+ **/
+extern
+int intersect_stack_n(const g_stack_prepared *stack, int n,
+                      const double *const origin[3],
+                      const double *const direction[3],
+                      int *hit, double *translation,
+                      double *local_1, double *local_2);
+
+/* Acceptance cone of two parallel rectangles, e.g. the detectors of a telescope */
+/**
+ ** Returns the smallest |cos| between the normal of 'first' and any line that passes
+ ** through both rectangles, so directions with a smaller |cos| cannot hit both.
+ ** The bound is conservative (from the lines between the corners). Returns 0.0,
+ ** i.e. no limit, if the rectangles are not parallel or touch.
+ **/
+extern
+double accept_cos_rect(const g_rectangle *first, const g_rectangle *second);
+
 extern
 int intersect_plane(const g_line line,
                     const g_plane plane,
@@ -105,4 +532,14 @@ int intersect_box(const g_line line,
                   double translation[2], int *hit,
                   double local_1[2], double local_2[2], double local_3[2]);
 
+extern
+void prepare_box(g_box_prepared *prepared, const g_box *box);
+
+/* Same results as 'intersect_box', by the slab method in the frame of the box */
+extern
+int intersect_box_prepared(const g_ray *line,
+                           const g_box_prepared *box,
+                           double translation[2], int *hit,
+                           double local_1[2], double local_2[2], double local_3[2]);
+
 #endif /* GEOMETRY_H_ */
@@ -18,12 +18,90 @@
 #ifndef GUN_H_
 #define GUN_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rng/rng.h"
+
 typedef void *gun_ctx;
-typedef int (*gun_trans)(double* out);
+typedef int (*gun_trans)(const void *par, rng_stream *rng, double* out);
+typedef int (*gun_trans_n)(const void *par, rng_stream *rng, int n, double **out);
 
 extern gun_ctx gun_init(int num_params);
+
+/* Create a gun that keeps its own copy of a parameter block */
+/**
+ ** The 'par_size' bytes at 'par' are copied into the new gun and handed to
+ ** every 'gun_trans' of it as first argument. Guns never share parameters,
+ ** so any number of them can coexist and be used from different threads.
+ **/
+extern gun_ctx gun_init_par(int num_params, const void *par, size_t par_size);
+
+/* Create a gun with the transforms and a copy of the parameters of 'gt' */
+/**
+ ** The copy starts on the next default sub-stream, as a new gun, without the feed
+ ** of 'gt'. Cheaper than building the tables of a gun again, e.g. for a gun per
+ ** thread. Returns NULL on failure.
+ **/
+extern gun_ctx gun_copy(gun_ctx gt);
+extern void *gun_par(gun_ctx gt);
+/* A transform may fill several consecutive parameters, starting at 'idx'.
+   The slots it covers are left unconfigured and skipped. */
 extern int gun_config(gun_ctx gt, int idx, gun_trans tr);
 extern int gun_event(gun_ctx gt, double *out);
 extern void gun_delete(gun_ctx gt);
 
+/* Generate a batch of events into caller owned columns */
+/**
+ ** 'columns[idx]' must point to 'n' doubles and receives parameter 'idx' of
+ ** all events (structure-of-arrays). Parameters with a 'gun_trans_n' set by
+ ** 'gun_config_n' are filled by one call for the whole batch, the others by
+ ** calling their 'gun_trans' for each event.
+ ** The values are drawn column by column, so a batch is a different (but
+ ** equally distributed) sequence than 'n' calls of 'gun_event'.
+ **/
+extern int gun_config_n(gun_ctx gt, int idx, gun_trans_n tr_n);
+extern int gun_event_n(gun_ctx gt, int n, double **columns);
+
+/* Random number stream owned by the gun */
+/**
+ ** Each new gun starts with the default seed on its own sub-stream, numbered
+ ** in the order of creation. Guns may be created or copied on several threads
+ ** at once: They still get a sub-stream each, but which one depends on the
+ ** timing of the threads. Parallel workers should call 'gun_seed' with a
+ ** common seed and a distinct 'stream' each, or 'gun_skip' to a disjoint part
+ ** of a single stream.
+ **/
+extern int gun_seed(gun_ctx gt, uint64_t seed, uint64_t stream);
+extern int gun_skip(gun_ctx gt, uint64_t n);
+extern rng_stream *gun_rng(gun_ctx gt);
+
+/* Number of uniform values drawn per event, set by the gun constructors */
+/**
+ ** The first two draws of a direction gun are its polar and azimuth variables,
+ ** as far as its sampling method has them.
+ **/
+extern int gun_config_draws(gun_ctx gt, int draws);
+extern int gun_draws(gun_ctx gt);
+
+/* Take the uniform values of the gun from 'feed' instead of its generator */
+/**
+ ** The values are requested event by event, 'gun_draws' per event in order.
+ ** A NULL 'feed' returns to the generator of the gun.
+ **/
+extern int gun_feed(gun_ctx gt, rng_feed feed, void *src);
+
+/* Draw the events of the gun from a scrambled Sobol sequence */
+/**
+ ** The k-th uniform value of each event becomes dimension 'dim0'+k of a
+ ** randomized quasi-Monte-Carlo point. Guns attached to the same 'seed' and
+ ** 'stream' (one replica) with disjoint dimensions therefore sample one joint
+ ** point per event, as long as each of them generates the same number of events.
+ ** Independent replicas for error estimates use different 'stream' values.
+ ** Returns the first dimension not used by this gun, or -1 if the gun does
+ ** not declare its draws or the dimensions exceed QMC_MAX_DIM.
+ ** Seeding the gun again returns it to pseudo-random numbers.
+ **/
+extern int gun_qmc(gun_ctx gt, uint64_t seed, uint64_t stream, int dim0);
+
 #endif /* GUN_H_ */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef GUN_DIR_H_
+#define GUN_DIR_H_
+
+#include "gun/gun.h"
+#include "vector/vector.h"
+
+/* Event of a direction gun: The unit vector along the particle path */
+typedef struct {
+   double ux;
+   double uy;
+   double uz;
+} dir_output;
+
+typedef union {
+   double     pars[3];
+   dir_output out;
+} dir_event;
+
+/* Build the unit vector for polar angle 'cos_t' and azimuth 2*pi*'u_phi' */
+extern void dir_from_cos(double cos_t, double u_phi, double *out);
+
+/* Same for columns: Reads cos_t from 'out[2]' and u_phi from 'out[0]', in place */
+extern void dir_from_cos_n(int n, double **out);
+
+/* Local frame around the normal of a surface that particles cross */
+/**
+ ** 'n'   : Unit normal of the surface, flipped to point to the upper half (z >= 0).
+ ** 't'   : Unit vector orthogonal to 'n', in the plane of 'n' and the zenith.
+ ** 'w'   : Completes the right handed frame, n x t.
+ ** 'a'   : Projection of the zenith onto 'n' (cosine of the tilt).
+ ** 'b'   : Projection of the zenith onto 't' (sine of the tilt).
+ **/
+typedef struct dir_frame {
+   vec3   n;
+   vec3   t;
+   vec3   w;
+   double a;
+   double b;
+} dir_frame;
+
+extern void dir_frame_init(dir_frame *frame, const vec3 normal);
+
+/* Direction from a point (x, y) in the unit disk of the frame: x*t + y*w + h*n.
+   The result is flipped to the upper half, as a particle path runs in both directions */
+extern void dir_from_disk(const dir_frame *frame, double x, double y, double *out);
+
+#endif /* GUN_DIR_H_ */
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef GUN_ENERGY_H_
+#define GUN_ENERGY_H_
+
+#include "gun/gun.h"
+#include "gun/gun_dir.h"
+
+/* Direction and energy of muons at sea level (dir_event and energy) */
+/**
+ ** Samples the spectrum 'model' of 'j_spec' (0 = Gaisser, 1 = Reyna) jointly in
+ ** direction and total energy between 'e_min' and 'e_max' [GeV], without rejection.
+ ** The direction comes from an alias table of the intensity above 'e_min', like
+ ** 'gun_table_init'. The energy comes from tables of the inverse cumulative
+ ** distribution at fixed cos(zenith), interpolated in cos(zenith) and in the
+ ** probability. The tables follow the tail of the spectrum down to ~ 1E-12.
+ ** Columns: ux, uy, uz of the direction, then the energy [GeV].
+ ** With 'use_cos' set, the intensity is weighted with the 'foreshortening'
+ ** factor |cos| to the 'normal' of the surface that the particles cross.
+ ** Building the tables takes a moment: With a 'cache' path, they are read from
+ ** that file if it holds the same setup, else written to it. The file is only
+ ** meant for the machine that wrote it.
+ ** Returns NULL for an unknown model or an invalid energy range.
+ **/
+extern gun_ctx gun_energy_init(int model, const vec3 normal, int use_cos,
+                               double e_min, double e_max, const char *cache);
+
+/* Rate through a unit area with the given 'normal' [m^-2 s^-1], see 'gun_table_norm' */
+extern double gun_energy_norm(gun_ctx gt);
+
+#endif /* GUN_ENERGY_H_ */
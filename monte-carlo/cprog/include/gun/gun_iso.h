@@ -19,6 +19,7 @@
 #define GUN_ISO_H_
 
 #include "gun/gun.h"
+#include "gun/gun_dir.h"
 
 typedef struct {
    double theta;
@@ -38,4 +39,23 @@ typedef union {
 
 extern gun_ctx gun_iso_init(int use_cos);
 
+/* Same p.d.f, returning the direction as unit vector (dir_event) */
+extern gun_ctx gun_iso_dir_init(void);
+
+/* Directions of particles crossing a surface with the given 'normal' (dir_event) */
+/**
+ ** Samples the isotropic flux times the 'foreshortening' factor |cos| to the
+ ** normal directly, without rejecting events.
+ **/
+extern gun_ctx gun_iso_flux_init(const vec3 normal);
+
+/* Same, restricted to directions with |cos| >= 'cos_max' to the normal (dir_event) */
+/**
+ ** E.g. the acceptance cone of a telescope (see 'accept_cos_rect'). The events
+ ** stand for the share 'gun_iso_flux_cone_weight' of the flux of 'gun_iso_flux_init'.
+ ** Returns NULL if 'cos_max' is larger than 1.
+ **/
+extern gun_ctx gun_iso_flux_cone_init(const vec3 normal, double cos_max);
+extern double gun_iso_flux_cone_weight(const vec3 normal, double cos_max);
+
 #endif /* GUN_ISO_H_ */
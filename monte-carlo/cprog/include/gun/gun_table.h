@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef GUN_TABLE_H_
+#define GUN_TABLE_H_
+
+#include "gun/gun.h"
+#include "gun/gun_dir.h"
+
+/* Intensity for polar angle 'theta' and azimuth 'phi', like 'j_val_PDG' */
+typedef double (*gun_intensity)(double theta, double phi);
+
+/* Directions for any intensity model, from a table (dir_event) */
+/**
+ ** The intensity 'j' is tabulated on 'n_theta' x 'n_phi' cells of the upper
+ ** hemisphere, equally spaced in theta and phi. A cell is picked by the alias
+ ** method and the direction is uniform in solid angle inside of it, so every
+ ** event costs the same, whatever 'j' is.
+ ** With 'use_cos' set, the intensity is weighted with the 'foreshortening'
+ ** factor |cos| to the 'normal' of the surface that the particles cross.
+ ** Returns NULL if the intensity vanishes everywhere.
+ **/
+extern gun_ctx gun_table_init(gun_intensity j, const vec3 normal, int use_cos,
+                              int n_theta, int n_phi);
+
+/* Rate through a unit area with the given 'normal': Integral of j |cos| */
+/**
+ ** A NULL 'normal' at creation gives the integral of j over the hemisphere.
+ **/
+extern double gun_table_norm(gun_ctx gt);
+
+/* Intensity of a model with parameters 'data' */
+typedef double (*gun_intensity_d)(const void *data, double theta, double phi);
+
+/* The alias table of directions behind 'gun_table_init' */
+/**
+ ** For guns that sample more than the direction. The table is one block of
+ ** 'dir_table_size' bytes without pointers, so it can be put into the
+ ** parameters of a gun (see 'gun_init_par').
+ **/
+typedef struct dir_table dir_table;
+
+/* Bytes of a table with 'n_theta' x 'n_phi' cells, 0 for an invalid size */
+extern size_t dir_table_size(int n_theta, int n_phi);
+
+/* Fill 'tab' as 'gun_table_init' does. Returns -1 if the intensity vanishes everywhere */
+extern int dir_table_fill(dir_table *tab, gun_intensity_d j, const void *data,
+                          const vec3 normal, int use_cos, int n_theta, int n_phi);
+
+/* Direction from three uniform values 'u' */
+extern void dir_table_dir(const dir_table *tab, const double *u, double *out);
+
+/* Integral of j |cos|, see 'gun_table_norm' */
+extern double dir_table_norm(const dir_table *tab);
+
+#endif /* GUN_TABLE_H_ */
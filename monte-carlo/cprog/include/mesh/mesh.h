@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef MESH_H_
+#define MESH_H_
+
+#include "geometry/geometry.h"
+
+/**********************************************************/
+/* A closed surface of triangles, e.g. a building or a    */
+/* hill loaded from an STL file, for the thickness of     */
+/* matter along the tracks of muons. A bounding volume    */
+/* hierarchy over the triangles (binned surface area      */
+/* heuristic, built on several threads) keeps the cost of */
+/* a query growing with the logarithm of their number.    */
+/**********************************************************/
+
+typedef void *mesh_ctx;
+
+/* A crossing of a line with the surface */
+/**
+ ** 'tri'         : Index of the triangle, in the order it was added.
+ ** 'enter'       : 1 if the line enters the inside there, else 0.
+ ** 'translation' : Where along the line it crosses.
+ **/
+typedef struct mesh_hit {
+   int    tri;
+   int    enter;
+   double translation;
+} mesh_hit;
+
+/* The crossings of a ray, in path order (see 'mesh_cross') */
+/**
+ ** 'hit' : The crossings.
+ ** 'num' : Number of crossings of the last ray.
+ ** 'cap' : Allocated length of 'hit'.
+ ** Start from all zero and keep it for many rays, as 'scene_segments'. Free it with
+ ** 'mesh_crossings_free'.
+ **/
+typedef struct mesh_crossings {
+   mesh_hit *hit;
+   int       num;
+   int       cap;
+} mesh_crossings;
+
+/* Empty mesh. Returns NULL on failure */
+extern mesh_ctx mesh_init(void);
+extern void mesh_delete(mesh_ctx m);
+
+/* Add a triangle. Returns its index, or -1 on failure */
+/**
+ ** The corners are kept in single precision, as in STL files. Seen from the outside
+ ** they go around counterclockwise (the outer normal is (v1 - v0) x (v2 - v0)).
+ ** The mesh must be built again before the next query.
+ **/
+extern int mesh_add_tri(mesh_ctx m, const vec3 v0, const vec3 v1, const vec3 v2);
+
+/* Add all triangles of an STL file, ASCII or binary */
+/**
+ ** The corners are moved with 'pose' (NULL to keep them as they are). The normals
+ ** of the file are not used: The order of the corners gives the outside, as the
+ ** format demands. Returns the number of triangles read, or -1 (with none of them
+ ** added) if the file can not be read or is not valid.
+ **/
+extern int mesh_load_stl(mesh_ctx m, const char *file_name, const g_pose *pose);
+
+/* Number of triangles */
+extern int mesh_num(mesh_ctx m);
+
+/* Build the hierarchy over all triangles added so far */
+/**
+ ** Subtrees are built on up to 'threads' threads (all processors for 0 or less).
+ ** The hierarchy is the same for any number of threads. Returns 0, or -1 on failure.
+ **/
+extern int mesh_build(mesh_ctx m, int threads);
+
+/* All crossings of a ray with the surface, and the thickness of the inside along it */
+/**
+ ** Fills 'cr' with the crossings between 't_min' and 't_max' in path order, and
+ ** stores the length of the line inside of the mesh between 't_min' and 't_max' in
+ ** 'thickness' (may be NULL), e.g. 0.0 and HUGE_VAL for the matter a muon crossed
+ ** before it reaches a detector at the origin of the ray, looking back along its
+ ** track. The inside is where the line entered more often than it left, so the ray
+ ** may start inside, and a line through an edge or a corner is only counted once.
+ ** Returns the number of crossings in 'cr', or -1 if the mesh is not built or the
+ ** buffer could not grow. May be called from several threads, with a buffer each.
+ **/
+extern int mesh_cross(mesh_ctx m, const g_ray *ray, double t_min, double t_max,
+                      mesh_crossings *cr, double *thickness);
+
+extern void mesh_crossings_free(mesh_crossings *cr);
+
+#endif /* MESH_H_ */
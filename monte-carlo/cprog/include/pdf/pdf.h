@@ -18,8 +18,14 @@
 #ifndef PDF_H_
 #define PDF_H_
 
-extern int uniform_pdf(double min, double max, double *out);
-extern int decay_pdf(double lambda, double *out);
-extern int isotropic_sphere_pdf(double *theta, double *phi);
-extern int pdg_sphere_pdf(double *theta, double *phi);
+#include "rng/rng.h"
+
+extern int uniform_pdf(rng_stream *rng, double min, double max, double *out);
+extern int decay_pdf(rng_stream *rng, double lambda, double *out);
+extern int isotropic_sphere_pdf(rng_stream *rng, double *theta, double *phi);
+extern int pdg_sphere_pdf(rng_stream *rng, double *theta, double *phi);
+
+/* Batch versions: Fill 'out' with 'n' values */
+extern int uniform_pdf_n(rng_stream *rng, double min, double max, int n, double *out);
+extern int decay_pdf_n(rng_stream *rng, double lambda, int n, double *out);
 #endif
@@ -45,4 +45,23 @@ extern double j_val_ZEN(double theta, double phi);
 /* Total rate of PDG flux through an area with rotated angle from zenith */
 extern double r_tot_PDG(double theta, double area);
 
+/* Muon mass [GeV] */
+extern const double mu_mass;
+
+/**************************************************/
+/* Return the differential muon intensity at sea  */
+/* level [m^-2 s^-1 sr^-1 GeV^-1] for the total   */
+/* energy [GeV] and \theta = Polar angle          */
+/**************************************************/
+
+/* Select one of the spectra */
+extern double j_spec(int model, double energy, double theta);
+
+/* Gaisser's formula with cos(theta) corrected for the curvature of the earth.
+   Too high below ~ 10 GeV, as it neglects energy loss and decay */
+extern double j_spec_gaisser(double energy, double theta);
+
+/* Fit of Reyna to measured spectra, for momenta 1 GeV/c to 2 TeV/c */
+extern double j_spec_reyna(double energy, double theta);
+
 #endif /* PDG_H_ */
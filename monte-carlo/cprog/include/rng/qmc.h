@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QMC_H_
+#define QMC_H_
+
+#include <stdint.h>
+
+/* Highest number of dimensions of a joint quasi-random point */
+#define QMC_MAX_DIM 16
+
+/* Defines a view on some dimensions of a scrambled Sobol sequence */
+/**
+ ** All views with the same (seed, stream) see the same sequence of joint
+ ** points, each point being a randomized quasi-Monte-Carlo sample of the
+ ** unit hypercube. A view returns the coordinates 'dim0' to 'dim0'+'dims'-1
+ ** of one point after the other, before moving on to the next point.
+ ** Different 'stream' values give independent randomizations (replicas).
+ **
+ ** 'dim0'  : First dimension returned by the view.
+ ** 'dims'  : Number of dimensions returned per point.
+ ** 'd'     : Next dimension of the current point, relative to 'dim0'.
+ ** 'index' : Index of the current point.
+ ** 'x'     : Current point before scrambling, in Gray code order.
+ ** 'v'     : Direction numbers of each dimension.
+ ** 'seed'  : Scrambling seed of each dimension.
+ **/
+typedef struct qmc_view {
+   int      dim0;
+   int      dims;
+   int      d;
+   uint32_t index;
+   uint32_t x[QMC_MAX_DIM];
+   uint32_t v[QMC_MAX_DIM][32];
+   uint32_t seed[QMC_MAX_DIM];
+} qmc_view;
+
+/* Prepare a view. Returns -1 if the dimensions are out of range */
+extern int qmc_init(qmc_view *qmc, uint64_t seed, uint64_t stream, int dim0, int dims);
+
+/* Return the next coordinate in the interval [0,1) */
+extern double qmc_next(qmc_view *qmc);
+
+/* Same as 'qmc_next', usable as 'rng_feed' of a stream */
+extern double qmc_feed(void *qmc);
+
+#endif /* QMC_H_ */
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdint.h>
+
+/* Source of uniform values that can take the place of the generator */
+typedef double (*rng_feed)(void *src);
+
+/* Seed used when no explicit seed is given */
+extern const uint64_t rng_default_seed;
+
+/* Defines a stream of uniform random numbers */
+/**
+ ** Counter based generator (Philox4x32-10). Every block of random bits is
+ ** a pure function of (seed, stream, block counter), so a stream can be
+ ** positioned anywhere in its sequence without generating the numbers before.
+ **
+ ** 'key'    : The 64 bit seed, split into two words.
+ ** 'stream' : Index of the sub-stream. Different indices give independent sequences
+ **              for the same seed.
+ ** 'block'  : Counter of the next block to be generated.
+ ** 'buf'    : Random bits of the current block. One block holds two uniform values.
+ ** 'idx'    : Next unused uniform value in 'buf'. A value of 2 marks an empty buffer.
+ ** 'feed'   : Optional source of the uniform values instead of the generator, e.g.
+ **              a quasi-random view (see 'rng/qmc.h'). It is called with 'src'.
+ **/
+typedef struct rng_stream {
+   uint32_t key[2];
+   uint64_t stream;
+   uint64_t block;
+   uint32_t buf[4];
+   int      idx;
+   rng_feed feed;
+   void    *src;
+} rng_stream;
+
+/* The raw generator: Encrypt the counter 'ctr' with 'key' */
+extern void rng_philox4x32(uint32_t out[4], const uint32_t ctr[4], const uint32_t key[2]);
+
+/* Start the sequence of sub-stream 'stream' for the given 'seed'. Detaches any feed */
+extern void rng_seed(rng_stream *rng, uint64_t seed, uint64_t stream);
+
+/* Advance the stream by 'n' uniform values without generating them */
+extern void rng_skip(rng_stream *rng, uint64_t n);
+
+/* Number of uniform values consumed from the stream so far */
+extern uint64_t rng_position(const rng_stream *rng);
+
+/* Return a uniform value in the interval [0,1) with 53 bits of resolution */
+extern double rng_uniform(rng_stream *rng);
+
+/* Fill 'out' with 'n' uniform values, same sequence as 'n' calls of 'rng_uniform' */
+extern void rng_uniform_n(rng_stream *rng, int n, double *out);
+
+#endif /* RNG_H_ */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "geometry/geometry.h"
+
+/**********************************************************/
+/* A scene of many detector volumes (rectangles and       */
+/* boxes), each with an ID. A bounding volume hierarchy   */
+/* over the volumes keeps the cost of a query growing     */
+/* with the logarithm of their number.                    */
+/**********************************************************/
+
+typedef void *scene_ctx;
+
+/* A volume crossed by a line */
+/**
+ ** 'id'          : ID given when the volume was added.
+ ** 'hit'         : Number of crossings: 1 for a rectangle, 2 for a box.
+ ** 'translation' : Where the line enters and leaves the volume, along its direction.
+ **                   Both are the same for a rectangle.
+ **/
+typedef struct scene_hit {
+   int    id;
+   int    hit;
+   double translation[2];
+} scene_hit;
+
+/* Segments of a ray through the volumes, in path order (see 'scene_segment') */
+/**
+ ** 'seg' : The segments: 'id', and the entry and exit in 'translation'. 'hit' is
+ **           as for 'scene_hit'.
+ ** 'num' : Number of segments of the last ray.
+ ** 'cap' : Allocated length of 'seg'.
+ ** Start from all zero and keep it for many rays: It only grows when a ray has more
+ ** segments than ever before. Free it with 'scene_segments_free'.
+ **/
+typedef struct scene_segments {
+   scene_hit *seg;
+   int        num;
+   int        cap;
+} scene_segments;
+
+/* Empty scene. Returns NULL on failure */
+extern scene_ctx scene_init(void);
+extern void scene_delete(scene_ctx sc);
+
+/* Add a volume. Returns its index in the scene, or -1 on failure */
+/**
+ ** The IDs are not checked: Several volumes may share one.
+ ** The scene must be built again before the next query.
+ **/
+extern int scene_add_rect(scene_ctx sc, int id, const g_rectangle *rectangle);
+extern int scene_add_box(scene_ctx sc, int id, const g_box *box);
+
+/* Number of volumes */
+extern int scene_num(scene_ctx sc);
+
+/* Build the hierarchy over all volumes added so far */
+extern int scene_build(scene_ctx sc);
+
+/* All volumes crossed by the line, in path order (by entry) */
+/**
+ ** Like the functions of 'geometry', the whole (infinite) line is taken. Up to
+ ** 'max_hits' crossed volumes are stored in 'hits', the ones entered first.
+ ** Returns the number of crossed volumes, which may be larger than 'max_hits',
+ ** or -1 if the scene is not built. May be called from several threads at once.
+ **/
+extern int scene_intersect(scene_ctx sc, const g_ray *ray,
+                           scene_hit *hits, int max_hits);
+
+/* Walk a ray through the volumes: All segments between 't_min' and 't_max' */
+/**
+ ** Fills 'segs' with the crossed volumes ordered by entry, with their entry and exit
+ ** clipped to 't_min' ... 't_max' (e.g. 0.0 and HUGE_VAL for a track that starts at
+ ** the origin of the ray). For volumes that do not overlap, this is the path of the
+ ** ray: The segments follow each other without overlap. A rectangle is a segment of
+ ** length zero. One pass over the hierarchy, front to back, that skips the parts
+ ** outside of the range. Returns the number of segments, or -1 if the scene is not
+ ** built or the buffer could not grow. Threads need a buffer each.
+ **/
+extern int scene_segment(scene_ctx sc, const g_ray *ray, double t_min, double t_max,
+                         scene_segments *segs);
+
+extern void scene_segments_free(scene_segments *segs);
+
+#endif /* SCENE_H_ */
@@ -25,4 +25,8 @@ extern const double pi;
 
 extern double val_omega(double th, double phi, const vec3 N, int flux,
                         double delTh, double delPhi);
+
+/* 'val_omega' for a row of 'n' azimuth values 'phi' at the same 'th' */
+extern void val_omega_n(double th, int n, const double *phi, const vec3 N, int flux,
+                        double delTh, double delPhi, double *out);
 #endif /* SPHERE_H_ */
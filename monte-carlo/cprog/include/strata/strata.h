@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef STRATA_H_
+#define STRATA_H_
+
+#include <stdint.h>
+
+#include "gun/gun.h"
+
+/* Most guns whose draws can be stratified together */
+#define STRATA_MAX_GUNS 8
+
+/* Most dimensions of the joint uniform point of an event */
+#define STRATA_MAX_DIM 16
+
+typedef void *strata_ctx;
+
+/* Create a stratification of the unit hypercube of 'dims' uniform values */
+/**
+ ** Dimension 'd' is cut into 'divs[d]' equal parts, so there are
+ ** divs[0] * ... * divs[dims-1] strata of equal volume. With 'lhs' set, the
+ ** events inside of a stratum form a Latin hypercube instead of independent
+ ** points. The error estimate is then an upper bound.
+ ** Returns NULL on invalid arguments.
+ **/
+extern strata_ctx strata_init(int dims, const int *divs, int lhs, uint64_t seed);
+/* Delete the stratification. Attached guns must not generate events afterwards */
+extern void strata_delete(strata_ctx st);
+
+/* Number of strata */
+extern int strata_num(strata_ctx st);
+
+/* Feed the uniform values of a gun from dimensions 'dim0' and up */
+/**
+ ** The gun uses 'gun_draws' dimensions, the first free dimension is returned
+ ** (-1 on failure). All attached guns must generate the same number of events.
+ **/
+extern int strata_attach(strata_ctx st, gun_ctx gt, int dim0);
+
+/* Plan a pass of 'n' events, sorted by stratum */
+/**
+ ** Without 'neyman' the events are spread evenly over the strata. With it,
+ ** 3/4 of the events follow the standard deviation of the values tallied so
+ ** far in each stratum (Neyman allocation), the rest is spread evenly.
+ ** Restarts all attached guns at the first event of the pass.
+ ** Returns -1 if there are less than 2 events per stratum.
+ **/
+extern int strata_plan(strata_ctx st, int n, int neyman);
+
+/* Record the value of the next event of the pass */
+extern int strata_tally(strata_ctx st, double value);
+
+/* Stratified estimate of the mean value and its standard error over all passes */
+/**
+ ** Each pass is estimated on its own and the passes are averaged by their
+ ** number of events. Fails unless every stratum of the last pass has a value.
+ **/
+extern int strata_estimate(strata_ctx st, double *mean, double *err);
+
+#endif /* STRATA_H_ */
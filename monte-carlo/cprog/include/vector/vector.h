@@ -27,7 +27,11 @@ extern const int z_c;
 typedef double vec3[3];
 typedef double mat33[3][3];
 
+/* Single precision, for the float variants of the batched geometry */
+typedef float vec3f[3];
+
 extern void copy_vec(vec3 out, const vec3 in);
+extern void copy_vec_f(vec3f out, const vec3 in);
 
 extern void scale_vec(vec3 v, double s);
 extern void scale_vec2(vec3 out, const vec3 in, double s);
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef VECTOR_INLINE_H_
+#define VECTOR_INLINE_H_
+
+#include "vector/vector.h"
+
+/**************************************************/
+/* Inline versions of the vector API, for code    */
+/* that calls it many times per particle (e.g.    */
+/* the geometry). Same operations in the same     */
+/* order as 'vector.c', so the same results.      */
+/* After this header, the calls of the 'vector.h' */
+/* names are inlined, unless VECTOR_NO_INLINE is  */
+/* defined. The exported functions stay, and are  */
+/* reached by '(dot_vec)(a, b)' or a pointer.     */
+/* Not to be included by 'vector.c' itself.       */
+/**************************************************/
+
+static inline void copy_vec_inline(vec3 out, const vec3 in)
+{
+   out[0] = in[0];
+   out[1] = in[1];
+   out[2] = in[2];
+}
+
+static inline void scale_vec_inline(vec3 v, double s)
+{
+   v[0] = s*v[0];
+   v[1] = s*v[1];
+   v[2] = s*v[2];
+}
+
+static inline void scale_vec2_inline(vec3 out, const vec3 in, double s)
+{
+   out[0] = s*in[0];
+   out[1] = s*in[1];
+   out[2] = s*in[2];
+}
+
+static inline void diff_vec_inline(vec3 out, const vec3 left, const vec3 right)
+{
+   out[0] = left[0] - right[0];
+   out[1] = left[1] - right[1];
+   out[2] = left[2] - right[2];
+}
+
+static inline void add_vec_inline(vec3 out, const vec3 left, const vec3 right)
+{
+   out[0] = left[0] + right[0];
+   out[1] = left[1] + right[1];
+   out[2] = left[2] + right[2];
+}
+
+static inline double dot_vec_inline(const vec3 v1, const vec3 v2)
+{
+   return (v1[0]*v2[0]) + (v1[1]*v2[1]) + (v1[2]*v2[2]);
+}
+
+static inline void cross_vec_inline(vec3 out, const vec3 a, const vec3 b)
+{
+   out[0] = a[1]*b[2] - a[2]*b[1];
+   out[1] = a[2]*b[0] - a[0]*b[2];
+   out[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static inline void mul_matrix_inline(vec3 x, const mat33 M, const vec3 y)
+{
+   x[0] = M[0][0]*y[0] + M[0][1]*y[1] + M[0][2]*y[2];
+   x[1] = M[1][0]*y[0] + M[1][1]*y[1] + M[1][2]*y[2];
+   x[2] = M[2][0]*y[0] + M[2][1]*y[1] + M[2][2]*y[2];
+}
+
+#ifndef VECTOR_NO_INLINE
+#define copy_vec(out, in) copy_vec_inline(out, in)
+#define scale_vec(v, s) scale_vec_inline(v, s)
+#define scale_vec2(out, in, s) scale_vec2_inline(out, in, s)
+#define diff_vec(out, left, right) diff_vec_inline(out, left, right)
+#define add_vec(out, left, right) add_vec_inline(out, left, right)
+#define dot_vec(v1, v2) dot_vec_inline(v1, v2)
+#define cross_vec(out, a, b) cross_vec_inline(out, a, b)
+#define mul_matrix(x, M, y) mul_matrix_inline(x, M, y)
+#endif
+
+#endif /* VECTOR_INLINE_H_ */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef VMATH_H_
+#define VMATH_H_
+
+/**********************************************************/
+/* Elementary functions over arrays, for the hot loops of */
+/* the samplers. The result may overwrite the input.      */
+/*                                                        */
+/* Largest errors against the exact result, as checked   */
+/* by 'test_vmath' (same for all kernels):                */
+/*   vmath_log    : 1 ulp                                 */
+/*   vmath_cbrt   : 1 ulp                                 */
+/*   vmath_sincos : 2 ulp for |x| < 2pi,                  */
+/*                  3 ulp for |x| <= 1E5, else libm       */
+/*   vmath_acos   : 1 ulp                                 */
+/* Arguments outside of these ranges and of the domain of */
+/* the kernels (zero, subnormal, huge, NaN, negative for  */
+/* log) are passed on to libm.                            */
+/**********************************************************/
+
+extern void vmath_log(int n, const double *x, double *y);
+extern void vmath_cbrt(int n, const double *x, double *y);
+extern void vmath_sincos(int n, const double *x, double *s, double *c);
+extern void vmath_acos(int n, const double *x, double *y);
+
+/* Name of the kernel in use: "avx512", "avx2" or "scalar" */
+/**
+ ** The build option VMATH_KERNEL fixes the kernel, or lets it be chosen
+ ** by the running processor ("auto"). A fixed kernel the processor does not
+ ** support falls back to "scalar".
+ **/
+extern const char *vmath_kernel(void);
+
+/* Switch to the named kernel, e.g. to compare them. Returns -1 if it is
+   not built in or not supported by the processor. Not while other threads
+   use the library */
+extern int vmath_use(const char *name);
+
+#endif /* VMATH_H_ */
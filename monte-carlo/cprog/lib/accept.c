@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+
+#include "accept/accept.h"
+#include "pdg/pdg.h"
+
+/* Nodes and weights of the 16 point Gauss-Legendre rule on [-1, 1], positive half */
+static const double gl_x[8] = {
+   0.0950125098376374, 0.2816035507792589, 0.4580167776572274, 0.6178762444026438,
+   0.7554044083550030, 0.8656312023878318, 0.9445750230732326, 0.9894009349916499 };
+static const double gl_w[8] = {
+   0.1894506104550685, 0.1826034150449236, 0.1691565193950025, 0.1495959888165767,
+   0.1246289712555339, 0.0951585116824928, 0.0622535239386479, 0.0271524594117541 };
+
+/* Integral of (A - |x|) / (x^2 + q^2)^m over -A..A, for m >= 2 */
+/**
+ ** With J_m the integral of 1/(x^2 + q^2)^m over 0..A (by the recursion from atan)
+ ** and L_m the one of x/(x^2 + q^2)^m, it is 2 (A J_m - L_m).
+ **/
+static double accept_kernel(double A, double q, int m)
+{
+   double q2 = q*q;
+   double t = A*A/q2;
+   double j = atan(A/q)/q;
+   double l;
+   int    k;
+
+   for (k = 1; k < m; ++k)
+      j = A/(2.0*k*q2*pow(A*A + q2, k)) + (2.0*k - 1.0)/(2.0*k*q2) * j;
+
+   /* Without cancellation for A << q: 1 - (1 + t)^(1-m) */
+   l = -expm1((1.0 - m)*log1p(t)) / (2.0*(m - 1.0)*pow(q2, m - 1));
+
+   return 2.0*(A*j - l);
+}
+
+/* Integrand in dy >= 0 for the offsets +dy and -dy, after the integral in dx */
+static double accept_dy(double dy, double a2, double b2, double s, double c, double si, int n)
+{
+   double q = sqrt(dy*dy + s*s);
+   double k = accept_kernel(a2, q, 2 + n/2);
+   double g_p = pow(c*s + si*dy, n);
+   double g_m = pow(c*s - si*dy, n);
+
+   return (b2 - dy) * s*s * (g_p + g_m) * k;
+}
+
+double accept_tele(double length, double width, double separation, double theta, int n)
+{
+   double c = cos(theta);
+   double si = sin(theta);
+   double lo = 0.0;
+   double w = separation;
+   double sum = 0.0;
+
+   if ((n < 0) || (n % 2) || (length <= 0.0) || (width <= 0.0) || (separation <= 0.0))
+      return -1.0;
+
+   /* Panels in dy of doubling width from the peak at 0, which is as wide as the separation */
+   while (lo < width)
+   {
+      double hi = (lo + w < width) ? lo + w : width;
+      double mid = 0.5*(hi + lo);
+      double half = 0.5*(hi - lo);
+      int    i;
+
+      for (i = 0; i < 8; ++i)
+         sum += half * gl_w[i] * (accept_dy(mid - half*gl_x[i], length, width, separation, c, si, n) +
+                                  accept_dy(mid + half*gl_x[i], length, width, separation, c, si, n));
+      lo = hi;
+      w *= 2.0;
+   }
+
+   return sum;
+}
+
+double accept_tele_rate(int flux, double length, double width, double separation, double theta)
+{
+   double g;
+
+   switch(flux)
+   {
+   case 0: /* PDG */
+      g = accept_tele(length, width, separation, theta, 2);
+      return (g < 0.0) ? -1.0 : mu_pdg_i * g;
+
+   case 1: /* Isotropic */
+      g = accept_tele(length, width, separation, theta, 0);
+      return (g < 0.0) ? -1.0 : mu_iso_i * g;
+
+   default:
+      return -1.0;
+   }
+}
@@ -16,7 +16,7 @@
  */
 
 #include "geometry/geometry.h"
-#include "vector/vector.h"
+#include "vector/vector_inline.h"
 #include <math.h>
 #include <stdio.h>
 
@@ -65,23 +65,42 @@ void rotate_vec(vec3 v_out, const vec3 v_in,
    add_vec(v_out, v_ort_prime, v_par);
 }
 
-int intersect_plane(const g_line line,
-                    const g_plane plane,
-                    double *translation, vec3 cross)
+void prepare_plane(g_plane_prepared *prepared, const g_plane *plane)
+{
+   copy_vec(prepared->origin, plane->origin);
+   copy_vec(prepared->normal, plane->normal);
+   prepared->offset = dot_vec(plane->origin, plane->normal);
+}
+
+void prepare_rect(g_rect_prepared *prepared, const g_rectangle *rectangle)
+{
+   g_plane plane;
+
+   copy_vec(plane.origin, rectangle->origin);
+   copy_vec(plane.normal, rectangle->normal);
+   prepare_plane(&prepared->plane, &plane);
+
+   copy_vec(prepared->edge[0], rectangle->edge1);
+   copy_vec(prepared->edge[1], rectangle->edge2);
+   prepared->edge_offset[0] = dot_vec(rectangle->origin, rectangle->edge1);
+   prepared->edge_offset[1] = dot_vec(rectangle->origin, rectangle->edge2);
+   prepared->len[0] = rectangle->edge1_len;
+   prepared->len[1] = rectangle->edge2_len;
+}
+
+int intersect_plane_prepared(const g_ray *ray,
+                             const g_plane_prepared *plane,
+                             double *translation, vec3 cross)
 {
    double N_proj;
    double D_proj;
-   vec3   Delta;
-   vec3   Move;
-
-   /* Displacement between origins (from line to plane)*/
-   diff_vec(Delta, plane.origin, line.origin);
+   double path;
 
-   /* Project displacement onto normal of plane -> Separation of origin from plane */
-   D_proj = dot_vec(Delta, plane.normal);
+   /* Separation of the ray origin from the plane, along the normal of the plane */
+   D_proj = plane->offset - dot_vec(ray->origin, plane->normal);
 
    /* Project direction of line onto normal of plane */
-   N_proj = dot_vec(line.direction, plane.normal);
+   N_proj = dot_vec(ray->direction, plane->normal);
 
    if (fabs(N_proj) < 1.0E-10)
    {
@@ -101,72 +120,71 @@ int intersect_plane(const g_line line,
    /* Ratio of N_proj and D_proj is the length of particle direction vector that
       moves from the particles origin to the (infinite) surface of the plane
     */
-   scale_vec2(Move, line.direction, D_proj/N_proj);
-
-   /* Obtain the coordinates where the line intersects with the plane */
-   add_vec(Delta, line.origin, Move);
+   path = D_proj/N_proj;
 
    /* Store result */
-   *translation = D_proj/N_proj;
+   *translation = path;
+
+   cross[0] = ray->origin[0] + path * ray->direction[0];
+   cross[1] = ray->origin[1] + path * ray->direction[1];
+   cross[2] = ray->origin[2] + path * ray->direction[2];
 
-   cross[0] = Delta[0];
-   cross[1] = Delta[1];
-   cross[2] = Delta[2];
-   
    return 0;
 }
 
-int intersect_rect(const g_line line,
-                   const g_rectangle rectangle,
-                   double *translation, int *hit,
-                   double *local_1, double *local_2)
+int intersect_rect_prepared(const g_ray *ray,
+                            const g_rect_prepared *rectangle,
+                            double *translation, int *hit,
+                            double *local_1, double *local_2)
 {
    int    intersect;
-   int    hit_val;
    vec3   cross;
    double path;
-   vec3   O;
    double len1, len2;
 
    /* Find coordinate where particle crosses the plane that rectangle is part of */
-   g_plane plane;
-   copy_vec(plane.origin, rectangle.origin);
-   copy_vec(plane.normal, rectangle.normal);
-
-   intersect = intersect_plane(line, plane,
-                               &path, cross);
+   intersect = intersect_plane_prepared(ray, &rectangle->plane,
+                                        &path, cross);
    if (0 != intersect)
    {
       /* No single point found */
       return intersect;
    }
 
-   /* Find the offset from the origin of the rectangle (from origin to crossing) */
-   diff_vec(O, cross, rectangle.origin);
-
-   /* Decompose vector into local edge coordinates */
-   len1 = dot_vec(O, rectangle.edge1);
-   len2 = dot_vec(O, rectangle.edge2);
-
-   /* Limit hits to 'inside' coordinates: Length in either direction */
-   hit_val = 0;
-   if (fabs(len1) <= rectangle.edge1_len)
-   {
-      if (fabs(len2) <= rectangle.edge2_len)
-      {
-         hit_val = 1;
-      }
-   }
+   /* Decompose the offset from the origin of the rectangle into local edge coordinates */
+   len1 = dot_vec(cross, rectangle->edge[0]) - rectangle->edge_offset[0];
+   len2 = dot_vec(cross, rectangle->edge[1]) - rectangle->edge_offset[1];
 
-   /* Store the result */
+   /* Store the result. Hits are limited to 'inside' coordinates */
    *translation = path;
-   *hit = hit_val;
+   *hit = (fabs(len1) <= rectangle->len[0]) && (fabs(len2) <= rectangle->len[1]);
    *local_1 = len1;
    *local_2 = len2;
 
    return 0;
 }
 
+int intersect_plane(const g_line line,
+                    const g_plane plane,
+                    double *translation, vec3 cross)
+{
+   g_plane_prepared prepared;
+
+   prepare_plane(&prepared, &plane);
+   return intersect_plane_prepared(&line, &prepared, translation, cross);
+}
+
+int intersect_rect(const g_line line,
+                   const g_rectangle rectangle,
+                   double *translation, int *hit,
+                   double *local_1, double *local_2)
+{
+   g_rect_prepared prepared;
+
+   prepare_rect(&prepared, &rectangle);
+   return intersect_rect_prepared(&line, &prepared, translation, hit, local_1, local_2);
+}
+
 int intersect_box(const g_line line,
                   const g_box box,
                   double translation[2], int *hit,
@@ -219,7 +237,7 @@ int intersect_box(const g_line line,
    cur_rect.edge2_len = box.edge3_len;
    */
    result = intersect_rect(line, cur_rect,
-                           &trans_res, &l_hit, &l3, &l3);
+                           &trans_res, &l_hit, &l2, &l3);
    if (result == 0)
    {
       if (l_hit)
@@ -335,3 +353,649 @@ int intersect_box(const g_line line,
    *hit = h_count;
    return 0;
 }
+
+void prepare_box(g_box_prepared *prepared, const g_box *box)
+{
+   copy_vec(prepared->origin, box->origin);
+   copy_vec(prepared->axis[0], box->edge1);
+   copy_vec(prepared->axis[1], box->edge2);
+   copy_vec(prepared->axis[2], box->edge3);
+   prepared->len[0] = box->edge1_len;
+   prepared->len[1] = box->edge2_len;
+   prepared->len[2] = box->edge3_len;
+}
+
+int intersect_box_prepared(const g_ray *line,
+                           const g_box_prepared *box,
+                           double translation[2], int *hit,
+                           double local_1[2], double local_2[2], double local_3[2])
+{
+   double  o[3], d[3];
+   double  t_near = -HUGE_VAL;
+   double  t_far = HUGE_VAL;
+   int     f_near = -1;
+   int     f_far = -1;
+   int     a, n;
+   vec3    Delta;
+
+   /* Origin and direction of the line in the frame of the box */
+   diff_vec(Delta, line->origin, box->origin);
+   for (a = 0; a < 3; a++)
+   {
+      o[a] = dot_vec(Delta, box->axis[a]);
+      d[a] = dot_vec(line->direction, box->axis[a]);
+   }
+
+   /* Narrow the interval of the line inside all three slabs. Faces are numbered
+      in the order of 'intersect_box': +edge1, -edge1, +edge2, ... */
+   for (a = 0; a < 3; a++)
+   {
+      double t_lo, t_hi;
+      int    f_lo, f_hi;
+
+      if (fabs(d[a]) < 1.0E-10)
+      {
+         /* Parallel to the faces: Inside of the slab or no hit at all */
+         if (fabs(o[a]) > box->len[a])
+            break;
+         continue;
+      }
+
+      t_lo = (-box->len[a] - o[a]) / d[a];
+      t_hi = (box->len[a] - o[a]) / d[a];
+      f_lo = 2*a + 1;
+      f_hi = 2*a;
+      if (t_lo > t_hi)
+      {
+         double t = t_lo;
+         int    f = f_lo;
+
+         t_lo = t_hi;
+         t_hi = t;
+         f_lo = f_hi;
+         f_hi = f;
+      }
+
+      if (t_lo > t_near)
+      {
+         t_near = t_lo;
+         f_near = f_lo;
+      }
+      if (t_hi < t_far)
+      {
+         t_far = t_hi;
+         f_far = f_hi;
+      }
+   }
+
+   if ((a < 3) || (f_near < 0) || (f_far < 0) || (t_near > t_far))
+   {
+      *hit = 0;
+      return 0;
+   }
+
+   /* Both crossings in the order of the faces */
+   for (n = 0; n < 2; n++)
+   {
+      int    f = ((f_near < f_far) == (n == 0)) ? f_near : f_far;
+      double t = (f == f_near) ? t_near : t_far;
+      double l[3];
+
+      for (a = 0; a < 3; a++)
+         l[a] = o[a] + t * d[a];
+
+      /* On the face itself */
+      a = f / 2;
+      l[a] = (f & 1) ? -box->len[a] : box->len[a];
+
+      translation[n] = t;
+      local_1[n] = l[0];
+      local_2[n] = l[1];
+      local_3[n] = l[2];
+   }
+
+   *hit = 2;
+   return 0;
+}
+
+void prepare_disk(g_disk_prepared *prepared, const g_disk *disk)
+{
+   g_plane plane;
+
+   copy_vec(plane.origin, disk->origin);
+   copy_vec(plane.normal, disk->normal);
+   prepare_plane(&prepared->plane, &plane);
+
+   copy_vec(prepared->edge[0], disk->edge1);
+   copy_vec(prepared->edge[1], disk->edge2);
+   prepared->edge_offset[0] = dot_vec(disk->origin, disk->edge1);
+   prepared->edge_offset[1] = dot_vec(disk->origin, disk->edge2);
+   prepared->radius2 = disk->radius * disk->radius;
+}
+
+int intersect_disk_prepared(const g_ray *ray,
+                            const g_disk_prepared *disk,
+                            double *translation, int *hit,
+                            double *local_1, double *local_2)
+{
+   int    intersect;
+   vec3   cross;
+   double path;
+   double len1, len2;
+
+   /* Same as a rectangle, only the test of the local coordinates differs */
+   intersect = intersect_plane_prepared(ray, &disk->plane, &path, cross);
+   if (0 != intersect)
+      return intersect;
+
+   len1 = dot_vec(cross, disk->edge[0]) - disk->edge_offset[0];
+   len2 = dot_vec(cross, disk->edge[1]) - disk->edge_offset[1];
+
+   *translation = path;
+   *hit = ((len1*len1) + (len2*len2) <= disk->radius2);
+   *local_1 = len1;
+   *local_2 = len2;
+
+   return 0;
+}
+
+int intersect_disk(const g_line line,
+                   const g_disk disk,
+                   double *translation, int *hit,
+                   double *local_1, double *local_2)
+{
+   g_disk_prepared prepared;
+
+   prepare_disk(&prepared, &disk);
+   return intersect_disk_prepared(&line, &prepared, translation, hit, local_1, local_2);
+}
+
+void prepare_cylinder(g_cylinder_prepared *prepared, const g_cylinder *cylinder)
+{
+   copy_vec(prepared->origin, cylinder->origin);
+   copy_vec(prepared->axis[0], cylinder->edge1);
+   copy_vec(prepared->axis[1], cylinder->edge2);
+   copy_vec(prepared->axis[2], cylinder->axis);
+   prepared->radius2 = cylinder->radius * cylinder->radius;
+   prepared->len = cylinder->axis_len;
+}
+
+int intersect_cylinder_prepared(const g_ray *ray,
+                                const g_cylinder_prepared *cylinder,
+                                double translation[2], int *hit,
+                                double local_1[2], double local_2[2], double local_3[2])
+{
+   double  o[3], d[3];
+   double  a, b, c, disc;
+   double  t_near, t_far;
+   double  cap_near = 0.0;
+   double  cap_far = 0.0;
+   int     n;
+   vec3    Delta;
+
+   *hit = 0;
+
+   /* Origin and direction of the line in the frame of the cylinder */
+   diff_vec(Delta, ray->origin, cylinder->origin);
+   for (n = 0; n < 3; n++)
+   {
+      o[n] = dot_vec(Delta, cylinder->axis[n]);
+      d[n] = dot_vec(ray->direction, cylinder->axis[n]);
+   }
+
+   /* Wall: Solutions of a t^2 + 2 b t + c = 0 for the distance to the axis */
+   a = (d[0]*d[0]) + (d[1]*d[1]);
+   b = (o[0]*d[0]) + (o[1]*d[1]);
+   c = ((o[0]*o[0]) + (o[1]*o[1])) - cylinder->radius2;
+   if (a < 1.0E-20)
+   {
+      /* Parallel to the axis: Inside of the wall or no hit at all */
+      if (c > 0.0)
+         return 0;
+      t_near = -HUGE_VAL;
+      t_far = HUGE_VAL;
+   }
+   else
+   {
+      disc = (b*b) - (a*c);
+      if (disc < 0.0)
+         return 0;
+      disc = sqrt(disc);
+      t_near = (-b - disc) / a;
+      t_far = (-b + disc) / a;
+   }
+
+   /* Caps: Slab along the axis, as for 'intersect_box_prepared' */
+   if (fabs(d[2]) < 1.0E-10)
+   {
+      if (fabs(o[2]) > cylinder->len)
+         return 0;
+   }
+   else
+   {
+      double t_lo = (-cylinder->len - o[2]) / d[2];
+      double t_hi = (cylinder->len - o[2]) / d[2];
+      double c_lo = -cylinder->len;
+      double c_hi = cylinder->len;
+
+      if (t_lo > t_hi)
+      {
+         double t = t_lo;
+
+         t_lo = t_hi;
+         t_hi = t;
+         c_lo = cylinder->len;
+         c_hi = -cylinder->len;
+      }
+      if (t_lo > t_near)
+      {
+         t_near = t_lo;
+         cap_near = c_lo;
+      }
+      if (t_hi < t_far)
+      {
+         t_far = t_hi;
+         cap_far = c_hi;
+      }
+   }
+
+   if (t_near > t_far)
+      return 0;
+
+   translation[0] = t_near;
+   translation[1] = t_far;
+   for (n = 0; n < 2; n++)
+   {
+      double t = translation[n];
+      double cap = (n == 0) ? cap_near : cap_far;
+
+      local_1[n] = o[0] + t * d[0];
+      local_2[n] = o[1] + t * d[1];
+      local_3[n] = (cap != 0.0) ? cap : o[2] + t * d[2];
+   }
+
+   *hit = 2;
+   return 0;
+}
+
+int intersect_cylinder(const g_line line,
+                       const g_cylinder cylinder,
+                       double translation[2], int *hit,
+                       double local_1[2], double local_2[2], double local_3[2])
+{
+   g_cylinder_prepared prepared;
+
+   prepare_cylinder(&prepared, &cylinder);
+   return intersect_cylinder_prepared(&line, &prepared, translation, hit, local_1, local_2, local_3);
+}
+
+int prepare_poly(g_poly_prepared *prepared, const g_polyhedron *poly)
+{
+   int k;
+
+   if ((poly->faces < 1) || (poly->faces > G_POLY_MAX))
+      return -1;
+
+   prepared->faces = poly->faces;
+   for (k = 0; k < poly->faces; k++)
+      prepare_plane(&prepared->face[k], &poly->face[k]);
+   return 0;
+}
+
+int intersect_poly_prepared(const g_ray *ray,
+                            const g_poly_prepared *poly,
+                            double translation[2], int *hit, int face[2])
+{
+   double t_near = -HUGE_VAL;
+   double t_far = HUGE_VAL;
+   int    f_near = -1;
+   int    f_far = -1;
+   int    k;
+
+   *hit = 0;
+   if ((poly->faces < 1) || (poly->faces > G_POLY_MAX))
+      return -1;
+
+   /* Clip the line with the inner side of every face */
+   for (k = 0; k < poly->faces; k++)
+   {
+      const g_plane_prepared *p = &poly->face[k];
+      double D_proj = p->offset - dot_vec(ray->origin, p->normal);
+      double N_proj = dot_vec(ray->direction, p->normal);
+      double t;
+
+      if (fabs(N_proj) < 1.0E-10)
+      {
+         /* Parallel to the face: Inside of its plane or no hit at all */
+         if (D_proj < 0.0)
+            return 0;
+         continue;
+      }
+
+      t = D_proj / N_proj;
+      if (N_proj < 0.0)
+      {
+         /* Entering through this face */
+         if (t > t_near)
+         {
+            t_near = t;
+            f_near = k;
+         }
+      }
+      else if (t < t_far)
+      {
+         t_far = t;
+         f_far = k;
+      }
+   }
+
+   if (t_near > t_far)
+      return 0;
+
+   *hit = 2;
+   translation[0] = t_near;
+   translation[1] = t_far;
+   if (NULL != face)
+   {
+      face[0] = f_near;
+      face[1] = f_far;
+   }
+   return 0;
+}
+
+int intersect_poly(const g_line line,
+                   const g_polyhedron poly,
+                   double translation[2], int *hit, int face[2])
+{
+   g_poly_prepared prepared;
+
+   *hit = 0;
+   if (0 != prepare_poly(&prepared, &poly))
+      return -1;
+   return intersect_poly_prepared(&line, &prepared, translation, hit, face);
+}
+
+/* Same vector within the tolerance of 'prepare_stack' */
+static int stack_same(const vec3 v1, const vec3 v2)
+{
+   return (fabs(v1[0] - v2[0]) <= 1.0E-12) && (fabs(v1[1] - v2[1]) <= 1.0E-12)
+      && (fabs(v1[2] - v2[2]) <= 1.0E-12);
+}
+
+int prepare_stack(g_stack_prepared *prepared, const g_rectangle *layers, int num)
+{
+   int k;
+
+   if ((num < 1) || (num > G_STACK_MAX))
+      return -1;
+
+   for (k = 1; k < num; k++)
+      if (!stack_same(layers[k].normal, layers[0].normal)
+          || !stack_same(layers[k].edge1, layers[0].edge1)
+          || !stack_same(layers[k].edge2, layers[0].edge2))
+         return -1;
+
+   copy_vec(prepared->normal, layers[0].normal);
+   copy_vec(prepared->edge[0], layers[0].edge1);
+   copy_vec(prepared->edge[1], layers[0].edge2);
+   prepared->layers = num;
+
+   for (k = 0; k < num; k++)
+   {
+      prepared->offset[k] = dot_vec(layers[k].origin, prepared->normal);
+      prepared->edge_offset[0][k] = dot_vec(layers[k].origin, prepared->edge[0]);
+      prepared->edge_offset[1][k] = dot_vec(layers[k].origin, prepared->edge[1]);
+      prepared->len[0][k] = layers[k].edge1_len;
+      prepared->len[1][k] = layers[k].edge2_len;
+   }
+   return 0;
+}
+
+int intersect_stack_prepared(const g_ray *ray,
+                             const g_stack_prepared *stack,
+                             double *translation, int *hit,
+                             double *local_1, double *local_2)
+{
+   double N_proj, inv, o_proj;
+   double o_e1, o_e2, d_e1, d_e2;
+   int    count = 0;
+   int    k;
+
+   /* Projection of the direction onto the normal, shared by all layers */
+   N_proj = dot_vec(ray->direction, stack->normal);
+   if (fabs(N_proj) < 1.0E-10)
+   {
+      for (k = 0; k < stack->layers; k++)
+         hit[k] = 0;
+      return -1;
+   }
+
+   inv = 1.0 / N_proj;
+   o_proj = dot_vec(ray->origin, stack->normal) * inv;
+   o_e1 = dot_vec(ray->origin, stack->edge[0]);
+   o_e2 = dot_vec(ray->origin, stack->edge[1]);
+   d_e1 = dot_vec(ray->direction, stack->edge[0]);
+   d_e2 = dot_vec(ray->direction, stack->edge[1]);
+
+   for (k = 0; k < stack->layers; k++)
+   {
+      double path = stack->offset[k] * inv - o_proj;
+      double len1 = (o_e1 + path * d_e1) - stack->edge_offset[0][k];
+      double len2 = (o_e2 + path * d_e2) - stack->edge_offset[1][k];
+
+      hit[k] = (fabs(len1) <= stack->len[0][k]) && (fabs(len2) <= stack->len[1][k]);
+      count += hit[k];
+      if (NULL != translation)
+         translation[k] = path;
+      if (NULL != local_1)
+         local_1[k] = len1;
+      if (NULL != local_2)
+         local_2[k] = len2;
+   }
+
+   return count;
+}
+
+void pose_identity(g_pose *pose)
+{
+   int i, j;
+
+   for (i = 0; i < 3; i++)
+   {
+      for (j = 0; j < 3; j++)
+         pose->rot[i][j] = (i == j) ? 1.0 : 0.0;
+      pose->trans[i] = 0.0;
+   }
+}
+
+void pose_rotation(g_pose *pose, const vec3 rot_axis, double phi)
+{
+   int i, j;
+
+   /* The columns are the rotated unit vectors */
+   for (j = 0; j < 3; j++)
+   {
+      vec3 e = { 0.0, 0.0, 0.0 };
+      vec3 col;
+
+      e[j] = 1.0;
+      rotate_vec(col, e, rot_axis, phi);
+      for (i = 0; i < 3; i++)
+         pose->rot[i][j] = col[i];
+      pose->trans[j] = 0.0;
+   }
+}
+
+void pose_compose(g_pose *out, const g_pose *outer, const g_pose *inner)
+{
+   g_pose res;
+   int    i, j;
+
+   /* outer(inner(p)) = R_o * R_i * p + R_o * t_i + t_o */
+   for (i = 0; i < 3; i++)
+      for (j = 0; j < 3; j++)
+         res.rot[i][j] = outer->rot[i][0]*inner->rot[0][j] + outer->rot[i][1]*inner->rot[1][j]
+                       + outer->rot[i][2]*inner->rot[2][j];
+   pose_apply(res.trans, outer, inner->trans);
+
+   *out = res;
+}
+
+void pose_apply(vec3 out, const g_pose *pose, const vec3 in)
+{
+   vec3 r;
+
+   mul_matrix(r, pose->rot, in);
+   add_vec(out, r, pose->trans);
+}
+
+void pose_apply_dir(vec3 out, const g_pose *pose, const vec3 in)
+{
+   vec3 r;
+
+   mul_matrix(r, pose->rot, in);
+   copy_vec(out, r);
+}
+
+void pose_apply_n(const g_pose *pose, int n,
+                  const double *const in[3], double *const out[3])
+{
+   const double (*R)[3] = pose->rot;
+   const double *t = pose->trans;
+   int           i;
+
+   /* Points on the local xy-plane: Two terms less */
+   if (NULL == in[2])
+   {
+      for (i = 0; i < n; i++)
+      {
+         double x = in[0][i];
+         double y = in[1][i];
+
+         out[0][i] = R[0][0]*x + R[0][1]*y + t[0];
+         out[1][i] = R[1][0]*x + R[1][1]*y + t[1];
+         out[2][i] = R[2][0]*x + R[2][1]*y + t[2];
+      }
+      return;
+   }
+
+   for (i = 0; i < n; i++)
+   {
+      double x = in[0][i];
+      double y = in[1][i];
+      double z = in[2][i];
+
+      out[0][i] = R[0][0]*x + R[0][1]*y + R[0][2]*z + t[0];
+      out[1][i] = R[1][0]*x + R[1][1]*y + R[1][2]*z + t[1];
+      out[2][i] = R[2][0]*x + R[2][1]*y + R[2][2]*z + t[2];
+   }
+}
+
+void pose_rect(g_rectangle *out, const g_pose *pose, const g_rectangle *in)
+{
+   g_rectangle res = *in;
+
+   pose_apply(res.origin, pose, in->origin);
+   pose_apply_dir(res.normal, pose, in->normal);
+   pose_apply_dir(res.edge1, pose, in->edge1);
+   pose_apply_dir(res.edge2, pose, in->edge2);
+
+   *out = res;
+}
+
+void pose_box(g_box *out, const g_pose *pose, const g_box *in)
+{
+   g_box res = *in;
+
+   pose_apply(res.origin, pose, in->origin);
+   pose_apply_dir(res.edge1, pose, in->edge1);
+   pose_apply_dir(res.edge2, pose, in->edge2);
+   pose_apply_dir(res.edge3, pose, in->edge3);
+
+   *out = res;
+}
+
+void pose_disk(g_disk *out, const g_pose *pose, const g_disk *in)
+{
+   g_disk res = *in;
+
+   pose_apply(res.origin, pose, in->origin);
+   pose_apply_dir(res.normal, pose, in->normal);
+   pose_apply_dir(res.edge1, pose, in->edge1);
+   pose_apply_dir(res.edge2, pose, in->edge2);
+
+   *out = res;
+}
+
+void pose_cylinder(g_cylinder *out, const g_pose *pose, const g_cylinder *in)
+{
+   g_cylinder res = *in;
+
+   pose_apply(res.origin, pose, in->origin);
+   pose_apply_dir(res.axis, pose, in->axis);
+   pose_apply_dir(res.edge1, pose, in->edge1);
+   pose_apply_dir(res.edge2, pose, in->edge2);
+
+   *out = res;
+}
+
+void pose_poly(g_polyhedron *out, const g_pose *pose, const g_polyhedron *in)
+{
+   int k;
+
+   out->faces = in->faces;
+   for (k = 0; k < in->faces && k < G_POLY_MAX; k++)
+   {
+      g_plane res;
+
+      pose_apply(res.origin, pose, in->face[k].origin);
+      pose_apply_dir(res.normal, pose, in->face[k].normal);
+      out->face[k] = res;
+   }
+}
+
+/* One corner of a rectangle: origin +- edge1*len1 +- edge2*len2 */
+static void rect_corner(vec3 out, const g_rectangle *rect, int corner)
+{
+   double s1 = (corner & 1) ? rect->edge1_len : -rect->edge1_len;
+   double s2 = (corner & 2) ? rect->edge2_len : -rect->edge2_len;
+   int    c;
+
+   for (c = 0; c < 3; ++c)
+      out[c] = rect->origin[c] + s1*rect->edge1[c] + s2*rect->edge2[c];
+}
+
+double accept_cos_rect(const g_rectangle *first, const g_rectangle *second)
+{
+   double cos_min = 1.0;
+   int    i, j;
+
+   /* The bound by the corners only holds for parallel rectangles */
+   if (fabs(dot_vec(first->normal, second->normal)) < 1.0 - 1e-10)
+      return 0.0;
+
+   /* Lines through both rectangles are inside of the convex hull of the lines between
+      their corners, and |cos| to the normal is smallest at one of these corners */
+   for (i = 0; i < 4; ++i)
+   {
+      vec3 c1;
+
+      rect_corner(c1, first, i);
+      for (j = 0; j < 4; ++j)
+      {
+         vec3   c2, v;
+         double len, cos_v;
+
+         rect_corner(c2, second, j);
+         diff_vec(v, c2, c1);
+         len = sqrt(dot_vec(v, v));
+         if (len < 1e-10)
+            return 0.0;
+         cos_v = fabs(dot_vec(v, first->normal))/len;
+         if (cos_v < cos_min)
+            cos_min = cos_v;
+      }
+   }
+
+   return cos_min;
+}
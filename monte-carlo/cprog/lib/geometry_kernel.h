@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/**********************************************************/
+/* Kernels of 'geometry_n.c' for one vector width.        */
+/* Included once per instruction set, with these macros   */
+/* defined:                                               */
+/*   GK_W         : Number of lanes                       */
+/*   GK_NAME(f)   : Name of function 'f' for this width   */
+/*   GK_ATTR      : Function attributes (target ISA)      */
+/*   GK_SQRT(v)   : Square root of the lanes of a 'vd'    */
+/* The operations are those of the scalar functions in    */
+/* 'geometry.c', in the same order, so all widths give    */
+/* the same results.                                      */
+/**********************************************************/
+
+typedef double  GK_NAME(vd) __attribute__((vector_size(8*GK_W)));
+typedef int64_t GK_NAME(vi) __attribute__((vector_size(8*GK_W)));
+
+/* Single precision: Twice the lanes in the same vector size */
+typedef float   GK_NAME(vf) __attribute__((vector_size(8*GK_W)));
+typedef int32_t GK_NAME(vfi) __attribute__((vector_size(8*GK_W)));
+
+/* Hit flags: One int per lane of 'vd' */
+typedef int32_t GK_NAME(vh) __attribute__((vector_size(4*GK_W)));
+
+#define vd GK_NAME(vd)
+#define vi GK_NAME(vi)
+#define vf GK_NAME(vf)
+#define vfi GK_NAME(vfi)
+#define GK_FW (2*GK_W)
+
+/* Load 'n' <= GK_W values, the missing lanes are set to zero */
+static inline GK_ATTR vd GK_NAME(load)(const double *x, int n)
+{
+   vd  v = (vd){ 0 };
+   int l;
+
+   if (n == GK_W)
+   {
+      memcpy(&v, x, sizeof(vd));
+      return v;
+   }
+
+   for (l = 0; l < n; l++)
+      v[l] = x[l];
+   return v;
+}
+
+static inline GK_ATTR void GK_NAME(store)(double *y, vd v, int n)
+{
+   int l;
+
+   if (NULL == y)
+      return;
+
+   if (n == GK_W)
+   {
+      memcpy(y, &v, sizeof(vd));
+      return;
+   }
+
+   for (l = 0; l < n; l++)
+      y[l] = v[l];
+}
+
+static inline GK_ATTR vd GK_NAME(fabs)(vd x)
+{
+   return (vd)((vi)x & ~gk_sign_bit);
+}
+
+/* Lanes of 'a' where 'm' is set, else lanes of 'b' */
+static inline GK_ATTR vd GK_NAME(blend)(vi m, vd a, vd b)
+{
+   return (vd)(((vi)a & m) | ((vi)b & ~m));
+}
+
+/* Hit flags (0 or 1) of the 'n' <= GK_W lanes of the mask 'm' */
+static inline GK_ATTR void GK_NAME(store_hit)(int *hit, vi m, int n)
+{
+   GK_NAME(vh) h = __builtin_convertvector(-m, GK_NAME(vh));
+   int         l;
+
+   if (n == GK_W)
+   {
+      memcpy(hit, &h, sizeof(h));
+      return;
+   }
+
+   for (l = 0; l < n; l++)
+      hit[l] = h[l];
+}
+
+static inline GK_ATTR vf GK_NAME(loadf)(const float *x, int n)
+{
+   vf  v = (vf){ 0 };
+   int l;
+
+   if (n == GK_FW)
+   {
+      memcpy(&v, x, sizeof(vf));
+      return v;
+   }
+
+   for (l = 0; l < n; l++)
+      v[l] = x[l];
+   return v;
+}
+
+static inline GK_ATTR vf GK_NAME(fabsf)(vf x)
+{
+   return (vf)((vfi)x & ~gk_sign_bit_f);
+}
+
+/* Lanes of 'a' where 'm' is set, else lanes of 'b' */
+static inline GK_ATTR vf GK_NAME(blendf)(vfi m, vf a, vf b)
+{
+   return (vf)(((vfi)a & m) | ((vfi)b & ~m));
+}
+
+static GK_ATTR int GK_NAME(rect_n)(const g_rect_prepared *rectangle, int n,
+                                   const double *const origin[3],
+                                   const double *const direction[3],
+                                   int *hit, double *translation,
+                                   double *local_1, double *local_2)
+{
+   const double *nv = rectangle->plane.normal;
+   const double *e1 = rectangle->edge[0];
+   const double *e2 = rectangle->edge[1];
+   int           i, l, m;
+   int           count = 0;
+
+   for (i = 0; i < n; i += GK_W)
+   {
+      vd ox, oy, oz, dx, dy, dz;
+      vd N_proj, D_proj, path, cx, cy, cz, len1, len2;
+      vi in;
+
+      m = (n - i < GK_W) ? n - i : GK_W;
+      ox = GK_NAME(load)(origin[0] + i, m);
+      oy = GK_NAME(load)(origin[1] + i, m);
+      oz = GK_NAME(load)(origin[2] + i, m);
+      dx = GK_NAME(load)(direction[0] + i, m);
+      dy = GK_NAME(load)(direction[1] + i, m);
+      dz = GK_NAME(load)(direction[2] + i, m);
+
+      /* Separation from the plane and projection of the direction onto its normal */
+      D_proj = rectangle->plane.offset - ((ox*nv[0]) + (oy*nv[1]) + (oz*nv[2]));
+      N_proj = (dx*nv[0]) + (dy*nv[1]) + (dz*nv[2]);
+      path = D_proj / N_proj;
+
+      /* Crossing point and its local edge coordinates */
+      cx = ox + path * dx;
+      cy = oy + path * dy;
+      cz = oz + path * dz;
+      len1 = ((cx*e1[0]) + (cy*e1[1]) + (cz*e1[2])) - rectangle->edge_offset[0];
+      len2 = ((cx*e2[0]) + (cy*e2[1]) + (cz*e2[2])) - rectangle->edge_offset[1];
+
+      /* Rays parallel to the plane never hit */
+      in = (GK_NAME(fabs)(N_proj) >= 1.0E-10)
+         & (GK_NAME(fabs)(len1) <= rectangle->len[0])
+         & (GK_NAME(fabs)(len2) <= rectangle->len[1]);
+
+      for (l = 0; l < m; l++)
+      {
+         hit[i + l] = (0 != in[l]);
+         count += hit[i + l];
+      }
+      GK_NAME(store)(translation ? translation + i : NULL, path, m);
+      GK_NAME(store)(local_1 ? local_1 + i : NULL, len1, m);
+      GK_NAME(store)(local_2 ? local_2 + i : NULL, len2, m);
+   }
+
+   return count;
+}
+
+static GK_ATTR int GK_NAME(poly_n)(const g_poly_prepared *poly, int n,
+                                   const double *const origin[3],
+                                   const double *const direction[3],
+                                   int *hit, double *translation_1, double *translation_2)
+{
+   int i, k, l, m;
+   int count = 0;
+
+   for (i = 0; i < n; i += GK_W)
+   {
+      vd ox, oy, oz, dx, dy, dz;
+      vd t_near = (vd){ 0 } - HUGE_VAL;
+      vd t_far = (vd){ 0 } + HUGE_VAL;
+      vi miss = (vi){ 0 };
+
+      m = (n - i < GK_W) ? n - i : GK_W;
+      ox = GK_NAME(load)(origin[0] + i, m);
+      oy = GK_NAME(load)(origin[1] + i, m);
+      oz = GK_NAME(load)(origin[2] + i, m);
+      dx = GK_NAME(load)(direction[0] + i, m);
+      dy = GK_NAME(load)(direction[1] + i, m);
+      dz = GK_NAME(load)(direction[2] + i, m);
+
+      /* Same clip as 'intersect_poly_prepared', all faces in turn */
+      for (k = 0; k < poly->faces; k++)
+      {
+         const double *nv = poly->face[k].normal;
+         vd D_proj = poly->face[k].offset - ((ox*nv[0]) + (oy*nv[1]) + (oz*nv[2]));
+         vd N_proj = (dx*nv[0]) + (dy*nv[1]) + (dz*nv[2]);
+         vd t = D_proj / N_proj;
+         vi par = (GK_NAME(fabs)(N_proj) < 1.0E-10);
+
+         /* Parallel to the face: Inside of its plane or no hit at all */
+         miss |= par & (D_proj < 0.0);
+
+         t_near = GK_NAME(blend)(~par & (N_proj < 0.0) & (t > t_near), t, t_near);
+         t_far = GK_NAME(blend)(~par & (N_proj > 0.0) & (t < t_far), t, t_far);
+      }
+      miss |= (t_near > t_far);
+
+      for (l = 0; l < m; l++)
+      {
+         hit[i + l] = (0 == miss[l]);
+         count += hit[i + l];
+      }
+      GK_NAME(store)(translation_1 ? translation_1 + i : NULL, t_near, m);
+      GK_NAME(store)(translation_2 ? translation_2 + i : NULL, t_far, m);
+   }
+
+   return count;
+}
+
+static GK_ATTR int GK_NAME(stack_n)(const g_stack_prepared *stack, int n,
+                                    const double *const origin[3],
+                                    const double *const direction[3],
+                                    int *hit, double *translation,
+                                    double *local_1, double *local_2)
+{
+   const double *nv = stack->normal;
+   const double *e1 = stack->edge[0];
+   const double *e2 = stack->edge[1];
+   int           i, k, l, m;
+   int           count = 0;
+
+   for (i = 0; i < n; i += GK_W)
+   {
+      vd ox, oy, oz, dx, dy, dz;
+      vd N_proj, inv, o_proj, o_e1, o_e2, d_e1, d_e2;
+      vi cross, all;
+
+      m = (n - i < GK_W) ? n - i : GK_W;
+      ox = GK_NAME(load)(origin[0] + i, m);
+      oy = GK_NAME(load)(origin[1] + i, m);
+      oz = GK_NAME(load)(origin[2] + i, m);
+      dx = GK_NAME(load)(direction[0] + i, m);
+      dy = GK_NAME(load)(direction[1] + i, m);
+      dz = GK_NAME(load)(direction[2] + i, m);
+
+      /* Projections shared by all layers */
+      N_proj = (dx*nv[0]) + (dy*nv[1]) + (dz*nv[2]);
+      inv = 1.0 / N_proj;
+      o_proj = ((ox*nv[0]) + (oy*nv[1]) + (oz*nv[2])) * inv;
+      o_e1 = (ox*e1[0]) + (oy*e1[1]) + (oz*e1[2]);
+      o_e2 = (ox*e2[0]) + (oy*e2[1]) + (oz*e2[2]);
+      d_e1 = (dx*e1[0]) + (dy*e1[1]) + (dz*e1[2]);
+      d_e2 = (dx*e2[0]) + (dy*e2[1]) + (dz*e2[2]);
+
+      /* Rays parallel to the layers never hit */
+      cross = (GK_NAME(fabs)(N_proj) >= 1.0E-10);
+      all = cross;
+
+      for (k = 0; k < stack->layers; k++)
+      {
+         vd path = stack->offset[k] * inv - o_proj;
+         vd len1 = (o_e1 + path * d_e1) - stack->edge_offset[0][k];
+         vd len2 = (o_e2 + path * d_e2) - stack->edge_offset[1][k];
+         vi in = cross & (GK_NAME(fabs)(len1) <= stack->len[0][k])
+            & (GK_NAME(fabs)(len2) <= stack->len[1][k]);
+
+         GK_NAME(store_hit)(hit + k*n + i, in, m);
+         all &= in;
+         GK_NAME(store)(translation ? translation + k*n + i : NULL, path, m);
+         GK_NAME(store)(local_1 ? local_1 + k*n + i : NULL, len1, m);
+         GK_NAME(store)(local_2 ? local_2 + k*n + i : NULL, len2, m);
+      }
+
+      for (l = 0; l < m; l++)
+         count += (0 != all[l]);
+   }
+
+   return count;
+}
+
+static GK_ATTR int GK_NAME(disk_n)(const g_disk_prepared *disk, int n,
+                                   const double *const origin[3],
+                                   const double *const direction[3],
+                                   int *hit, double *translation,
+                                   double *local_1, double *local_2)
+{
+   const double *nv = disk->plane.normal;
+   const double *e1 = disk->edge[0];
+   const double *e2 = disk->edge[1];
+   int           i, l, m;
+   int           count = 0;
+
+   for (i = 0; i < n; i += GK_W)
+   {
+      vd ox, oy, oz, dx, dy, dz;
+      vd N_proj, D_proj, path, cx, cy, cz, len1, len2;
+      vi in;
+
+      m = (n - i < GK_W) ? n - i : GK_W;
+      ox = GK_NAME(load)(origin[0] + i, m);
+      oy = GK_NAME(load)(origin[1] + i, m);
+      oz = GK_NAME(load)(origin[2] + i, m);
+      dx = GK_NAME(load)(direction[0] + i, m);
+      dy = GK_NAME(load)(direction[1] + i, m);
+      dz = GK_NAME(load)(direction[2] + i, m);
+
+      /* Same as 'rect_n' up to the test of the local coordinates */
+      D_proj = disk->plane.offset - ((ox*nv[0]) + (oy*nv[1]) + (oz*nv[2]));
+      N_proj = (dx*nv[0]) + (dy*nv[1]) + (dz*nv[2]);
+      path = D_proj / N_proj;
+
+      cx = ox + path * dx;
+      cy = oy + path * dy;
+      cz = oz + path * dz;
+      len1 = ((cx*e1[0]) + (cy*e1[1]) + (cz*e1[2])) - disk->edge_offset[0];
+      len2 = ((cx*e2[0]) + (cy*e2[1]) + (cz*e2[2])) - disk->edge_offset[1];
+
+      in = (GK_NAME(fabs)(N_proj) >= 1.0E-10)
+         & ((len1*len1) + (len2*len2) <= disk->radius2);
+
+      for (l = 0; l < m; l++)
+      {
+         hit[i + l] = (0 != in[l]);
+         count += hit[i + l];
+      }
+      GK_NAME(store)(translation ? translation + i : NULL, path, m);
+      GK_NAME(store)(local_1 ? local_1 + i : NULL, len1, m);
+      GK_NAME(store)(local_2 ? local_2 + i : NULL, len2, m);
+   }
+
+   return count;
+}
+
+static GK_ATTR int GK_NAME(cyl_n)(const g_cylinder_prepared *cylinder, int n,
+                                  const double *const origin[3],
+                                  const double *const direction[3],
+                                  int *hit, double *translation_1, double *translation_2)
+{
+   int i, a, l, m;
+   int count = 0;
+
+   for (i = 0; i < n; i += GK_W)
+   {
+      vd ox, oy, oz, dx, dy, dz;
+      vd o[3], d[3];
+      vd qa, qb, qc, disc, t_near, t_far, t_lo, t_hi, t;
+      vi par, miss;
+
+      m = (n - i < GK_W) ? n - i : GK_W;
+      ox = GK_NAME(load)(origin[0] + i, m) - cylinder->origin[0];
+      oy = GK_NAME(load)(origin[1] + i, m) - cylinder->origin[1];
+      oz = GK_NAME(load)(origin[2] + i, m) - cylinder->origin[2];
+      dx = GK_NAME(load)(direction[0] + i, m);
+      dy = GK_NAME(load)(direction[1] + i, m);
+      dz = GK_NAME(load)(direction[2] + i, m);
+
+      /* Frame of the cylinder, then the steps of 'intersect_cylinder_prepared' */
+      for (a = 0; a < 3; a++)
+      {
+         const double *ax = cylinder->axis[a];
+
+         o[a] = (ox*ax[0]) + (oy*ax[1]) + (oz*ax[2]);
+         d[a] = (dx*ax[0]) + (dy*ax[1]) + (dz*ax[2]);
+      }
+
+      /* Wall, or the inside of it when parallel to the axis */
+      qa = (d[0]*d[0]) + (d[1]*d[1]);
+      qb = (o[0]*d[0]) + (o[1]*d[1]);
+      qc = ((o[0]*o[0]) + (o[1]*o[1])) - cylinder->radius2;
+      par = (qa < 1.0E-20);
+      disc = (qb*qb) - (qa*qc);
+      miss = (par & (qc > 0.0)) | (~par & (disc < 0.0));
+      disc = GK_NAME(blend)(disc < 0.0, (vd){ 0 }, disc);
+      disc = GK_SQRT(disc);
+      t_near = GK_NAME(blend)(par, (vd){ 0 } - HUGE_VAL, (-qb - disc) / qa);
+      t_far = GK_NAME(blend)(par, (vd){ 0 } + HUGE_VAL, (-qb + disc) / qa);
+
+      /* Caps */
+      par = (GK_NAME(fabs)(d[2]) < 1.0E-10);
+      miss |= par & (GK_NAME(fabs)(o[2]) > cylinder->len);
+      t_lo = (-cylinder->len - o[2]) / d[2];
+      t_hi = (cylinder->len - o[2]) / d[2];
+      t = GK_NAME(blend)(t_lo > t_hi, t_hi, t_lo);
+      t_hi = GK_NAME(blend)(t_lo > t_hi, t_lo, t_hi);
+      t_lo = t;
+      t_near = GK_NAME(blend)(~par & (t_lo > t_near), t_lo, t_near);
+      t_far = GK_NAME(blend)(~par & (t_hi < t_far), t_hi, t_far);
+      miss |= (t_near > t_far);
+
+      for (l = 0; l < m; l++)
+      {
+         hit[i + l] = (0 == miss[l]);
+         count += hit[i + l];
+      }
+      GK_NAME(store)(translation_1 ? translation_1 + i : NULL, t_near, m);
+      GK_NAME(store)(translation_2 ? translation_2 + i : NULL, t_far, m);
+   }
+
+   return count;
+}
+
+static GK_ATTR int GK_NAME(rect_nf)(const g_rect_prepared_f *rectangle, int n,
+                                    const float *const origin[3],
+                                    const float *const direction[3],
+                                    int *hit)
+{
+   const float *nv = rectangle->normal;
+   const float *e1 = rectangle->edge[0];
+   const float *e2 = rectangle->edge[1];
+   int          i, l, m;
+   int          count = 0;
+
+   for (i = 0; i < n; i += GK_FW)
+   {
+      vf  ox, oy, oz, dx, dy, dz;
+      vf  N_proj, D_proj, path, cx, cy, cz, len1, len2;
+      vfi in;
+
+      m = (n - i < GK_FW) ? n - i : GK_FW;
+      ox = GK_NAME(loadf)(origin[0] + i, m);
+      oy = GK_NAME(loadf)(origin[1] + i, m);
+      oz = GK_NAME(loadf)(origin[2] + i, m);
+      dx = GK_NAME(loadf)(direction[0] + i, m);
+      dy = GK_NAME(loadf)(direction[1] + i, m);
+      dz = GK_NAME(loadf)(direction[2] + i, m);
+
+      D_proj = rectangle->offset - ((ox*nv[0]) + (oy*nv[1]) + (oz*nv[2]));
+      N_proj = (dx*nv[0]) + (dy*nv[1]) + (dz*nv[2]);
+      path = D_proj / N_proj;
+
+      cx = ox + path * dx;
+      cy = oy + path * dy;
+      cz = oz + path * dz;
+      len1 = ((cx*e1[0]) + (cy*e1[1]) + (cz*e1[2])) - rectangle->edge_offset[0];
+      len2 = ((cx*e2[0]) + (cy*e2[1]) + (cz*e2[2])) - rectangle->edge_offset[1];
+
+      in = (GK_NAME(fabsf)(N_proj) >= 1.0E-10f)
+         & (GK_NAME(fabsf)(len1) <= rectangle->len[0])
+         & (GK_NAME(fabsf)(len2) <= rectangle->len[1]);
+
+      for (l = 0; l < m; l++)
+      {
+         hit[i + l] = (0 != in[l]);
+         count += hit[i + l];
+      }
+   }
+
+   return count;
+}
+
+static GK_ATTR int GK_NAME(box_nf)(const g_box_prepared_f *box, int n,
+                                   const float *const origin[3],
+                                   const float *const direction[3],
+                                   int *hit, float *length)
+{
+   int i, a, l, m;
+   int count = 0;
+
+   for (i = 0; i < n; i += GK_FW)
+   {
+      vf  ox, oy, oz, dx, dy, dz;
+      vf  t_near = (vf){ 0 } - HUGE_VALF;
+      vf  t_far = (vf){ 0 } + HUGE_VALF;
+      vfi miss = (vfi){ 0 };
+
+      m = (n - i < GK_FW) ? n - i : GK_FW;
+      ox = GK_NAME(loadf)(origin[0] + i, m) - box->origin[0];
+      oy = GK_NAME(loadf)(origin[1] + i, m) - box->origin[1];
+      oz = GK_NAME(loadf)(origin[2] + i, m) - box->origin[2];
+      dx = GK_NAME(loadf)(direction[0] + i, m);
+      dy = GK_NAME(loadf)(direction[1] + i, m);
+      dz = GK_NAME(loadf)(direction[2] + i, m);
+
+      /* Slab method in the frame of the box, as 'intersect_box_prepared' */
+      for (a = 0; a < 3; a++)
+      {
+         const float *ax = box->axis[a];
+         vf  o = (ox*ax[0]) + (oy*ax[1]) + (oz*ax[2]);
+         vf  d = (dx*ax[0]) + (dy*ax[1]) + (dz*ax[2]);
+         vf  t_lo = (-box->len[a] - o) / d;
+         vf  t_hi = (box->len[a] - o) / d;
+         vf  t = GK_NAME(blendf)(t_lo > t_hi, t_hi, t_lo);
+         vfi par = (GK_NAME(fabsf)(d) < 1.0E-10f);
+
+         /* Parallel to the faces: Inside of the slab or no hit at all */
+         miss |= par & (GK_NAME(fabsf)(o) > box->len[a]);
+
+         t_hi = GK_NAME(blendf)(t_lo > t_hi, t_lo, t_hi);
+         t_lo = t;
+         t_near = GK_NAME(blendf)(~par & (t_lo > t_near), t_lo, t_near);
+         t_far = GK_NAME(blendf)(~par & (t_hi < t_far), t_hi, t_far);
+      }
+      miss |= (t_near > t_far);
+
+      for (l = 0; l < m; l++)
+      {
+         hit[i + l] = (0 == miss[l]);
+         count += hit[i + l];
+         if (NULL != length)
+            length[i + l] = t_far[l] - t_near[l];
+      }
+   }
+
+   return count;
+}
+
+#undef vd
+#undef vi
+#undef vf
+#undef vfi
+#undef GK_FW
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "geometry/geometry.h"
+#include "vmath/vmath.h"
+
+/* Vector kernels for x86-64 need the GCC/Clang target attributes */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GEOMETRY_X86 1
+#include <immintrin.h>
+#endif
+
+static const int64_t gk_sign_bit = INT64_MIN;
+static const int32_t gk_sign_bit_f = INT32_MIN;
+
+/* Scalar kernels: Vectors of one lane */
+#define GK_W 1
+#define GK_NAME(f) gk_##f##_scalar
+#define GK_ATTR
+#define GK_SQRT(v) ((vd){ sqrt((v)[0]) })
+#include "geometry_kernel.h"
+#undef GK_W
+#undef GK_NAME
+#undef GK_ATTR
+#undef GK_SQRT
+
+#ifdef GEOMETRY_X86
+#define GK_W 4
+#define GK_NAME(f) gk_##f##_avx2
+#define GK_ATTR __attribute__((target("avx2")))
+#define GK_SQRT(v) ((vd)_mm256_sqrt_pd((__m256d)(v)))
+#include "geometry_kernel.h"
+#undef GK_W
+#undef GK_NAME
+#undef GK_ATTR
+#undef GK_SQRT
+
+#define GK_W 8
+#define GK_NAME(f) gk_##f##_avx512
+#define GK_ATTR __attribute__((target("avx512f")))
+#define GK_SQRT(v) ((vd)_mm512_sqrt_pd((__m512d)(v)))
+#include "geometry_kernel.h"
+#undef GK_W
+#undef GK_NAME
+#undef GK_ATTR
+#undef GK_SQRT
+#endif
+
+/* The kernels of one instruction set, named as those of 'vmath' */
+typedef struct geometry_set
+{
+   const char *name;
+   int (*rect_n)(const g_rect_prepared *rectangle, int n,
+                 const double *const origin[3], const double *const direction[3],
+                 int *hit, double *translation, double *local_1, double *local_2);
+   int (*rect_nf)(const g_rect_prepared_f *rectangle, int n,
+                  const float *const origin[3], const float *const direction[3], int *hit);
+   int (*box_nf)(const g_box_prepared_f *box, int n,
+                 const float *const origin[3], const float *const direction[3],
+                 int *hit, float *length);
+   int (*disk_n)(const g_disk_prepared *disk, int n,
+                 const double *const origin[3], const double *const direction[3],
+                 int *hit, double *translation, double *local_1, double *local_2);
+   int (*cyl_n)(const g_cylinder_prepared *cylinder, int n,
+                const double *const origin[3], const double *const direction[3],
+                int *hit, double *translation_1, double *translation_2);
+   int (*stack_n)(const g_stack_prepared *stack, int n,
+                  const double *const origin[3], const double *const direction[3],
+                  int *hit, double *translation, double *local_1, double *local_2);
+   int (*poly_n)(const g_poly_prepared *poly, int n,
+                 const double *const origin[3], const double *const direction[3],
+                 int *hit, double *translation_1, double *translation_2);
+} geometry_set;
+
+static const geometry_set gk_sets[] = {
+#ifdef GEOMETRY_X86
+   { "avx512", gk_rect_n_avx512, gk_rect_nf_avx512, gk_box_nf_avx512, gk_disk_n_avx512,
+     gk_cyl_n_avx512, gk_stack_n_avx512, gk_poly_n_avx512 },
+   { "avx2", gk_rect_n_avx2, gk_rect_nf_avx2, gk_box_nf_avx2, gk_disk_n_avx2,
+     gk_cyl_n_avx2, gk_stack_n_avx2, gk_poly_n_avx2 },
+#endif
+   { "scalar", gk_rect_n_scalar, gk_rect_nf_scalar, gk_box_nf_scalar, gk_disk_n_scalar,
+     gk_cyl_n_scalar, gk_stack_n_scalar, gk_poly_n_scalar },
+};
+
+static const int gk_num_sets = sizeof(gk_sets) / sizeof(gk_sets[0]);
+
+/* The kernel follows the one in use by 'vmath': One choice (build option
+   VMATH_KERNEL or 'vmath_use') for all of the array functions */
+static const geometry_set *gk_select(void)
+{
+   const char *name = vmath_kernel();
+   int         i;
+
+   for (i = 0; i < gk_num_sets - 1; i++)
+      if (0 == strcmp(gk_sets[i].name, name))
+         break;
+
+   return &gk_sets[i];
+}
+
+int intersect_rect_n(const g_rect_prepared *rectangle, int n,
+                     const double *const origin[3],
+                     const double *const direction[3],
+                     int *hit, double *translation,
+                     double *local_1, double *local_2)
+{
+   return (gk_select()->rect_n)(rectangle, n, origin, direction,
+                                hit, translation, local_1, local_2);
+}
+
+void prepare_rect_f(g_rect_prepared_f *prepared, const g_rect_prepared *rectangle)
+{
+   copy_vec_f(prepared->normal, rectangle->plane.normal);
+   copy_vec_f(prepared->edge[0], rectangle->edge[0]);
+   copy_vec_f(prepared->edge[1], rectangle->edge[1]);
+
+   prepared->offset = (float)rectangle->plane.offset;
+   prepared->edge_offset[0] = (float)rectangle->edge_offset[0];
+   prepared->edge_offset[1] = (float)rectangle->edge_offset[1];
+   prepared->len[0] = (float)rectangle->len[0];
+   prepared->len[1] = (float)rectangle->len[1];
+}
+
+void prepare_box_f(g_box_prepared_f *prepared, const g_box_prepared *box)
+{
+   int a;
+
+   copy_vec_f(prepared->origin, box->origin);
+   for (a = 0; a < 3; a++)
+   {
+      copy_vec_f(prepared->axis[a], box->axis[a]);
+      prepared->len[a] = (float)box->len[a];
+   }
+}
+
+int intersect_rect_nf(const g_rect_prepared_f *rectangle, int n,
+                      const float *const origin[3],
+                      const float *const direction[3],
+                      int *hit)
+{
+   return (gk_select()->rect_nf)(rectangle, n, origin, direction, hit);
+}
+
+int intersect_box_nf(const g_box_prepared_f *box, int n,
+                     const float *const origin[3],
+                     const float *const direction[3],
+                     int *hit, float *length)
+{
+   return (gk_select()->box_nf)(box, n, origin, direction, hit, length);
+}
+
+int intersect_disk_n(const g_disk_prepared *disk, int n,
+                     const double *const origin[3],
+                     const double *const direction[3],
+                     int *hit, double *translation,
+                     double *local_1, double *local_2)
+{
+   return (gk_select()->disk_n)(disk, n, origin, direction,
+                                hit, translation, local_1, local_2);
+}
+
+int intersect_cylinder_n(const g_cylinder_prepared *cylinder, int n,
+                         const double *const origin[3],
+                         const double *const direction[3],
+                         int *hit, double *translation_1, double *translation_2)
+{
+   return (gk_select()->cyl_n)(cylinder, n, origin, direction,
+                               hit, translation_1, translation_2);
+}
+
+int intersect_stack_n(const g_stack_prepared *stack, int n,
+                      const double *const origin[3],
+                      const double *const direction[3],
+                      int *hit, double *translation,
+                      double *local_1, double *local_2)
+{
+   return (gk_select()->stack_n)(stack, n, origin, direction,
+                                 hit, translation, local_1, local_2);
+}
+
+int intersect_poly_n(const g_poly_prepared *poly, int n,
+                     const double *const origin[3],
+                     const double *const direction[3],
+                     int *hit, double *translation_1, double *translation_2)
+{
+   return (gk_select()->poly_n)(poly, n, origin, direction,
+                                hit, translation_1, translation_2);
+}
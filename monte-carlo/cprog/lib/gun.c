@@ -20,23 +20,81 @@
 #include <string.h>
 
 #include "sphere/sphere.h"
+#include "rng/rng.h"
+#include "rng/qmc.h"
 #include "gun/gun.h"
 
+typedef struct gun_slot
+{
+   gun_trans   tr;
+   gun_trans_n tr_n;
+} gun_slot;
+
 typedef struct gun_context
 {
+   rng_stream rng;
+   void *par;
+   size_t par_size;
    int num_params;
-   gun_trans t_array[];
+   int draws;
+   qmc_view *qmc;
+   double *evt;
+   gun_slot t_array[];
 } gct;
 
+/* Sub-stream for the next gun created without explicit seed */
+static uint64_t s_next_stream = 0;
+
 gun_ctx gun_init(int num_params)
 {
-   gct *new_ctx = malloc(sizeof(int)+num_params*sizeof(gun_trans));
+   return gun_init_par(num_params, NULL, 0);
+}
+
+gun_ctx gun_init_par(int num_params, const void *par, size_t par_size)
+{
+   gct *new_ctx = malloc(sizeof(gct)+num_params*sizeof(gun_slot));
    void* ct = (void*)new_ctx;
-   memset(ct, 0, sizeof(int)+num_params*sizeof(gun_trans));
+   memset(ct, 0, sizeof(gct)+num_params*sizeof(gun_slot));
    new_ctx->num_params = num_params;
+
+   /* Private copy of the parameters */
+   if ((NULL != par) && (par_size > 0))
+   {
+      new_ctx->par = malloc(par_size);
+      memcpy(new_ctx->par, par, par_size);
+      new_ctx->par_size = par_size;
+   }
+
+   /* Independent default sequence for each gun, also if threads create guns at once */
+   rng_seed(&new_ctx->rng, rng_default_seed,
+            __atomic_fetch_add(&s_next_stream, 1, __ATOMIC_RELAXED));
    return ct;
 }
 
+gun_ctx gun_copy(gun_ctx gt)
+{
+   gct *ctx = (gct*)gt;
+   gct *new_ctx;
+
+   if (NULL == ctx)
+      return NULL;
+
+   new_ctx = (gct*)gun_init_par(ctx->num_params, ctx->par, ctx->par_size);
+   memcpy(new_ctx->t_array, ctx->t_array, ctx->num_params*sizeof(gun_slot));
+   new_ctx->draws = ctx->draws;
+   return (gun_ctx)new_ctx;
+}
+
+void *gun_par(gun_ctx gt)
+{
+   gct *ctx = (gct*)gt;
+
+   if (NULL == ctx)
+      return NULL;
+
+   return ctx->par;
+}
+
 int gun_config(gun_ctx gt, int idx, gun_trans tr)
 {
    gct *ctx = (gct*)gt;
@@ -44,7 +102,18 @@ int gun_config(gun_ctx gt, int idx, gun_trans tr)
    if ((idx < 0) || (idx >= ctx->num_params))
       return -1;
 
-   ctx->t_array[idx] = tr;
+   ctx->t_array[idx].tr = tr;
+   return 0;
+}
+
+int gun_config_n(gun_ctx gt, int idx, gun_trans_n tr_n)
+{
+   gct *ctx = (gct*)gt;
+
+   if ((idx < 0) || (idx >= ctx->num_params))
+      return -1;
+
+   ctx->t_array[idx].tr_n = tr_n;
    return 0;
 }
 
@@ -57,14 +126,169 @@ int gun_event(gun_ctx gt, double *out)
       return -1;
 
    for (idx = 0; idx < ctx->num_params; idx++)
-      if (0 != (ctx->t_array[idx])(out+idx))
+   {
+      /* Slot filled by the transform of a previous one */
+      if (NULL == ctx->t_array[idx].tr)
+         continue;
+
+      if (0 != (ctx->t_array[idx].tr)(ctx->par, &ctx->rng, out+idx))
+         return -1;
+   }
+
+   return 0;
+}
+
+int gun_event_n(gun_ctx gt, int n, double **columns)
+{
+   int idx, k;
+   gct *ctx = (gct*)gt;
+
+   if ((NULL == columns) || (n < 0))
+      return -1;
+
+   /* Fed values (quasi-random, stratified) belong to events: Keep the draws of one event in sequence */
+   if ((NULL != ctx->rng.feed) && (ctx->draws > 1))
+   {
+      for (idx = 0; idx < ctx->num_params; idx++)
+         if (NULL == columns[idx])
+            return -1;
+
+      for (k = 0; k < n; k++)
+      {
+         if (0 != gun_event(gt, ctx->evt))
+            return -1;
+         for (idx = 0; idx < ctx->num_params; idx++)
+            columns[idx][k] = ctx->evt[idx];
+      }
+      return 0;
+   }
+
+   for (idx = 0; idx < ctx->num_params; idx++)
+   {
+      gun_slot *slot = &ctx->t_array[idx];
+
+      if (NULL == columns[idx])
          return -1;
 
+      if ((NULL == slot->tr) && (NULL == slot->tr_n))
+         continue;
+
+      if (NULL != slot->tr_n)
+      {
+         /* Whole batch at once */
+         if (0 != (slot->tr_n)(ctx->par, &ctx->rng, n, columns+idx))
+            return -1;
+      }
+      else
+      {
+         /* Fall back to one call per event */
+         for (k = 0; k < n; k++)
+            if (0 != (slot->tr)(ctx->par, &ctx->rng, columns[idx]+k))
+               return -1;
+      }
+   }
+
+   return 0;
+}
+
+int gun_seed(gun_ctx gt, uint64_t seed, uint64_t stream)
+{
+   gct *ctx = (gct*)gt;
+
+   if (NULL == ctx)
+      return -1;
+
+   rng_seed(&ctx->rng, seed, stream);
+   return 0;
+}
+
+int gun_skip(gun_ctx gt, uint64_t n)
+{
+   gct *ctx = (gct*)gt;
+
+   if (NULL == ctx)
+      return -1;
+
+   rng_skip(&ctx->rng, n);
+   return 0;
+}
+
+rng_stream *gun_rng(gun_ctx gt)
+{
+   gct *ctx = (gct*)gt;
+
+   if (NULL == ctx)
+      return NULL;
+
+   return &ctx->rng;
+}
+
+int gun_config_draws(gun_ctx gt, int draws)
+{
+   gct *ctx = (gct*)gt;
+
+   if ((NULL == ctx) || (draws < 0))
+      return -1;
+
+   ctx->draws = draws;
+   return 0;
+}
+
+int gun_qmc(gun_ctx gt, uint64_t seed, uint64_t stream, int dim0)
+{
+   gct *ctx = (gct*)gt;
+
+   if ((NULL == ctx) || (ctx->draws < 1))
+      return -1;
+
+   if (NULL == ctx->qmc)
+      ctx->qmc = malloc(sizeof(qmc_view));
+
+   if (0 != qmc_init(ctx->qmc, seed, stream, dim0, ctx->draws))
+   {
+      gun_feed(gt, NULL, NULL);
+      return -1;
+   }
+
+   gun_feed(gt, qmc_feed, ctx->qmc);
+   return dim0 + ctx->draws;
+}
+
+int gun_draws(gun_ctx gt)
+{
+   gct *ctx = (gct*)gt;
+
+   if (NULL == ctx)
+      return -1;
+
+   return ctx->draws;
+}
+
+int gun_feed(gun_ctx gt, rng_feed feed, void *src)
+{
+   gct *ctx = (gct*)gt;
+
+   if (NULL == ctx)
+      return -1;
+
+   /* Fed values are taken per event, which needs a scratch event */
+   if ((NULL != feed) && (NULL == ctx->evt))
+      ctx->evt = malloc(ctx->num_params*sizeof(double));
+
+   ctx->rng.feed = feed;
+   ctx->rng.src = src;
    return 0;
 }
 
 void gun_delete(gun_ctx gt)
 {
    gct *old_ctx = (gct*)gt;
+
+   if (NULL == old_ctx)
+      return;
+
+   free(old_ctx->par);
+   free(old_ctx->qmc);
+   free(old_ctx->evt);
    free(old_ctx);
 }
@@ -18,22 +18,36 @@
 #include "pdf/pdf.h"
 #include "gun/gun.h"
 
-static double s_lambda = 0.0;
+typedef struct decay_par
+{
+   double lambda;
+} decay_par;
 
-static int gun_decay(double* out)
+static int gun_decay(const void *par, rng_stream *rng, double* out)
 {
-   return decay_pdf(s_lambda, out);
+   const decay_par *p = (const decay_par*)par;
+
+   return decay_pdf(rng, p->lambda, out);
 }
 
-gun_ctx gun_decay_init(double lambda)
+static int gun_decay_n(const void *par, rng_stream *rng, int n, double** out)
 {
-   gun_ctx context = gun_init(1);
+   const decay_par *p = (const decay_par*)par;
+
+   return decay_pdf_n(rng, p->lambda, n, out[0]);
+}
 
+gun_ctx gun_decay_init(double lambda)
+{
    /* Save parameter */
-   s_lambda = lambda;
-   
+   decay_par par = { lambda };
+
+   gun_ctx context = gun_init_par(1, &par, sizeof(par));
+
    /* Create p.d.f for the decay time */
    gun_config(context, 0, gun_decay);
+   gun_config_n(context, 0, gun_decay_n);
 
+   gun_config_draws(context, 1);
    return context;
 }
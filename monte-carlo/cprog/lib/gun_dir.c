@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+
+#include "sphere/sphere.h"
+#include "vector/vector.h"
+#include "vmath/vmath.h"
+#include "gun/gun_dir.h"
+
+/* Note: sin() and cos() of the same argument are merged into a single
+   sincos() call by the compiler when optimizing. The batched variant
+   uses the array kernels of 'vmath' */
+
+void dir_from_cos(double cos_t, double u_phi, double *out)
+{
+   double sin_t = sqrt((1.0 - cos_t) * (1.0 + cos_t));
+   double phi = 2.0 * pi * u_phi;
+
+   out[0] = sin_t * cos(phi);
+   out[1] = sin_t * sin(phi);
+   out[2] = cos_t;
+}
+
+void dir_from_cos_n(int n, double **out)
+{
+   double *ux = out[0];
+   double *uy = out[1];
+   double *uz = out[2];
+   int    i;
+
+   /* Azimuth in place, then cos(phi) back into the x column */
+   for (i = 0; i < n; i++)
+      ux[i] = 2.0 * pi * ux[i];
+   vmath_sincos(n, ux, uy, ux);
+
+   for (i = 0; i < n; i++)
+   {
+      double sin_t = sqrt((1.0 - uz[i]) * (1.0 + uz[i]));
+
+      ux[i] = sin_t * ux[i];
+      uy[i] = sin_t * uy[i];
+   }
+}
+
+void dir_frame_init(dir_frame *frame, const vec3 normal)
+{
+   const vec3 zenith = { 0.0, 0.0, 1.0 };
+   vec3   t;
+   double len_t;
+
+   copy_vec(frame->n, normal);
+   if (frame->n[z_c] < 0.0)
+      scale_vec(frame->n, -1.0);
+
+   /* Part of the zenith orthogonal to the normal */
+   frame->a = dot_vec(zenith, frame->n);
+   scale_vec2(t, frame->n, -frame->a);
+   add_vec(t, t, zenith);
+
+   len_t = sqrt(dot_vec(t, t));
+   if (len_t < 1.0E-12)
+   {
+      /* Normal along zenith: Any orthogonal vector will do */
+      t[x_c] = 1.0;
+      t[y_c] = 0.0;
+      t[z_c] = 0.0;
+      len_t = 0.0;
+   }
+   else
+   {
+      scale_vec(t, 1.0/len_t);
+   }
+
+   copy_vec(frame->t, t);
+   cross_vec(frame->w, frame->n, frame->t);
+   frame->b = len_t;
+}
+
+void dir_from_disk(const dir_frame *frame, double x, double y, double *out)
+{
+   double h2 = 1.0 - x*x - y*y;
+   double h = (h2 > 0.0) ? sqrt(h2) : 0.0;
+   double s;
+   int    i;
+
+   for (i = 0; i < 3; i++)
+      out[i] = x*frame->t[i] + y*frame->w[i] + h*frame->n[i];
+
+   s = (out[2] < 0.0) ? -1.0 : 1.0;
+   for (i = 0; i < 3; i++)
+      out[i] *= s;
+}
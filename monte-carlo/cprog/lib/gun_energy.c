@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pdg/pdg.h"
+#include "sphere/sphere.h"
+#include "gun/gun.h"
+#include "gun/gun_dir.h"
+#include "gun/gun_table.h"
+#include "gun/gun_energy.h"
+
+/* Rows of the energy tables, equally spaced in cos(zenith) from 0 to 1 */
+#define ENERGY_ROWS 65
+
+/* Levels of the tail: Level j holds 1-u in [2^-(j+1), 2^-j] in 'ENERGY_SUBS' steps */
+#define ENERGY_LEVELS 40
+#define ENERGY_SUBS 16
+#define ENERGY_NODES (ENERGY_LEVELS * (ENERGY_SUBS + 1))
+
+/* Points of the integration in log(energy) */
+#define ENERGY_FINE 4096
+
+/* Cells of the direction table */
+#define ENERGY_N_THETA 512
+#define ENERGY_N_PHI 128
+
+/* Uniform values used per event: Direction, then energy */
+#define ENERGY_DRAWS 4
+
+/* Number of events to draw uniform values for at once */
+#define ENERGY_CHUNK 64
+
+/* Everything the tables depend on, compared with the cache */
+typedef struct energy_setup
+{
+   int    model;
+   int    use_cos;
+   int    has_normal;
+   int    layout[5];
+   double normal[3];
+   double e_min;
+   double e_max;
+} energy_setup;
+
+/* Parameters of the gun, followed by the direction table */
+typedef struct energy_par
+{
+   energy_setup setup;
+   double       rate[ENERGY_ROWS];
+   double       log_e[ENERGY_ROWS][ENERGY_NODES];
+} energy_par;
+
+/* Marks a cache file */
+static const char energy_magic[16] = "MUON-E-TABLE-01";
+
+static const dir_table *energy_dirs(const energy_par *p)
+{
+   return (const dir_table*)((const char*)p + sizeof(energy_par));
+}
+
+/* Intensity above e_min, interpolated between the rows */
+static double energy_dir_j(const void *data, double theta, double phi)
+{
+   const energy_par *p = (const energy_par*)data;
+   double x = cos(theta) * (double)(ENERGY_ROWS - 1);
+   int    r;
+
+   if (!(x > 0.0))
+      return 0.0;
+
+   r = (int)x;
+   if (r >= ENERGY_ROWS - 1)
+      r = ENERGY_ROWS - 2;
+
+   return p->rate[r] + (x - (double)r) * (p->rate[r+1] - p->rate[r]);
+}
+
+/* Energy for cos(zenith) 'c' and the uniform value 'u' */
+static double energy_value(const energy_par *p, double c, double u)
+{
+   const double *a, *b;
+   double x = c * (double)(ENERGY_ROWS - 1);
+   double f, pos, t, l_a, l_b;
+   int    r, e, j, k;
+
+   if (!(x > 0.0))
+      x = 0.0;
+   r = (int)x;
+   if (r >= ENERGY_ROWS - 1)
+      r = ENERGY_ROWS - 2;
+
+   /* Level from the exponent of 1-u, the position from its mantissa */
+   f = frexp(1.0 - u, &e);
+   j = -e;
+   if (j < 0)
+   {
+      j = 0;
+      f = 1.0;
+   }
+   else if (j >= ENERGY_LEVELS)
+   {
+      j = ENERGY_LEVELS - 1;
+      f = 0.5;
+   }
+
+   pos = (f - 0.5) * (2.0 * ENERGY_SUBS);
+   k = (int)pos;
+   if (k >= ENERGY_SUBS)
+      k = ENERGY_SUBS - 1;
+   t = pos - (double)k;
+   k += j * (ENERGY_SUBS + 1);
+
+   a = p->log_e[r];
+   b = p->log_e[r+1];
+   l_a = a[k] + t * (a[k+1] - a[k]);
+   l_b = b[k] + t * (b[k+1] - b[k]);
+
+   return exp(l_a + (x - (double)r) * (l_b - l_a));
+}
+
+static void energy_event(const energy_par *p, const double *u, double *out)
+{
+   dir_table_dir(energy_dirs(p), u, out);
+   out[3] = energy_value(p, out[2], u[3]);
+}
+
+static int gun_energy(const void *par, rng_stream *rng, double* out)
+{
+   double u[ENERGY_DRAWS];
+
+   rng_uniform_n(rng, ENERGY_DRAWS, u);
+   energy_event((const energy_par*)par, u, out);
+   return 0;
+}
+
+static int gun_energy_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   double u[ENERGY_DRAWS*ENERGY_CHUNK];
+   double d[4];
+   int i, j, m;
+
+   /* Same sequence as single events */
+   for (i = 0; i < n; i += m)
+   {
+      m = (n - i < ENERGY_CHUNK) ? n - i : ENERGY_CHUNK;
+      rng_uniform_n(rng, ENERGY_DRAWS*m, u);
+
+      for (j = 0; j < m; j++)
+      {
+         energy_event((const energy_par*)par, u + ENERGY_DRAWS*j, d);
+         out[0][i+j] = d[0];
+         out[1][i+j] = d[1];
+         out[2][i+j] = d[2];
+         out[3][i+j] = d[3];
+      }
+   }
+   return 0;
+}
+
+/* Inverse cumulative distribution of the energy in row 'r', 'tail' is scratch space */
+/**
+ ** The integral of the spectrum above E is taken on a fine grid in log(E). The
+ ** nodes of the table are found where it falls to (1-u) of its total, with
+ ** log-log interpolation, as the tail is close to a power law.
+ **/
+static void energy_row(energy_par *p, int r, double *tail)
+{
+   const energy_setup *s = &p->setup;
+   double theta = acos((double)r / (double)(ENERGY_ROWS - 1));
+   double l_min = log(s->e_min);
+   double h = (log(s->e_max) - l_min) / (double)(ENERGY_FINE - 1);
+   double f_1, f_0;
+   int    i, j, k;
+
+   /* Integrand in log(E) is j(E) * E */
+   tail[ENERGY_FINE - 1] = 0.0;
+   f_1 = j_spec(s->model, s->e_max, theta) * s->e_max;
+   for (i = ENERGY_FINE - 2; i >= 0; i--)
+   {
+      double e = exp(l_min + h * (double)i);
+
+      f_0 = j_spec(s->model, e, theta) * e;
+      tail[i] = tail[i+1] + 0.5 * h * (f_0 + f_1);
+      f_1 = f_0;
+   }
+   p->rate[r] = tail[0];
+
+   if (!(tail[0] > 0.0))
+      return;
+
+   for (j = 0; j < ENERGY_LEVELS; j++)
+      for (k = 0; k <= ENERGY_SUBS; k++)
+      {
+         double target = ldexp(0.5 + (double)k / (2.0 * ENERGY_SUBS), -j) * tail[0];
+         double t;
+         int    lo = 0, hi = ENERGY_FINE - 1;
+
+         /* tail[lo] >= target > tail[hi] */
+         if (target >= tail[0])
+         {
+            p->log_e[r][j * (ENERGY_SUBS + 1) + k] = l_min;
+            continue;
+         }
+         while (hi - lo > 1)
+         {
+            int mid = (lo + hi) / 2;
+
+            if (tail[mid] >= target)
+               lo = mid;
+            else
+               hi = mid;
+         }
+
+         if (tail[hi] > 0.0)
+            t = log(target / tail[lo]) / log(tail[hi] / tail[lo]);
+         else
+            t = (tail[lo] - target) / tail[lo];
+
+         p->log_e[r][j * (ENERGY_SUBS + 1) + k] = l_min + h * ((double)lo + t);
+      }
+}
+
+/* Build the energy and the direction tables of 'p' */
+static int energy_build(energy_par *p, const vec3 normal)
+{
+   double *tail = malloc(ENERGY_FINE*sizeof(double));
+   int    r;
+
+   for (r = 0; r < ENERGY_ROWS; r++)
+      energy_row(p, r, tail);
+   free(tail);
+
+   /* Rows without flux (horizon) take the energies of their upper neighbour */
+   for (r = ENERGY_ROWS - 2; r >= 0; r--)
+      if (!(p->rate[r] > 0.0))
+         memcpy(p->log_e[r], p->log_e[r+1], sizeof(p->log_e[r]));
+
+   if (!(p->rate[ENERGY_ROWS - 1] > 0.0))
+      return -1;
+
+   return dir_table_fill((dir_table*)((char*)p + sizeof(energy_par)), energy_dir_j, p,
+                         normal, p->setup.use_cos, ENERGY_N_THETA, ENERGY_N_PHI);
+}
+
+/* Tables from the cache file, if it was written for the same setup */
+static int energy_load(energy_par *p, size_t size, const char *cache)
+{
+   FILE     *f = fopen(cache, "rb");
+   char     magic[sizeof(energy_magic)];
+   uint64_t f_size;
+   int      ok;
+
+   if (NULL == f)
+      return -1;
+
+   ok = (1 == fread(magic, sizeof(magic), 1, f)) &&
+        (0 == memcmp(magic, energy_magic, sizeof(magic))) &&
+        (1 == fread(&f_size, sizeof(f_size), 1, f)) &&
+        (f_size == (uint64_t)size);
+
+   if (ok)
+   {
+      energy_setup setup = p->setup;
+
+      ok = (1 == fread(p, size, 1, f)) &&
+           (0 == memcmp(&setup, &p->setup, sizeof(setup)));
+      if (!ok)
+         p->setup = setup;
+   }
+
+   fclose(f);
+   return ok ? 0 : -1;
+}
+
+static void energy_save(const energy_par *p, size_t size, const char *cache)
+{
+   FILE     *f = fopen(cache, "wb");
+   uint64_t f_size = (uint64_t)size;
+
+   /* No cache is no error */
+   if (NULL == f)
+      return;
+
+   fwrite(energy_magic, sizeof(energy_magic), 1, f);
+   fwrite(&f_size, sizeof(f_size), 1, f);
+   fwrite(p, size, 1, f);
+   fclose(f);
+}
+
+gun_ctx gun_energy_init(int model, const vec3 normal, int use_cos,
+                        double e_min, double e_max, const char *cache)
+{
+   size_t      size = sizeof(energy_par) + dir_table_size(ENERGY_N_THETA, ENERGY_N_PHI);
+   energy_par *par;
+   gun_ctx     context;
+
+   if ((model < 0) || (model > 1) || !(e_min > 0.0) || !(e_max > e_min))
+      return NULL;
+
+   par = malloc(size);
+
+   /* Zero padding, as the setup is compared as a whole */
+   memset(&par->setup, 0, sizeof(par->setup));
+   par->setup.model = model;
+   par->setup.use_cos = use_cos;
+   par->setup.has_normal = (NULL != normal);
+   par->setup.layout[0] = ENERGY_ROWS;
+   par->setup.layout[1] = ENERGY_LEVELS;
+   par->setup.layout[2] = ENERGY_SUBS;
+   par->setup.layout[3] = ENERGY_N_THETA;
+   par->setup.layout[4] = ENERGY_N_PHI;
+   if (NULL != normal)
+      memcpy(par->setup.normal, normal, sizeof(par->setup.normal));
+   par->setup.e_min = e_min;
+   par->setup.e_max = e_max;
+
+   if ((NULL == cache) || (0 != energy_load(par, size, cache)))
+   {
+      if (0 != energy_build(par, normal))
+      {
+         free(par);
+         return NULL;
+      }
+      if (NULL != cache)
+         energy_save(par, size, cache);
+   }
+
+   context = gun_init_par(4, par, size);
+   free(par);
+
+   /* One transform fills all four columns */
+   gun_config(context, 0, gun_energy);
+   gun_config_n(context, 0, gun_energy_n);
+
+   gun_config_draws(context, ENERGY_DRAWS);
+   return context;
+}
+
+double gun_energy_norm(gun_ctx gt)
+{
+   const energy_par *p = (const energy_par*)gun_par(gt);
+
+   if (NULL == p)
+      return 0.0;
+
+   return dir_table_norm(energy_dirs(p));
+}
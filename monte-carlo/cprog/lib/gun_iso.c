@@ -17,38 +17,201 @@
 
 #include "pdf/pdf.h"
 #include "gun/gun.h"
+#include "gun/gun_dir.h"
 #include "sphere/sphere.h"
+#include "vmath/vmath.h"
 #include <stdlib.h>
 #include <math.h>
 
-static int gUseCos = 0;
+typedef struct iso_par
+{
+   int use_cos;
+} iso_par;
 
-static int gun_phi(double* out)
+static int gun_phi(const void *par, rng_stream *rng, double* out)
 {
-   *out = 2.0 * pi * drand48();
+   *out = 2.0 * pi * rng_uniform(rng);
    return 0;
 }
 
-static int gun_theta(double* out)
+static int gun_theta(const void *par, rng_stream *rng, double* out)
 {
-   double cost = 1.0 - (2.0*drand48());
-   if (gUseCos)
+   const iso_par *p = (const iso_par*)par;
+
+   double cost = 1.0 - (2.0*rng_uniform(rng));
+   if (p->use_cos)
       *out = cost;
    else
       *out = acos(cost);
    return 0;
 }
 
+static int gun_phi_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   return uniform_pdf_n(rng, 0.0, 2.0 * pi, n, out[0]);
+}
+
+static int gun_theta_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   const iso_par *p = (const iso_par*)par;
+   double *c = out[0];
+   int i;
+
+   /* Draw all values first, then transform them in one tight loop */
+   rng_uniform_n(rng, n, c);
+   for (i = 0; i < n; i++)
+      c[i] = 1.0 - (2.0*c[i]);
+
+   if (!p->use_cos)
+      vmath_acos(n, c, c);
+   return 0;
+}
+
 gun_ctx gun_iso_init(int use_cos)
 {
-   gun_ctx context = gun_init(2);
+   /* Save switch */
+   iso_par par = { use_cos };
+
+   gun_ctx context = gun_init_par(2, &par, sizeof(par));
 
    /* Create p.d.f for spherical isotropic events */
    gun_config(context, 0, gun_theta);
    gun_config(context, 1, gun_phi);
+   gun_config_n(context, 0, gun_theta_n);
+   gun_config_n(context, 1, gun_phi_n);
 
-   /* Save switch */
-   gUseCos = use_cos;
+   gun_config_draws(context, 2);
+   return context;
+}
 
+static int gun_dir(const void *par, rng_stream *rng, double* out)
+{
+   double cost = 1.0 - (2.0*rng_uniform(rng));
+
+   dir_from_cos(cost, rng_uniform(rng), out);
+   return 0;
+}
+
+static int gun_dir_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   double *c = out[2];
+   int i;
+
+   /* cos(theta) into the z column, azimuth variable into the x column */
+   rng_uniform_n(rng, n, c);
+   for (i = 0; i < n; i++)
+      c[i] = 1.0 - (2.0*c[i]);
+   rng_uniform_n(rng, n, out[0]);
+
+   dir_from_cos_n(n, out);
+   return 0;
+}
+
+gun_ctx gun_iso_dir_init(void)
+{
+   gun_ctx context = gun_init(3);
+
+   /* One transform fills all three components */
+   gun_config(context, 0, gun_dir);
+   gun_config_n(context, 0, gun_dir_n);
+
+   gun_config_draws(context, 2);
    return context;
 }
+
+typedef struct iso_flux_par
+{
+   dir_frame frame;
+   double    r2_max;
+} iso_flux_par;
+
+/* Uniform values used per event */
+#define ISO_FLUX_DRAWS 2
+
+/* Number of events to draw uniform values for at once */
+#define FLUX_CHUNK 64
+
+/* Map uniform values 'u' to a direction with density ~ |cos(normal)| */
+/**
+ ** The disk area of the normal's frame is the solid angle times |cos|, so
+ ** the isotropic flux is a uniform point in the unit disk. Inside of a cone it is a
+ ** uniform point in the disk of radius sin(angle) of the cone: Its squared radius is 'r2_max'.
+ ** 'c', 's' are cos and sin of the angle 2*pi*u[1].
+ **/
+static void iso_flux_dir(const iso_flux_par *p, const double *u, double c, double s, double *out)
+{
+   double r = sqrt(u[0] * p->r2_max);
+   double x = r * c;
+   double y = r * s;
+
+   dir_from_disk(&p->frame, x, y, out);
+}
+
+static int gun_flux(const void *par, rng_stream *rng, double* out)
+{
+   double u[ISO_FLUX_DRAWS];
+
+   rng_uniform_n(rng, ISO_FLUX_DRAWS, u);
+   iso_flux_dir((const iso_flux_par*)par, u, cos(2.0 * pi * u[1]), sin(2.0 * pi * u[1]), out);
+   return 0;
+}
+
+static int gun_flux_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   double u[ISO_FLUX_DRAWS*FLUX_CHUNK];
+   double c[FLUX_CHUNK], s[FLUX_CHUNK];
+   double d[3];
+   int i, j, m;
+
+   /* Same sequence as single events */
+   for (i = 0; i < n; i += m)
+   {
+      m = (n - i < FLUX_CHUNK) ? n - i : FLUX_CHUNK;
+      rng_uniform_n(rng, ISO_FLUX_DRAWS*m, u);
+
+      /* Angles of the whole chunk at once */
+      for (j = 0; j < m; j++)
+         c[j] = 2.0 * pi * u[ISO_FLUX_DRAWS*j + 1];
+      vmath_sincos(m, c, s, c);
+
+      for (j = 0; j < m; j++)
+      {
+         iso_flux_dir((const iso_flux_par*)par, u + ISO_FLUX_DRAWS*j, c[j], s[j], d);
+         out[0][i+j] = d[0];
+         out[1][i+j] = d[1];
+         out[2][i+j] = d[2];
+      }
+   }
+   return 0;
+}
+
+double gun_iso_flux_cone_weight(const vec3 normal, double cos_max)
+{
+   /* Area of the disk inside of the cone */
+   return (cos_max > 0.0) ? 1.0 - cos_max*cos_max : 1.0;
+}
+
+gun_ctx gun_iso_flux_cone_init(const vec3 normal, double cos_max)
+{
+   iso_flux_par par;
+   gun_ctx context;
+
+   if (cos_max > 1.0)
+      return NULL;
+
+   dir_frame_init(&par.frame, normal);
+   par.r2_max = gun_iso_flux_cone_weight(normal, cos_max);
+
+   context = gun_init_par(3, &par, sizeof(par));
+
+   gun_config(context, 0, gun_flux);
+   gun_config_n(context, 0, gun_flux_n);
+
+   gun_config_draws(context, ISO_FLUX_DRAWS);
+   return context;
+}
+
+gun_ctx gun_iso_flux_init(const vec3 normal)
+{
+   return gun_iso_flux_cone_init(normal, 0.0);
+}
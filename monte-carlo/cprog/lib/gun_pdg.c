@@ -17,38 +17,255 @@
 
 #include "pdf/pdf.h"
 #include "gun/gun.h"
+#include "gun/gun_dir.h"
 #include "sphere/sphere.h"
+#include "vmath/vmath.h"
 #include <stdlib.h>
 #include <math.h>
 
-static int gUseCos = 0;
+typedef struct pdg_par
+{
+   int use_cos;
+} pdg_par;
 
-static int gun_phi(double* out)
+static int gun_phi(const void *par, rng_stream *rng, double* out)
 {
-   *out = 2.0 * pi * drand48();
+   *out = 2.0 * pi * rng_uniform(rng);
    return 0;
 }
 
-static int gun_theta(double* out)
+static int gun_theta(const void *par, rng_stream *rng, double* out)
 {
-   double cost = pow(drand48(), (1.0/3.0));
-   if (gUseCos)
+   const pdg_par *p = (const pdg_par*)par;
+
+   double cost = pow(rng_uniform(rng), (1.0/3.0));
+   if (p->use_cos)
       *out = cost;
    else
       *out = acos(cost);
    return 0;
 }
 
+static int gun_phi_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   return uniform_pdf_n(rng, 0.0, 2.0 * pi, n, out[0]);
+}
+
+static int gun_theta_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   const pdg_par *p = (const pdg_par*)par;
+   double *c = out[0];
+
+   /* Draw all values first, then transform them in one tight loop */
+   rng_uniform_n(rng, n, c);
+   vmath_cbrt(n, c, c);
+
+   if (!p->use_cos)
+      vmath_acos(n, c, c);
+   return 0;
+}
+
 gun_ctx gun_pdg_init(int use_cos)
 {
-   gun_ctx context = gun_init(2);
+   /* Save switch */
+   pdg_par par = { use_cos };
+
+   gun_ctx context = gun_init_par(2, &par, sizeof(par));
 
    /* Create p.d.f for spherical isotropic events */
    gun_config(context, 0, gun_theta);
    gun_config(context, 1, gun_phi);
+   gun_config_n(context, 0, gun_theta_n);
+   gun_config_n(context, 1, gun_phi_n);
 
-   /* Save switch */
-   gUseCos = use_cos;
+   gun_config_draws(context, 2);
+   return context;
+}
+
+static int gun_dir(const void *par, rng_stream *rng, double* out)
+{
+   double cost = cbrt(rng_uniform(rng));
+
+   dir_from_cos(cost, rng_uniform(rng), out);
+   return 0;
+}
+
+static int gun_dir_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   double *c = out[2];
+
+   /* cos(theta) into the z column, azimuth variable into the x column */
+   rng_uniform_n(rng, n, c);
+   vmath_cbrt(n, c, c);
+   rng_uniform_n(rng, n, out[0]);
+
+   dir_from_cos_n(n, out);
+   return 0;
+}
+
+gun_ctx gun_pdg_dir_init(void)
+{
+   gun_ctx context = gun_init(3);
 
+   /* One transform fills all three components */
+   gun_config(context, 0, gun_dir);
+   gun_config_n(context, 0, gun_dir_n);
+
+   gun_config_draws(context, 2);
    return context;
 }
+
+typedef struct pdg_flux_par
+{
+   dir_frame frame;
+   double    p_vert;
+   double    r_max;
+   double    c_vert;
+} pdg_flux_par;
+
+/* Uniform values used per event */
+#define PDG_FLUX_DRAWS 5
+
+/* Number of events to draw uniform values for at once */
+#define FLUX_CHUNK 64
+
+/* Map uniform values 'u' to a direction with density ~ cos^2(zenith) * |cos(normal)| */
+/**
+ ** A direction is a point (x, y) in the unit disk of the normal's frame, as the
+ ** disk area is the solid angle times |cos|. On the disk, the flux is
+ **   (a*h + b*x)^2 = a^2*h^2 + b^2*x^2 + 2*a*b*h*x,   h^2 = 1 - x^2 - y^2
+ ** The even part is a mixture of a vertical (~ h^2) and a tilted (~ x^2) shape,
+ ** both sampled by inversion. The odd part only decides the sign of x.
+ ** Inside of a cone, the radius is limited to 'r_max' = sin(angle) of the cone:
+ ** 'c_vert' is the share of the vertical shape there, 1 - (1 - r_max^2)^2.
+ ** 'c_a', 's_a' are cos and sin of the angle 2*pi*u[1].
+ **/
+static void pdg_flux_dir(const pdg_flux_par *p, const double *u, double c_a, double s_a, double *out)
+{
+   const dir_frame *f = &p->frame;
+   double r, c, s, x, y, h2, h, g_p, g_m;
+
+   /* Radius and angle come first, the choice of the shape after them */
+   if (u[2] < p->p_vert)
+   {
+      /* Radius ~ (1 - r^2) r, uniform angle */
+      r = sqrt(1.0 - sqrt(1.0 - u[0] * p->c_vert));
+      c = c_a;
+      s = s_a;
+   }
+   else
+   {
+      /* Radius ~ r^3, angle ~ cos^2: Seen from the edge of the unit circle, a
+         uniform point in the circle has an angle distributed with cos^2 */
+      double rho = sqrt(u[3]);
+      double v_x = 1.0 + rho * c_a;
+      double v_y = rho * s_a;
+      double len = sqrt(v_x*v_x + v_y*v_y);
+
+      r = p->r_max * sqrt(sqrt(u[0]));
+      c = (len > 0.0) ? v_x/len : 1.0;
+      s = (len > 0.0) ? v_y/len : 0.0;
+   }
+
+   x = fabs(r * c);
+   y = r * s;
+
+   h2 = 1.0 - r*r;
+   h = (h2 > 0.0) ? sqrt(h2) : 0.0;
+
+   /* Sign of x with the weight of the flux at +x and -x */
+   g_p = (f->a*h + f->b*x) * (f->a*h + f->b*x);
+   g_m = (f->a*h - f->b*x) * (f->a*h - f->b*x);
+   if (u[4] * (g_p + g_m) >= g_p)
+      x = -x;
+
+   dir_from_disk(f, x, y, out);
+}
+
+static int gun_flux(const void *par, rng_stream *rng, double* out)
+{
+   double u[PDG_FLUX_DRAWS];
+
+   rng_uniform_n(rng, PDG_FLUX_DRAWS, u);
+   pdg_flux_dir((const pdg_flux_par*)par, u, cos(2.0 * pi * u[1]), sin(2.0 * pi * u[1]), out);
+   return 0;
+}
+
+static int gun_flux_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   double u[PDG_FLUX_DRAWS*FLUX_CHUNK];
+   double c[FLUX_CHUNK], s[FLUX_CHUNK];
+   double d[3];
+   int i, j, m;
+
+   /* Same sequence as single events */
+   for (i = 0; i < n; i += m)
+   {
+      m = (n - i < FLUX_CHUNK) ? n - i : FLUX_CHUNK;
+      rng_uniform_n(rng, PDG_FLUX_DRAWS*m, u);
+
+      /* Angles of the whole chunk at once */
+      for (j = 0; j < m; j++)
+         c[j] = 2.0 * pi * u[PDG_FLUX_DRAWS*j + 1];
+      vmath_sincos(m, c, s, c);
+
+      for (j = 0; j < m; j++)
+      {
+         pdg_flux_dir((const pdg_flux_par*)par, u + PDG_FLUX_DRAWS*j, c[j], s[j], d);
+         out[0][i+j] = d[0];
+         out[1][i+j] = d[1];
+         out[2][i+j] = d[2];
+      }
+   }
+   return 0;
+}
+
+/* Weights of the vertical and tilted shape inside of the disk of radius R:
+   a^2*(R^2 - R^4/2) and b^2*R^4/4, times 4 */
+static void pdg_cone_shapes(const dir_frame *f, double r2, double *w_vert, double *w_tilt)
+{
+   *w_vert = 2.0*f->a*f->a * (2.0*r2 - r2*r2);
+   *w_tilt = f->b*f->b * r2*r2;
+}
+
+double gun_pdg_flux_cone_weight(const vec3 normal, double cos_max)
+{
+   dir_frame f;
+   double    r2 = (cos_max > 0.0) ? 1.0 - cos_max*cos_max : 1.0;
+   double    w_vert, w_tilt, w_vert_1, w_tilt_1;
+
+   dir_frame_init(&f, normal);
+   pdg_cone_shapes(&f, r2, &w_vert, &w_tilt);
+   pdg_cone_shapes(&f, 1.0, &w_vert_1, &w_tilt_1);
+   return (w_vert + w_tilt) / (w_vert_1 + w_tilt_1);
+}
+
+gun_ctx gun_pdg_flux_cone_init(const vec3 normal, double cos_max)
+{
+   pdg_flux_par par;
+   gun_ctx context;
+   double r2 = (cos_max > 0.0) ? 1.0 - cos_max*cos_max : 1.0;
+   double w_vert, w_tilt;
+
+   if (cos_max > 1.0)
+      return NULL;
+
+   dir_frame_init(&par.frame, normal);
+   pdg_cone_shapes(&par.frame, r2, &w_vert, &w_tilt);
+   par.p_vert = w_vert / (w_vert + w_tilt);
+   par.r_max = sqrt(r2);
+   par.c_vert = 1.0 - (1.0 - r2)*(1.0 - r2);
+
+   context = gun_init_par(3, &par, sizeof(par));
+
+   gun_config(context, 0, gun_flux);
+   gun_config_n(context, 0, gun_flux_n);
+
+   gun_config_draws(context, PDG_FLUX_DRAWS);
+   return context;
+}
+
+gun_ctx gun_pdg_flux_init(const vec3 normal)
+{
+   return gun_pdg_flux_cone_init(normal, 0.0);
+}
@@ -19,25 +19,38 @@
 #include "pdf/pdf.h"
 #include "gun/gun.h"
 
-static double s_min = 0.0;
-static double s_max = 1.0;
+typedef struct range_par
+{
+   double min;
+   double max;
+} range_par;
 
-static int gun_range(double* out)
+static int gun_range(const void *par, rng_stream *rng, double* out)
 {
-   *out = s_min + (s_max-s_min) * drand48();
+   const range_par *p = (const range_par*)par;
+
+   *out = p->min + (p->max - p->min) * rng_uniform(rng);
    return 0;
 }
 
-gun_ctx gun_range_init(double min, double max)
+static int gun_range_n(const void *par, rng_stream *rng, int n, double** out)
 {
-   gun_ctx context = gun_init(1);
+   const range_par *p = (const range_par*)par;
+
+   return uniform_pdf_n(rng, p->min, p->max, n, out[0]);
+}
 
+gun_ctx gun_range_init(double min, double max)
+{
    /* Save parameters */
-   s_min = min;
-   s_max = max;
-   
+   range_par par = { min, max };
+
+   gun_ctx context = gun_init_par(1, &par, sizeof(par));
+
    /* Create p.d.f for the a range of values */
    gun_config(context, 0, gun_range);
+   gun_config_n(context, 0, gun_range_n);
 
+   gun_config_draws(context, 1);
    return context;
 }
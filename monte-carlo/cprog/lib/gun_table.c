@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sphere/sphere.h"
+#include "vector/vector.h"
+#include "gun/gun.h"
+#include "gun/gun_dir.h"
+#include "gun/gun_table.h"
+
+/* Cell of the alias table: Keep it with probability 'prob', else take 'alias' */
+typedef struct table_cell
+{
+   double prob;
+   int    alias;
+} table_cell;
+
+/* The cells are followed by cos(theta) at the n_theta+1 edges of the rows */
+struct dir_table
+{
+   int        n_theta;
+   int        n_phi;
+   double     d_theta;
+   double     norm;
+   table_cell cell[];
+};
+
+static const double *table_edges(const dir_table *p)
+{
+   return (const double*)(p->cell + p->n_theta * p->n_phi);
+}
+
+/* Uniform values used per event */
+#define TABLE_DRAWS 3
+
+/* Direction from the uniform values 'u': Cell, then cos(theta) and phi inside of it */
+void dir_table_dir(const dir_table *p, const double *u, double *out)
+{
+   double x = u[0] * (double)(p->n_theta * p->n_phi);
+   int    c = (int)x;
+   int    i_t, i_p;
+   double c_0, c_1;
+   const double *edge = table_edges(p);
+
+   if (c >= p->n_theta * p->n_phi)
+      c = p->n_theta * p->n_phi - 1;
+
+   /* Remaining bits of the first value flip the coin of the cell */
+   if (x - (double)c >= p->cell[c].prob)
+      c = p->cell[c].alias;
+
+   i_t = c / p->n_phi;
+   i_p = c % p->n_phi;
+
+   /* Uniform in solid angle: cos(theta) and phi are uniform */
+   c_0 = edge[i_t];
+   c_1 = edge[i_t + 1];
+
+   dir_from_cos(c_0 - u[1] * (c_0 - c_1), ((double)i_p + u[2]) / (double)p->n_phi, out);
+}
+
+static int gun_table(const void *par, rng_stream *rng, double* out)
+{
+   double u[TABLE_DRAWS];
+
+   rng_uniform_n(rng, TABLE_DRAWS, u);
+   dir_table_dir((const dir_table*)par, u, out);
+   return 0;
+}
+
+/* Number of events to draw uniform values for at once */
+#define TABLE_CHUNK 64
+
+static int gun_table_n(const void *par, rng_stream *rng, int n, double** out)
+{
+   double u[TABLE_DRAWS*TABLE_CHUNK];
+   double d[3];
+   int i, j, m;
+
+   /* Same sequence as single events */
+   for (i = 0; i < n; i += m)
+   {
+      m = (n - i < TABLE_CHUNK) ? n - i : TABLE_CHUNK;
+      rng_uniform_n(rng, TABLE_DRAWS*m, u);
+
+      for (j = 0; j < m; j++)
+      {
+         dir_table_dir((const dir_table*)par, u + TABLE_DRAWS*j, d);
+         out[0][i+j] = d[0];
+         out[1][i+j] = d[1];
+         out[2][i+j] = d[2];
+      }
+   }
+   return 0;
+}
+
+/* Alias table of the weights 'w' (mean 1) after M. D. Vose (1991), 'w' is overwritten */
+static void table_alias(table_cell *cell, double *w, int num)
+{
+   int *small = malloc(num*sizeof(int));
+   int *large = malloc(num*sizeof(int));
+   int n_s = 0, n_l = 0;
+   int c;
+
+   /* Weights have the mean 1: Sort the cells below and above it */
+   for (c = 0; c < num; c++)
+   {
+      cell[c].alias = c;
+      if (w[c] < 1.0)
+         small[n_s++] = c;
+      else
+         large[n_l++] = c;
+   }
+
+   /* Fill each small cell up with a part of a large one */
+   while ((n_s > 0) && (n_l > 0))
+   {
+      int s = small[--n_s];
+      int l = large[n_l - 1];
+
+      cell[s].prob = w[s];
+      cell[s].alias = l;
+
+      w[l] -= 1.0 - w[s];
+      if (w[l] < 1.0)
+      {
+         --n_l;
+         small[n_s++] = l;
+      }
+   }
+
+   /* Leftovers are full up to round off */
+   while (n_l > 0)
+      cell[large[--n_l]].prob = 1.0;
+   while (n_s > 0)
+      cell[small[--n_s]].prob = 1.0;
+
+   free(small);
+   free(large);
+}
+
+size_t dir_table_size(int n_theta, int n_phi)
+{
+   if ((n_theta < 1) || (n_phi < 1) || (n_theta > INT32_MAX / n_phi))
+      return 0;
+
+   return sizeof(dir_table) + (size_t)(n_theta * n_phi)*sizeof(table_cell) +
+      (size_t)(n_theta + 1)*sizeof(double);
+}
+
+int dir_table_fill(dir_table *tab, gun_intensity_d j, const void *data,
+                   const vec3 normal, int use_cos, int n_theta, int n_phi)
+{
+   double *w, *edge;
+   double sum = 0.0;
+   double d_phi;
+   int    num, i_t, i_p, c;
+
+   if ((NULL == tab) || (NULL == j) || (0 == dir_table_size(n_theta, n_phi)))
+      return -1;
+
+   num = n_theta * n_phi;
+   w = malloc(num*sizeof(double));
+
+   tab->n_theta = n_theta;
+   tab->n_phi = n_phi;
+   tab->d_theta = (pi / 2.0) / (double)n_theta;
+   tab->norm = 0.0;
+   d_phi = (2.0 * pi) / (double)n_phi;
+
+   /* Intensity at the center of the cell times its solid angle */
+   for (i_t = 0, c = 0; i_t < n_theta; i_t++)
+   {
+      double theta = tab->d_theta * ((double)i_t + 0.5);
+      double omega = (cos(tab->d_theta * (double)i_t) - cos(tab->d_theta * (double)(i_t + 1))) * d_phi;
+
+      for (i_p = 0; i_p < n_phi; i_p++, c++)
+      {
+         double phi = d_phi * ((double)i_p + 0.5);
+         double f = 1.0;
+         double v = j(data, theta, phi) * omega;
+
+         if (NULL != normal)
+         {
+            vec3 u = { sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta) };
+
+            f = fabs(dot_vec(normal, u));
+         }
+
+         w[c] = (use_cos) ? v * f : v;
+         tab->norm += v * f;
+         sum += w[c];
+      }
+   }
+
+   if (!(sum > 0.0))
+   {
+      free(w);
+      return -1;
+   }
+
+   for (c = 0; c < num; c++)
+      w[c] *= (double)num / sum;
+   table_alias(tab->cell, w, num);
+
+   edge = (double*)table_edges(tab);
+   for (i_t = 0; i_t <= n_theta; i_t++)
+      edge[i_t] = cos(tab->d_theta * (double)i_t);
+
+   free(w);
+   return 0;
+}
+
+double dir_table_norm(const dir_table *tab)
+{
+   return tab->norm;
+}
+
+/* Plain intensity of 'gun_table_init' */
+static double table_j(const void *data, double theta, double phi)
+{
+   return (*(const gun_intensity*)data)(theta, phi);
+}
+
+gun_ctx gun_table_init(gun_intensity j, const vec3 normal, int use_cos,
+                       int n_theta, int n_phi)
+{
+   size_t     size = dir_table_size(n_theta, n_phi);
+   dir_table *par;
+   gun_ctx    context;
+
+   if ((NULL == j) || (0 == size))
+      return NULL;
+
+   par = malloc(size);
+   if (0 != dir_table_fill(par, table_j, &j, normal, use_cos, n_theta, n_phi))
+   {
+      free(par);
+      return NULL;
+   }
+
+   context = gun_init_par(3, par, size);
+   free(par);
+
+   /* One transform fills all three components */
+   gun_config(context, 0, gun_table);
+   gun_config_n(context, 0, gun_table_n);
+
+   gun_config_draws(context, TABLE_DRAWS);
+   return context;
+}
+
+double gun_table_norm(gun_ctx gt)
+{
+   const dir_table *p = (const dir_table*)gun_par(gt);
+
+   if (NULL == p)
+      return 0.0;
+
+   return p->norm;
+}
@@ -0,0 +1,848 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vector/vector_inline.h"
+#include "geometry/geometry.h"
+#include "mesh/mesh.h"
+
+/* Most triangles in a leaf of the hierarchy */
+#define MESH_LEAF 4
+
+/* Bins of the surface area heuristic along the axis of a split */
+#define MESH_BINS 16
+
+/* Deeper than this, the splits are at the median: Any tree then stays within
+   MESH_SAH_DEPTH + 31 levels, and the traversal stack within MESH_STACK */
+#define MESH_SAH_DEPTH 32
+#define MESH_STACK 96
+
+/* Subtrees of fewer triangles are not worth a thread of their own */
+#define MESH_PAR_MIN 8192
+
+/* Records of a binary STL file read at once */
+#define MESH_CHUNK 1024
+
+/* A triangle: Its corners in single precision, as in STL files */
+typedef struct mesh_tri
+{
+   float v[3][3];
+} mesh_tri;
+
+/* A node of the hierarchy, as 'scene_node' with single precision bounds:
+   Leaves hold 'count' > 0 triangles from 'first', inner nodes have their
+   left child next to them and the right one at 'first' */
+typedef struct mesh_node
+{
+   float lo[3];
+   float hi[3];
+   int   first;
+   int   count;
+} mesh_node;
+
+typedef struct mesh_context
+{
+   mesh_tri  *tri;
+   int       *id;
+   int        num;
+   int        cap;
+   mesh_node *node;
+   int        num_node;
+   int        built;
+} mect;
+
+/* A subtree to build: The triangles 'first' to 'first+count-1' under the node
+   'index'. The subtree owns the 2*count-1 nodes from there, so threads never
+   share a node */
+typedef struct mesh_job
+{
+   mect      *m;
+   mesh_node *node;
+   int        first;
+   int        count;
+   int        index;
+   int        depth;
+   int        threads;
+} mesh_job;
+
+mesh_ctx mesh_init(void)
+{
+   mect *m = malloc(sizeof(mect));
+
+   if (NULL != m)
+      memset(m, 0, sizeof(mect));
+   return (mesh_ctx)m;
+}
+
+void mesh_delete(mesh_ctx ctx)
+{
+   mect *m = (mect*)ctx;
+
+   if (NULL == m)
+      return;
+
+   free(m->tri);
+   free(m->id);
+   free(m->node);
+   free(m);
+}
+
+int mesh_num(mesh_ctx ctx)
+{
+   return ((mect*)ctx)->num;
+}
+
+/* Room for 'extra' more triangles */
+static int mesh_grow(mect *m, int extra)
+{
+   mesh_tri *tri;
+   int      *id;
+   int       cap = (m->cap > 0) ? m->cap : 16;
+
+   /* Node indices of the build go up to twice the number of triangles */
+   if (extra > INT_MAX/2 - m->num)
+      return -1;
+   if (m->num + extra <= m->cap)
+      return 0;
+
+   while (cap < m->num + extra)
+      cap = (cap > INT_MAX/4) ? INT_MAX/2 : 2*cap;
+
+   tri = realloc(m->tri, sizeof(mesh_tri)*cap);
+   if (NULL == tri)
+      return -1;
+   m->tri = tri;
+
+   id = realloc(m->id, sizeof(int)*cap);
+   if (NULL == id)
+      return -1;
+   m->id = id;
+
+   m->cap = cap;
+   return 0;
+}
+
+/* Store a triangle into the room made by 'mesh_grow' */
+static int mesh_put(mect *m, const vec3 v0, const vec3 v1, const vec3 v2)
+{
+   const double *v[3] = { v0, v1, v2 };
+   mesh_tri     *t = &m->tri[m->num];
+   int           c, a;
+
+   for (c = 0; c < 3; c++)
+      for (a = 0; a < 3; a++)
+      {
+         if (!isfinite(v[c][a]))
+            return -1;
+         t->v[c][a] = (float)v[c][a];
+      }
+
+   m->id[m->num] = m->num;
+   m->built = 0;
+   return m->num++;
+}
+
+int mesh_add_tri(mesh_ctx ctx, const vec3 v0, const vec3 v1, const vec3 v2)
+{
+   mect *m = (mect*)ctx;
+
+   if (0 != mesh_grow(m, 1))
+      return -1;
+   return mesh_put(m, v0, v1, v2);
+}
+
+/* Add the corners 'v' of a triangle from a file, moved with 'pose' */
+static int mesh_put_posed(mect *m, vec3 v[3], const g_pose *pose)
+{
+   int c;
+
+   if (NULL != pose)
+      for (c = 0; c < 3; c++)
+         pose_apply(v[c], pose, v[c]);
+
+   return (mesh_put(m, v[0], v[1], v[2]) < 0) ? -1 : 0;
+}
+
+/* Little endian values of binary STL files */
+static uint32_t mesh_le32(const unsigned char *b)
+{
+   return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static double mesh_le_float(const unsigned char *b)
+{
+   uint32_t u = mesh_le32(b);
+   float    f;
+
+   memcpy(&f, &u, sizeof(f));
+   return f;
+}
+
+/* Binary: 80 bytes of header, the count, then 50 bytes per triangle (the normal,
+   the three corners and two bytes of attributes) */
+static int mesh_read_binary(mect *m, FILE *f, uint32_t count, const g_pose *pose)
+{
+   unsigned char *buf;
+   uint32_t       done, k, j;
+   int            c, a;
+
+   if ((count > INT_MAX) || (0 != mesh_grow(m, (int)count)))
+      return -1;
+
+   buf = malloc(50*MESH_CHUNK);
+   if (NULL == buf)
+      return -1;
+
+   for (done = 0; done < count; done += k)
+   {
+      k = (count - done < MESH_CHUNK) ? count - done : MESH_CHUNK;
+      if (k != fread(buf, 50, k, f))
+      {
+         free(buf);
+         return -1;
+      }
+
+      for (j = 0; j < k; j++)
+      {
+         const unsigned char *rec = buf + 50*j + 12;
+         vec3                 v[3];
+
+         for (c = 0; c < 3; c++)
+            for (a = 0; a < 3; a++)
+               v[c][a] = mesh_le_float(rec + 12*c + 4*a);
+
+         if (0 != mesh_put_posed(m, v, pose))
+         {
+            free(buf);
+            return -1;
+         }
+      }
+   }
+
+   free(buf);
+   return (int)count;
+}
+
+/* ASCII: Only the 'vertex' lines matter, three of them up to each 'endfacet' */
+static int mesh_read_ascii(mect *m, FILE *f, const g_pose *pose)
+{
+   char word[64];
+   vec3 v[3];
+   int  nv = 0;
+   int  count = 0;
+
+   if ((1 != fscanf(f, "%63s", word)) || (0 != strcmp(word, "solid")))
+      return -1;
+
+   while (1 == fscanf(f, "%63s", word))
+   {
+      if (0 == strcmp(word, "vertex"))
+      {
+         if ((nv == 3) || (3 != fscanf(f, "%lf %lf %lf", &v[nv][0], &v[nv][1], &v[nv][2])))
+            return -1;
+         ++nv;
+      }
+      else if (0 == strcmp(word, "endfacet"))
+      {
+         if ((nv != 3) || (0 != mesh_grow(m, 1)) || (0 != mesh_put_posed(m, v, pose)))
+            return -1;
+         nv = 0;
+         ++count;
+      }
+   }
+
+   return (nv == 0) ? count : -1;
+}
+
+int mesh_load_stl(mesh_ctx ctx, const char *file_name, const g_pose *pose)
+{
+   mect         *m = (mect*)ctx;
+   FILE         *f = fopen(file_name, "rb");
+   unsigned char head[84];
+   long          size = -1;
+   int           num = m->num;
+   int           built = m->built;
+   int           res = -1;
+
+   if (NULL == f)
+      return -1;
+
+   if ((0 == fseek(f, 0, SEEK_END)) && ((size = ftell(f)) >= 0) && (0 == fseek(f, 0, SEEK_SET)))
+   {
+      /* Binary files have the size their count gives, even if they start
+         with "solid" as the ASCII ones do */
+      if ((size >= 84) && (84 == fread(head, 1, 84, f))
+          && ((uint64_t)size == 84 + 50*(uint64_t)mesh_le32(head + 80)))
+         res = mesh_read_binary(m, f, mesh_le32(head + 80), pose);
+      else if (0 == fseek(f, 0, SEEK_SET))
+         res = mesh_read_ascii(m, f, pose);
+   }
+   fclose(f);
+
+   /* None of a broken file */
+   if (res < 0)
+   {
+      m->num = num;
+      m->built = built;
+   }
+   return res;
+}
+
+/* Smaller and larger of two values: Plain compares, the calls of 'fmin' and
+   'fmax' cost more than the rest of the tests of the bounds */
+static double mesh_min(double x, double y)
+{
+   return (x < y) ? x : y;
+}
+
+static double mesh_max(double x, double y)
+{
+   return (x > y) ? x : y;
+}
+
+/* Center of a triangle along axis 'a' (three times the value: Only compared) */
+static double mesh_center(const mesh_tri *t, int a)
+{
+   return ((double)t->v[0][a] + t->v[1][a]) + t->v[2][a];
+}
+
+static void mesh_extent(const mesh_tri *t, int a, double *lo, double *hi)
+{
+   *lo = mesh_min(mesh_min(t->v[0][a], t->v[1][a]), t->v[2][a]);
+   *hi = mesh_max(mesh_max(t->v[0][a], t->v[1][a]), t->v[2][a]);
+}
+
+static void mesh_swap(mect *m, int i, int j)
+{
+   mesh_tri t = m->tri[i];
+   int      id = m->id[i];
+
+   m->tri[i] = m->tri[j];
+   m->id[i] = m->id[j];
+   m->tri[j] = t;
+   m->id[j] = id;
+}
+
+/* Reorder the triangles 'first' to 'last' as 'scene_select' does the volumes:
+   Triangle 'k' in its sorted place by the center along axis 'a' */
+static void mesh_select(mect *m, int first, int last, int k, int a)
+{
+   while (first < last)
+   {
+      double pivot = mesh_center(&m->tri[(first + last) / 2], a);
+      int    i = first;
+      int    j = last;
+
+      while (i <= j)
+      {
+         while (mesh_center(&m->tri[i], a) < pivot)
+            i++;
+         while (mesh_center(&m->tri[j], a) > pivot)
+            j--;
+         if (i <= j)
+            mesh_swap(m, i++, j--);
+      }
+
+      if (k <= j)
+         last = j;
+      else if (k >= i)
+         first = i;
+      else
+         return;
+   }
+}
+
+/* Half of the surface of a bounding box */
+static double mesh_area(const double lo[3], const double hi[3])
+{
+   double dx = hi[0] - lo[0];
+   double dy = hi[1] - lo[1];
+   double dz = hi[2] - lo[2];
+
+   return dx*dy + dy*dz + dz*dx;
+}
+
+/* Bin of a center, the same for the counts and the partition */
+static int mesh_bin(double c, double c_lo, double scale)
+{
+   int b = (int)((c - c_lo) * scale);
+
+   return (b < MESH_BINS) ? b : MESH_BINS - 1;
+}
+
+/* Split of the triangles of a job by the binned surface area heuristic: The
+   number of them that go to the left child, 0 if no split was found */
+static int mesh_split_sah(mesh_job *job, int axis, double c_lo, double c_hi)
+{
+   mect  *m = job->m;
+   double scale = MESH_BINS / (c_hi - c_lo);
+   double b_lo[MESH_BINS][3], b_hi[MESH_BINS][3];
+   double r_area[MESH_BINS];
+   int    b_count[MESH_BINS];
+   double lo[3], hi[3];
+   double best_cost = HUGE_VAL;
+   int    best = -1;
+   int    n_left, i, j, b, a;
+
+   for (b = 0; b < MESH_BINS; b++)
+   {
+      b_count[b] = 0;
+      for (a = 0; a < 3; a++)
+      {
+         b_lo[b][a] = HUGE_VAL;
+         b_hi[b][a] = -HUGE_VAL;
+      }
+   }
+
+   for (i = job->first; i < job->first + job->count; i++)
+   {
+      const mesh_tri *t = &m->tri[i];
+
+      b = mesh_bin(mesh_center(t, axis), c_lo, scale);
+      b_count[b]++;
+      for (a = 0; a < 3; a++)
+      {
+         double e_lo, e_hi;
+
+         mesh_extent(t, a, &e_lo, &e_hi);
+         b_lo[b][a] = mesh_min(b_lo[b][a], e_lo);
+         b_hi[b][a] = mesh_max(b_hi[b][a], e_hi);
+      }
+   }
+
+   /* Areas right of each split, then the costs from the left */
+   for (a = 0; a < 3; a++)
+   {
+      lo[a] = HUGE_VAL;
+      hi[a] = -HUGE_VAL;
+   }
+   for (b = MESH_BINS - 1; b > 0; b--)
+   {
+      for (a = 0; a < 3; a++)
+      {
+         lo[a] = mesh_min(lo[a], b_lo[b][a]);
+         hi[a] = mesh_max(hi[a], b_hi[b][a]);
+      }
+      r_area[b] = (lo[0] <= hi[0]) ? mesh_area(lo, hi) : 0.0;
+   }
+
+   for (a = 0; a < 3; a++)
+   {
+      lo[a] = HUGE_VAL;
+      hi[a] = -HUGE_VAL;
+   }
+   n_left = 0;
+   for (b = 0; b < MESH_BINS - 1; b++)
+   {
+      double cost;
+
+      for (a = 0; a < 3; a++)
+      {
+         lo[a] = mesh_min(lo[a], b_lo[b][a]);
+         hi[a] = mesh_max(hi[a], b_hi[b][a]);
+      }
+      n_left += b_count[b];
+      if ((n_left == 0) || (n_left == job->count))
+         continue;
+
+      cost = mesh_area(lo, hi) * n_left + r_area[b + 1] * (job->count - n_left);
+      if (cost < best_cost)
+      {
+         best_cost = cost;
+         best = b;
+      }
+   }
+
+   if (best < 0)
+      return 0;
+
+   /* Bins up to 'best' to the left */
+   i = job->first;
+   j = job->first + job->count - 1;
+   while (i <= j)
+   {
+      if (mesh_bin(mesh_center(&m->tri[i], axis), c_lo, scale) <= best)
+         i++;
+      else
+         mesh_swap(m, i, j--);
+   }
+
+   return i - job->first;
+}
+
+/* Node of a job, and its subtree: On a thread of its own if started with
+   'pthread_create' */
+static void *mesh_build_node(void *arg)
+{
+   mesh_job  *job = (mesh_job*)arg;
+   mect      *m = job->m;
+   mesh_node *nd = &job->node[job->index];
+   mesh_job   left, right;
+   pthread_t  thread;
+   double     lo[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+   double     hi[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+   double     c_lo[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+   double     c_hi[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+   int        i, a, axis;
+   int        split = 0;
+
+   for (i = job->first; i < job->first + job->count; i++)
+      for (a = 0; a < 3; a++)
+      {
+         double c = mesh_center(&m->tri[i], a);
+         double e_lo, e_hi;
+
+         mesh_extent(&m->tri[i], a, &e_lo, &e_hi);
+         lo[a] = mesh_min(lo[a], e_lo);
+         hi[a] = mesh_max(hi[a], e_hi);
+         c_lo[a] = mesh_min(c_lo[a], c);
+         c_hi[a] = mesh_max(c_hi[a], c);
+      }
+
+   /* Padded a little, so that round off never loses a crossing */
+   for (a = 0; a < 3; a++)
+   {
+      nd->lo[a] = (float)(lo[a] - 1.0E-6 * (1.0 + fabs(lo[a])));
+      nd->hi[a] = (float)(hi[a] + 1.0E-6 * (1.0 + fabs(hi[a])));
+   }
+
+   if (job->count <= MESH_LEAF)
+   {
+      nd->first = job->first;
+      nd->count = job->count;
+      return NULL;
+   }
+
+   axis = 0;
+   for (a = 1; a < 3; a++)
+      if (c_hi[a] - c_lo[a] > c_hi[axis] - c_lo[axis])
+         axis = a;
+
+   if ((job->depth < MESH_SAH_DEPTH) && (c_hi[axis] > c_lo[axis]))
+      split = mesh_split_sah(job, axis, c_lo[axis], c_hi[axis]);
+
+   /* Deep in the tree, or no split found: At the median */
+   if (split == 0)
+   {
+      split = job->count / 2;
+      if (c_hi[axis] > c_lo[axis])
+         mesh_select(m, job->first, job->first + job->count - 1, job->first + split, axis);
+   }
+
+   left = *job;
+   left.count = split;
+   left.index = job->index + 1;
+   left.depth = job->depth + 1;
+
+   right = *job;
+   right.first = job->first + split;
+   right.count = job->count - split;
+   right.index = job->index + 2*split;
+   right.depth = job->depth + 1;
+
+   nd->first = right.index;
+   nd->count = 0;
+
+   /* Share the threads between the children while there is enough to do */
+   if ((job->threads > 1) && (job->count >= MESH_PAR_MIN))
+   {
+      left.threads = job->threads / 2;
+      right.threads = job->threads - left.threads;
+      if (0 == pthread_create(&thread, NULL, mesh_build_node, &left))
+      {
+         mesh_build_node(&right);
+         pthread_join(thread, NULL);
+         return NULL;
+      }
+   }
+
+   left.threads = 1;
+   right.threads = 1;
+   mesh_build_node(&left);
+   mesh_build_node(&right);
+   return NULL;
+}
+
+/* Number of nodes in the subtree of 'index' */
+static int mesh_count_nodes(const mesh_node *node, int index)
+{
+   if (node[index].count > 0)
+      return 1;
+   return 1 + mesh_count_nodes(node, index + 1) + mesh_count_nodes(node, node[index].first);
+}
+
+/* Copy the subtree of 'index' without the unused nodes, in the same order */
+static void mesh_compact(mect *m, const mesh_node *node, int index)
+{
+   int at = m->num_node++;
+
+   m->node[at] = node[index];
+   if (node[index].count > 0)
+      return;
+
+   mesh_compact(m, node, index + 1);
+   m->node[at].first = m->num_node;
+   mesh_compact(m, node, node[index].first);
+}
+
+int mesh_build(mesh_ctx ctx, int threads)
+{
+   mect      *m = (mect*)ctx;
+   mesh_node *scratch;
+   mesh_job   job;
+
+   free(m->node);
+   m->node = NULL;
+   m->num_node = 0;
+   m->built = 0;
+
+   if (m->num == 0)
+   {
+      m->built = 1;
+      return 0;
+   }
+
+   if (threads <= 0)
+      threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if (threads <= 0)
+      threads = 1;
+
+   /* A binary tree with leaves of at least one triangle */
+   scratch = malloc(sizeof(mesh_node)*(2*(size_t)m->num - 1));
+   if (NULL == scratch)
+      return -1;
+
+   job.m = m;
+   job.node = scratch;
+   job.first = 0;
+   job.count = m->num;
+   job.index = 0;
+   job.depth = 0;
+   job.threads = threads;
+   mesh_build_node(&job);
+
+   m->node = malloc(sizeof(mesh_node)*mesh_count_nodes(scratch, 0));
+   if (NULL == m->node)
+   {
+      free(scratch);
+      return -1;
+   }
+   mesh_compact(m, scratch, 0);
+   free(scratch);
+
+   m->built = 1;
+   return 0;
+}
+
+/* Does the line cross the bounds? As 'scene_cross_bounds' */
+static int mesh_cross_bounds(const mesh_node *nd, const g_ray *ray, const double inv[3])
+{
+   double t_near = -HUGE_VAL;
+   double t_far = HUGE_VAL;
+   int    a;
+
+   for (a = 0; a < 3; a++)
+   {
+      double t_lo, t_hi;
+
+      if (ray->direction[a] == 0.0)
+      {
+         if ((ray->origin[a] < nd->lo[a]) || (ray->origin[a] > nd->hi[a]))
+            return 0;
+         continue;
+      }
+
+      t_lo = (nd->lo[a] - ray->origin[a]) * inv[a];
+      t_hi = (nd->hi[a] - ray->origin[a]) * inv[a];
+      if (t_lo > t_hi)
+      {
+         double t = t_lo;
+
+         t_lo = t_hi;
+         t_hi = t;
+      }
+      t_near = mesh_max(t_near, t_lo);
+      t_far = mesh_min(t_far, t_hi);
+   }
+
+   return t_near <= t_far;
+}
+
+/* Crossing of the line with a triangle (Moeller and Trumbore), with its edges
+   and corners. Returns 1 with the crossing in 'h', else 0 */
+static int mesh_cross_tri(const mesh_tri *tri, const g_ray *ray, mesh_hit *h)
+{
+   vec3   v0, e1, e2, p, s, q;
+   double det, inv, u, v;
+   int    a;
+
+   for (a = 0; a < 3; a++)
+   {
+      v0[a] = tri->v[0][a];
+      e1[a] = tri->v[1][a] - v0[a];
+      e2[a] = tri->v[2][a] - v0[a];
+   }
+
+   /* 'det' is minus the projection of the direction onto the outer normal */
+   cross_vec(p, ray->direction, e2);
+   det = dot_vec(e1, p);
+   if (det == 0.0)
+      return 0;
+   inv = 1.0 / det;
+
+   diff_vec(s, ray->origin, v0);
+   u = dot_vec(s, p) * inv;
+   if ((u < 0.0) || (u > 1.0))
+      return 0;
+
+   cross_vec(q, s, e1);
+   v = dot_vec(ray->direction, q) * inv;
+   if ((v < 0.0) || (u + v > 1.0))
+      return 0;
+
+   h->translation = dot_vec(e2, q) * inv;
+   h->enter = (det > 0.0);
+   return 1;
+}
+
+void mesh_crossings_free(mesh_crossings *cr)
+{
+   free(cr->hit);
+   cr->hit = NULL;
+   cr->num = 0;
+   cr->cap = 0;
+}
+
+/* Append a crossing in path order, as 'scene_push' */
+static int mesh_push(mesh_crossings *cr, const mesh_hit *h)
+{
+   int i;
+
+   if (cr->num == cr->cap)
+   {
+      int       cap = (cr->cap > 0) ? 2*cr->cap : 16;
+      mesh_hit *hit = realloc(cr->hit, sizeof(mesh_hit)*cap);
+
+      if (NULL == hit)
+         return -1;
+      cr->hit = hit;
+      cr->cap = cap;
+   }
+
+   i = cr->num++;
+   while ((i > 0) && (cr->hit[i-1].translation > h->translation))
+   {
+      cr->hit[i] = cr->hit[i-1];
+      --i;
+   }
+   cr->hit[i] = *h;
+   return 0;
+}
+
+int mesh_cross(mesh_ctx ctx, const g_ray *ray, double t_min, double t_max,
+               mesh_crossings *cr, double *thickness)
+{
+   const mect *m = (const mect*)ctx;
+   int         stack[MESH_STACK];
+   int         top = 0;
+   double      inv[3];
+   double      t_prev = -HUGE_VAL;
+   double      thick = 0.0;
+   int         depth = 0;
+   int         i, k, a;
+
+   cr->num = 0;
+   if (NULL != thickness)
+      *thickness = 0.0;
+   if (!m->built)
+      return -1;
+   if (m->num == 0)
+      return 0;
+
+   for (a = 0; a < 3; a++)
+      inv[a] = 1.0 / ray->direction[a];
+
+   /* The whole line: The inside at 't_min' depends on the crossings before it */
+   stack[top++] = 0;
+   while (top > 0)
+   {
+      const mesh_node *nd = &m->node[stack[--top]];
+
+      if (!mesh_cross_bounds(nd, ray, inv))
+         continue;
+
+      if (nd->count == 0)
+      {
+         stack[top++] = nd->first;
+         stack[top++] = (int)(nd - m->node) + 1;
+         continue;
+      }
+
+      for (i = nd->first; i < nd->first + nd->count; i++)
+      {
+         mesh_hit h;
+
+         if (!mesh_cross_tri(&m->tri[i], ray, &h))
+            continue;
+
+         h.tri = m->id[i];
+         if (0 != mesh_push(cr, &h))
+            return -1;
+      }
+   }
+
+   /* Through an edge or a corner: The triangles there cross at the same place
+      in the same sense, only one of them counts */
+   k = 0;
+   for (i = 0; i < cr->num; i++)
+   {
+      const mesh_hit *h = &cr->hit[i];
+
+      if ((k > 0) && (cr->hit[k-1].enter == h->enter)
+          && (h->translation - cr->hit[k-1].translation <= 1.0E-9 * (1.0 + fabs(h->translation))))
+         continue;
+      cr->hit[k++] = *h;
+   }
+
+   /* Inside, where the line entered more often than it left: Its length there
+      between 't_min' and 't_max', and the crossings in that range */
+   cr->num = 0;
+   for (i = 0; i < k; i++)
+   {
+      double t = cr->hit[i].translation;
+
+      if (depth > 0)
+         thick += fmax(0.0, fmin(t, t_max) - fmax(t_prev, t_min));
+      depth += cr->hit[i].enter ? 1 : -1;
+      t_prev = t;
+
+      if ((t >= t_min) && (t <= t_max))
+         cr->hit[cr->num++] = cr->hit[i];
+   }
+
+   if (NULL != thickness)
+      *thickness = thick;
+   return cr->num;
+}
@@ -20,42 +20,74 @@
 #include <stdlib.h>
 
 #include "sphere/sphere.h"
+#include "rng/rng.h"
+#include "vmath/vmath.h"
 #include "pdf/pdf.h"
 
-int uniform_pdf(double min, double max, double *out)
+int uniform_pdf(rng_stream *rng, double min, double max, double *out)
 {
-   if (NULL == out)
+   if ((NULL == rng)||(NULL == out))
       return -1;
 
-   *out = min + (max - min) * drand48();
+   *out = min + (max - min) * rng_uniform(rng);
    return 0;
 }
 
-int decay_pdf(double lambda, double *out)
+int decay_pdf(rng_stream *rng, double lambda, double *out)
 {
-   if (NULL == out)
+   if ((NULL == rng)||(NULL == out))
       return -1;
 
-   *out = -lambda * log(1.0 - drand48());
+   *out = -lambda * log(1.0 - rng_uniform(rng));
    return 0;
 }
 
-int isotropic_sphere_pdf(double *cos_t, double *phi)
+int isotropic_sphere_pdf(rng_stream *rng, double *cos_t, double *phi)
 {
-   if ((NULL == cos_t)||(NULL == phi))
+   if ((NULL == rng)||(NULL == cos_t)||(NULL == phi))
       return -1;
 
-   *phi = 2.0 * pi * drand48(); /* Uniform between 0 and 2 pi */
-   *cos_t = 1.0 - (2.0*drand48()); /* dOmega between 0 and pi */
+   *phi = 2.0 * pi * rng_uniform(rng); /* Uniform between 0 and 2 pi */
+   *cos_t = 1.0 - (2.0*rng_uniform(rng)); /* dOmega between 0 and pi */
    return 0;
 }
 
-int pdg_sphere_pdf(double *cos_t, double *phi)
+int pdg_sphere_pdf(rng_stream *rng, double *cos_t, double *phi)
 {
-   if ((NULL == cos_t)||(NULL == phi))
+   if ((NULL == rng)||(NULL == cos_t)||(NULL == phi))
       return -1;
 
-   *phi = 2.0 * pi * drand48(); /* Uniform between 0 and 2 pi */
-   *cos_t = pow(drand48(), 0.33333333); /* dOmega between 0 and pi/2 */
+   *phi = 2.0 * pi * rng_uniform(rng); /* Uniform between 0 and 2 pi */
+   *cos_t = pow(rng_uniform(rng), 0.33333333); /* dOmega between 0 and pi/2 */
+   return 0;
+}
+
+int uniform_pdf_n(rng_stream *rng, double min, double max, int n, double *out)
+{
+   int i;
+
+   if ((NULL == rng)||(NULL == out))
+      return -1;
+
+   rng_uniform_n(rng, n, out);
+   for (i = 0; i < n; ++i)
+      out[i] = min + (max - min) * out[i];
+   return 0;
+}
+
+int decay_pdf_n(rng_stream *rng, double lambda, int n, double *out)
+{
+   int i;
+
+   if ((NULL == rng)||(NULL == out))
+      return -1;
+
+   rng_uniform_n(rng, n, out);
+   for (i = 0; i < n; ++i)
+      out[i] = 1.0 - out[i];
+
+   vmath_log(n, out, out);
+   for (i = 0; i < n; ++i)
+      out[i] = -lambda * out[i];
    return 0;
 }
@@ -30,6 +30,23 @@ const double mu_iso_i = mu_pdg_i / 2.0;  /* m^-2 s^-1 sr^-2 */
 /* Muon intensity for point source with 0.02 rads sigma */
 const double mu_pnt_i = mu_pdg_i * (12.8369);  /* m^-2 s^-1 sr^-2 */
 
+/* Muon mass */
+const double mu_mass = 0.1056583755;  /* GeV */
+
+/* Effective cos(theta) of Gaisser's formula, after D. Chirkin (2004) */
+static const double ch_p1 = 0.102573;
+static const double ch_p2 = -0.068287;
+static const double ch_p3 = 0.958633;
+static const double ch_p4 = 0.0407253;
+static const double ch_p5 = 0.817285;
+
+/* Vertical spectrum of D. Reyna (2006), c1 in m^-2 s^-1 sr^-1 (GeV/c)^-1 */
+static const double ry_c1 = 25.3;
+static const double ry_c2 = 0.2455;
+static const double ry_c3 = 1.288;
+static const double ry_c4 = -0.2555;
+static const double ry_c5 = 0.0209;
+
 /* Implementation of the functions */
 
 double j_val(int type, double theta, double phi)
@@ -93,3 +110,51 @@ double r_tot_PDG(double theta, double area)
    
    return (center + spread * cos(2.0 * theta)) * area;
 }
+
+double j_spec(int model, double energy, double theta)
+{
+   switch(model)
+   {
+   case 0: /* Gaisser */
+      return j_spec_gaisser(energy, theta);
+
+   case 1: /* Reyna */
+      return j_spec_reyna(energy, theta);
+
+   default:
+      abort();
+   }
+}
+
+double j_spec_gaisser(double energy, double theta)
+{
+   double ct = cos(theta);
+   double cs;
+
+   /* Cut off flux below horizon */
+   if ((ct <= 0.0) || (energy <= 0.0))
+      return 0.0;
+
+   cs = sqrt((ct*ct + ch_p1*ch_p1 + ch_p2*pow(ct, ch_p3) + ch_p4*pow(ct, ch_p5)) /
+             (1.0 + ch_p1*ch_p1 + ch_p2 + ch_p4));
+
+   /* Pion and kaon parts, 0.14 cm^-2 s^-1 sr^-1 GeV^-1 */
+   return 1.4E3 * pow(energy, -2.7) *
+      (1.0 / (1.0 + 1.1 * energy * cs / 115.0) + 0.054 / (1.0 + 1.1 * energy * cs / 850.0));
+}
+
+double j_spec_reyna(double energy, double theta)
+{
+   double ct = cos(theta);
+   double p, l;
+
+   /* Cut off flux below horizon */
+   if ((ct <= 0.0) || (energy <= mu_mass))
+      return 0.0;
+
+   /* Fit in p*cos(theta), dp/dE = E/p */
+   p = sqrt((energy - mu_mass) * (energy + mu_mass));
+   l = log10(p * ct);
+
+   return ct*ct*ct * ry_c1 * pow(p * ct, -(ry_c2 + l * (ry_c3 + l * (ry_c4 + l * ry_c5)))) * energy / p;
+}
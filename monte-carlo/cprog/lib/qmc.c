@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rng/rng.h"
+#include "rng/qmc.h"
+
+/* Sobol direction numbers after S. Joe and F. Y. Kuo (new-joe-kuo-6.21201) */
+/**
+ ** For each dimension but the first: Degree 's' and coefficients 'a' of the
+ ** primitive polynomial, and the initial values 'm'.
+ **/
+typedef struct sobol_init {
+   int      s;
+   uint32_t a;
+   uint32_t m[6];
+} sobol_init;
+
+static const sobol_init s_sobol[QMC_MAX_DIM-1] = {
+   { 1,  0, { 1 } },
+   { 2,  1, { 1, 3 } },
+   { 3,  1, { 1, 3, 1 } },
+   { 3,  2, { 1, 1, 1 } },
+   { 4,  1, { 1, 1, 3, 3 } },
+   { 4,  4, { 1, 3, 5, 13 } },
+   { 5,  2, { 1, 1, 5, 5, 17 } },
+   { 5,  4, { 1, 1, 5, 5, 5 } },
+   { 5,  7, { 1, 1, 7, 11, 19 } },
+   { 5, 11, { 1, 1, 5, 1, 1 } },
+   { 5, 13, { 1, 1, 1, 3, 11 } },
+   { 5, 14, { 1, 3, 5, 5, 31 } },
+   { 6,  1, { 1, 3, 3, 9, 7, 49 } },
+   { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+   { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+};
+
+/* Scale 32 bit integer to [0,1) */
+static const double qmc_scale = 1.0 / 4294967296.0;
+
+static void sobol_directions(uint32_t v[32], int dim)
+{
+   const sobol_init *si;
+   int k, j;
+
+   if (dim == 0)
+   {
+      /* van der Corput sequence */
+      for (k = 0; k < 32; k++)
+         v[k] = 1U << (31 - k);
+      return;
+   }
+
+   si = &s_sobol[dim-1];
+   for (k = 0; k < si->s; k++)
+      v[k] = si->m[k] << (31 - k);
+
+   /* Recurrence of the primitive polynomial */
+   for (k = si->s; k < 32; k++)
+   {
+      uint32_t x = v[k - si->s] ^ (v[k - si->s] >> si->s);
+
+      for (j = 1; j < si->s; j++)
+         if ((si->a >> (si->s - 1 - j)) & 1)
+            x ^= v[k - j];
+      v[k] = x;
+   }
+}
+
+static uint32_t reverse_bits(uint32_t x)
+{
+   x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+   x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+   x = ((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);
+   x = ((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);
+   return (x >> 16) | (x << 16);
+}
+
+/* Nested uniform (Owen) scrambling by hashing, after B. Burley (2020) */
+/**
+ ** With the bits reversed, each bit of the hash only depends on the less
+ ** significant ones, which is the tree of random flips of Owen's scrambling.
+ **/
+static uint32_t owen_scramble(uint32_t x, uint32_t seed)
+{
+   x = reverse_bits(x);
+   x += seed;
+   x ^= x * 0x6c50b47cU;
+   x ^= x * 0xb82f1e52U;
+   x ^= x * 0xc7afe638U;
+   x ^= x * 0x8d22f6e6U;
+   return reverse_bits(x);
+}
+
+int qmc_init(qmc_view *qmc, uint64_t seed, uint64_t stream, int dim0, int dims)
+{
+   uint32_t key[2];
+   uint32_t ctr[4];
+   uint32_t out[4];
+   int      d;
+
+   if ((NULL == qmc) || (dim0 < 0) || (dims < 1) || (dim0 + dims > QMC_MAX_DIM))
+      return -1;
+
+   memset(qmc, 0, sizeof(qmc_view));
+   qmc->dim0 = dim0;
+   qmc->dims = dims;
+
+   key[0] = (uint32_t)seed;
+   key[1] = (uint32_t)(seed >> 32);
+
+   for (d = 0; d < dims; d++)
+   {
+      /* Scrambling seed depends on the absolute dimension only, so that
+         all views of one (seed, stream) agree */
+      ctr[0] = (uint32_t)(dim0 + d);
+      ctr[1] = 0x51AB1E;
+      ctr[2] = (uint32_t)stream;
+      ctr[3] = (uint32_t)(stream >> 32);
+      rng_philox4x32(out, ctr, key);
+
+      qmc->seed[d] = out[0];
+      sobol_directions(qmc->v[d], dim0 + d);
+   }
+
+   return 0;
+}
+
+double qmc_next(qmc_view *qmc)
+{
+   double u = (double)owen_scramble(qmc->x[qmc->d], qmc->seed[qmc->d]) * qmc_scale;
+
+   if (++qmc->d == qmc->dims)
+   {
+      /* Gray code step: Flip the direction number of the lowest zero bit */
+      uint32_t c = 0;
+      uint32_t i = qmc->index;
+      int      d;
+
+      while (i & 1)
+      {
+         i >>= 1;
+         ++c;
+      }
+      for (d = 0; d < qmc->dims; d++)
+         qmc->x[d] ^= qmc->v[d][c];
+
+      ++qmc->index;
+      qmc->d = 0;
+   }
+
+   return u;
+}
+
+double qmc_feed(void *qmc)
+{
+   return qmc_next((qmc_view*)qmc);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rng/rng.h"
+
+/* Constants */
+const uint64_t rng_default_seed = 0x1234ABCD330EULL;
+
+/* Multipliers and key increments (Weyl sequence) of Philox4x32 */
+static const uint32_t philox_m0 = 0xD2511F53U;
+static const uint32_t philox_m1 = 0xCD9E8D57U;
+static const uint32_t philox_w0 = 0x9E3779B9U;
+static const uint32_t philox_w1 = 0xBB67AE85U;
+
+/* Scale 53 bit integer to [0,1) */
+static const double rng_scale = 1.0 / 9007199254740992.0;
+
+void rng_philox4x32(uint32_t out[4], const uint32_t ctr[4], const uint32_t key[2])
+{
+   int      r;
+   uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+   uint32_t k0 = key[0], k1 = key[1];
+
+   for (r = 0; r < 10; ++r)
+   {
+      uint64_t p0 = (uint64_t)philox_m0 * c0;
+      uint64_t p1 = (uint64_t)philox_m1 * c2;
+
+      /* Key is bumped before every round but the first */
+      if (r > 0)
+      {
+         k0 += philox_w0;
+         k1 += philox_w1;
+      }
+
+      c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+      c1 = (uint32_t)p1;
+      c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+      c3 = (uint32_t)p0;
+   }
+
+   out[0] = c0;
+   out[1] = c1;
+   out[2] = c2;
+   out[3] = c3;
+}
+
+static void rng_fill(rng_stream *rng)
+{
+   uint32_t ctr[4];
+
+   /* Counter = (block, stream) */
+   ctr[0] = (uint32_t)rng->block;
+   ctr[1] = (uint32_t)(rng->block >> 32);
+   ctr[2] = (uint32_t)rng->stream;
+   ctr[3] = (uint32_t)(rng->stream >> 32);
+
+   rng_philox4x32(rng->buf, ctr, rng->key);
+
+   ++rng->block;
+   rng->idx = 0;
+}
+
+void rng_seed(rng_stream *rng, uint64_t seed, uint64_t stream)
+{
+   if (NULL == rng)
+      return;
+
+   rng->key[0] = (uint32_t)seed;
+   rng->key[1] = (uint32_t)(seed >> 32);
+   rng->stream = stream;
+   rng->block = 0;
+   rng->idx = 2;
+   rng->feed = NULL;
+   rng->src = NULL;
+}
+
+uint64_t rng_position(const rng_stream *rng)
+{
+   /* Two values per generated block, minus the ones still waiting in the buffer */
+   return 2*rng->block - (uint64_t)(2 - rng->idx);
+}
+
+void rng_skip(rng_stream *rng, uint64_t n)
+{
+   uint64_t pos = rng_position(rng) + n;
+
+   rng->block = pos / 2;
+   rng->idx = 2;
+
+   /* Odd position: The first half of the block is already used */
+   if (pos & 1)
+   {
+      rng_fill(rng);
+      rng->idx = 1;
+   }
+}
+
+static double rng_to_double(uint32_t hi, uint32_t lo)
+{
+   uint64_t bits = ((uint64_t)hi << 32) | lo;
+
+   return (double)(bits >> 11) * rng_scale;
+}
+
+double rng_uniform(rng_stream *rng)
+{
+   double u;
+
+   if (NULL != rng->feed)
+      return (rng->feed)(rng->src);
+
+   if (rng->idx >= 2)
+      rng_fill(rng);
+
+   u = rng_to_double(rng->buf[2*rng->idx], rng->buf[2*rng->idx + 1]);
+   ++rng->idx;
+
+   return u;
+}
+
+void rng_uniform_n(rng_stream *rng, int n, double *out)
+{
+   int i = 0;
+
+   if (NULL != rng->feed)
+   {
+      for (; i < n; i++)
+         out[i] = (rng->feed)(rng->src);
+      return;
+   }
+
+   /* Use up a half consumed block */
+   if ((n > 0) && (rng->idx == 1))
+      out[i++] = rng_uniform(rng);
+
+   /* Whole blocks */
+   for (; i+1 < n; i += 2)
+   {
+      rng_fill(rng);
+      out[i] = rng_to_double(rng->buf[0], rng->buf[1]);
+      out[i+1] = rng_to_double(rng->buf[2], rng->buf[3]);
+      rng->idx = 2;
+   }
+
+   /* Odd remainder */
+   if (i < n)
+      out[i] = rng_uniform(rng);
+}
@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vector/vector.h"
+#include "geometry/geometry.h"
+#include "scene/scene.h"
+
+/* Most volumes in a leaf of the hierarchy */
+#define SCENE_LEAF 2
+
+/* Depth of the traversal stack: Enough for any median split tree */
+#define SCENE_STACK 64
+
+/* Kinds of volumes */
+#define SCENE_RECT 0
+#define SCENE_BOX  1
+
+/* A volume with its axis aligned bounds */
+typedef struct scene_vol
+{
+   int    id;
+   int    kind;
+   double lo[3];
+   double hi[3];
+   union
+   {
+      g_rect_prepared rect;
+      g_box_prepared  box;
+   } shape;
+} scene_vol;
+
+/* A node of the hierarchy: Leaves hold 'count' > 0 volumes from 'first'
+   in 'order', inner nodes have their left child next to them and the
+   right one at 'first' */
+typedef struct scene_node
+{
+   double lo[3];
+   double hi[3];
+   int    first;
+   int    count;
+} scene_node;
+
+typedef struct scene_context
+{
+   scene_vol  *vol;
+   int         num;
+   int         cap;
+   int        *order;
+   scene_node *node;
+   int         num_node;
+   int         built;
+} scct;
+
+scene_ctx scene_init(void)
+{
+   scct *sc = malloc(sizeof(scct));
+
+   if (NULL != sc)
+      memset(sc, 0, sizeof(scct));
+   return (scene_ctx)sc;
+}
+
+void scene_delete(scene_ctx ctx)
+{
+   scct *sc = (scct*)ctx;
+
+   if (NULL == sc)
+      return;
+
+   free(sc->vol);
+   free(sc->order);
+   free(sc->node);
+   free(sc);
+}
+
+int scene_num(scene_ctx ctx)
+{
+   return ((scct*)ctx)->num;
+}
+
+/* Next free volume, NULL on failure */
+static scene_vol *scene_new_vol(scct *sc, int id, int kind)
+{
+   scene_vol *v;
+
+   if (sc->num == sc->cap)
+   {
+      int        cap = (sc->cap > 0) ? 2*sc->cap : 16;
+      scene_vol *vol = realloc(sc->vol, sizeof(scene_vol)*cap);
+
+      if (NULL == vol)
+         return NULL;
+      sc->vol = vol;
+      sc->cap = cap;
+   }
+
+   v = &sc->vol[sc->num];
+   v->id = id;
+   v->kind = kind;
+   sc->built = 0;
+   return v;
+}
+
+/* Bounds of a center with edges 'e[n]' of half lengths 'len[n]', padded a
+   little so that round off never loses a crossing */
+static void scene_bounds(scene_vol *v, const vec3 center,
+                         const vec3 *e, const double *len, int num_e)
+{
+   int a, n;
+
+   for (a = 0; a < 3; a++)
+   {
+      double ext = 0.0;
+      double pad;
+
+      for (n = 0; n < num_e; n++)
+         ext += fabs(e[n][a]) * len[n];
+      pad = 1.0E-9 * (1.0 + ext + fabs(center[a]));
+      v->lo[a] = center[a] - ext - pad;
+      v->hi[a] = center[a] + ext + pad;
+   }
+}
+
+int scene_add_rect(scene_ctx ctx, int id, const g_rectangle *rectangle)
+{
+   scct      *sc = (scct*)ctx;
+   scene_vol *v = scene_new_vol(sc, id, SCENE_RECT);
+
+   if (NULL == v)
+      return -1;
+
+   prepare_rect(&v->shape.rect, rectangle);
+   scene_bounds(v, rectangle->origin, v->shape.rect.edge, v->shape.rect.len, 2);
+   return sc->num++;
+}
+
+int scene_add_box(scene_ctx ctx, int id, const g_box *box)
+{
+   scct      *sc = (scct*)ctx;
+   scene_vol *v = scene_new_vol(sc, id, SCENE_BOX);
+
+   if (NULL == v)
+      return -1;
+
+   prepare_box(&v->shape.box, box);
+   scene_bounds(v, box->origin, v->shape.box.axis, v->shape.box.len, 3);
+   return sc->num++;
+}
+
+/* Center of a volume along axis 'a' (twice the value: Only compared) */
+static double scene_center(const scct *sc, int i, int a)
+{
+   return sc->vol[i].lo[a] + sc->vol[i].hi[a];
+}
+
+/* Reorder 'order[first..last]' so that the element 'k' is in its sorted place
+   along axis 'a', with no larger ones before and no smaller ones after it */
+static void scene_select(scct *sc, int first, int last, int k, int a)
+{
+   int *o = sc->order;
+
+   while (first < last)
+   {
+      double pivot = scene_center(sc, o[(first + last) / 2], a);
+      int    i = first;
+      int    j = last;
+
+      while (i <= j)
+      {
+         while (scene_center(sc, o[i], a) < pivot)
+            i++;
+         while (scene_center(sc, o[j], a) > pivot)
+            j--;
+         if (i <= j)
+         {
+            int t = o[i];
+
+            o[i++] = o[j];
+            o[j--] = t;
+         }
+      }
+
+      if (k <= j)
+         last = j;
+      else if (k >= i)
+         first = i;
+      else
+         return;
+   }
+}
+
+/* Node over the volumes 'first' to 'first+count-1' of 'order', and its subtree.
+   Splits at the median of the centers along the axis of their largest spread */
+static void scene_build_node(scct *sc, int first, int count)
+{
+   scene_node *nd = &sc->node[sc->num_node++];
+   double      c_lo[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+   double      c_hi[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+   int         i, a, axis, half;
+
+   for (a = 0; a < 3; a++)
+   {
+      nd->lo[a] = HUGE_VAL;
+      nd->hi[a] = -HUGE_VAL;
+   }
+   for (i = first; i < first + count; i++)
+   {
+      const scene_vol *v = &sc->vol[sc->order[i]];
+
+      for (a = 0; a < 3; a++)
+      {
+         double c = v->lo[a] + v->hi[a];
+
+         nd->lo[a] = fmin(nd->lo[a], v->lo[a]);
+         nd->hi[a] = fmax(nd->hi[a], v->hi[a]);
+         c_lo[a] = fmin(c_lo[a], c);
+         c_hi[a] = fmax(c_hi[a], c);
+      }
+   }
+
+   if (count <= SCENE_LEAF)
+   {
+      nd->first = first;
+      nd->count = count;
+      return;
+   }
+
+   axis = 0;
+   for (a = 1; a < 3; a++)
+      if (c_hi[a] - c_lo[a] > c_hi[axis] - c_lo[axis])
+         axis = a;
+
+   half = count / 2;
+   scene_select(sc, first, first + count - 1, first + half, axis);
+   nd->count = 0;
+   scene_build_node(sc, first, half);
+   nd->first = sc->num_node;
+   scene_build_node(sc, first + half, count - half);
+}
+
+int scene_build(scene_ctx ctx)
+{
+   scct *sc = (scct*)ctx;
+   int   i;
+
+   free(sc->order);
+   free(sc->node);
+   sc->order = NULL;
+   sc->node = NULL;
+   sc->num_node = 0;
+   sc->built = 0;
+
+   if (sc->num == 0)
+   {
+      sc->built = 1;
+      return 0;
+   }
+
+   /* A binary tree with leaves of at least one volume */
+   sc->order = malloc(sizeof(int)*sc->num);
+   sc->node = malloc(sizeof(scene_node)*(2*sc->num - 1));
+   if ((NULL == sc->order) || (NULL == sc->node))
+      return -1;
+
+   for (i = 0; i < sc->num; i++)
+      sc->order[i] = i;
+   scene_build_node(sc, 0, sc->num);
+
+   sc->built = 1;
+   return 0;
+}
+
+/* Does the line cross the bounds between 't_min' and 't_max'? Where it enters
+   them is stored in 'entry' (if not NULL) */
+static int scene_cross_bounds(const scene_node *nd, const g_ray *ray, const double inv[3],
+                              double t_min, double t_max, double *entry)
+{
+   double t_near = t_min;
+   double t_far = t_max;
+   int    a;
+
+   for (a = 0; a < 3; a++)
+   {
+      double t_lo, t_hi;
+
+      if (ray->direction[a] == 0.0)
+      {
+         if ((ray->origin[a] < nd->lo[a]) || (ray->origin[a] > nd->hi[a]))
+            return 0;
+         continue;
+      }
+
+      t_lo = (nd->lo[a] - ray->origin[a]) * inv[a];
+      t_hi = (nd->hi[a] - ray->origin[a]) * inv[a];
+      if (t_lo > t_hi)
+      {
+         double t = t_lo;
+
+         t_lo = t_hi;
+         t_hi = t;
+      }
+      t_near = fmax(t_near, t_lo);
+      t_far = fmin(t_far, t_hi);
+   }
+
+   if (NULL != entry)
+      *entry = t_near;
+   return t_near <= t_far;
+}
+
+/* Does the line cross the volume? Its entry and exit go into 'h' */
+static int scene_cross_vol(const scene_vol *v, const g_ray *ray, scene_hit *h)
+{
+   h->id = v->id;
+   if (v->kind == SCENE_RECT)
+   {
+      double l1, l2;
+
+      if ((0 != intersect_rect_prepared(ray, &v->shape.rect, &h->translation[0],
+                                        &h->hit, &l1, &l2)) || (0 == h->hit))
+         return 0;
+      h->translation[1] = h->translation[0];
+   }
+   else
+   {
+      double t[2], l1[2], l2[2], l3[2];
+
+      if ((0 != intersect_box_prepared(ray, &v->shape.box, t, &h->hit, l1, l2, l3))
+          || (2 != h->hit))
+         return 0;
+      h->translation[0] = fmin(t[0], t[1]);
+      h->translation[1] = fmax(t[0], t[1]);
+   }
+
+   return 1;
+}
+
+/* Store a crossed volume in path order, keeping the first 'max_hits' */
+static void scene_store(scene_hit *hits, int num, int max_hits, const scene_hit *h)
+{
+   int i = (num < max_hits) ? num : max_hits;
+
+   if ((i == max_hits) && ((i == 0) || (hits[i-1].translation[0] <= h->translation[0])))
+      return;
+   if (i == max_hits)
+      --i;
+
+   while ((i > 0) && (hits[i-1].translation[0] > h->translation[0]))
+   {
+      hits[i] = hits[i-1];
+      --i;
+   }
+   hits[i] = *h;
+}
+
+int scene_intersect(scene_ctx ctx, const g_ray *ray,
+                    scene_hit *hits, int max_hits)
+{
+   const scct *sc = (const scct*)ctx;
+   int         stack[SCENE_STACK];
+   int         top = 0;
+   int         num = 0;
+   double      inv[3];
+   int         a;
+
+   if (!sc->built)
+      return -1;
+   if (sc->num == 0)
+      return 0;
+
+   for (a = 0; a < 3; a++)
+      inv[a] = 1.0 / ray->direction[a];
+
+   stack[top++] = 0;
+   while (top > 0)
+   {
+      const scene_node *nd = &sc->node[stack[--top]];
+      int               i;
+
+      if (!scene_cross_bounds(nd, ray, inv, -HUGE_VAL, HUGE_VAL, NULL))
+         continue;
+
+      if (nd->count == 0)
+      {
+         /* Left child next to its parent */
+         stack[top++] = nd->first;
+         stack[top++] = (int)(nd - sc->node) + 1;
+         continue;
+      }
+
+      for (i = nd->first; i < nd->first + nd->count; i++)
+      {
+         scene_hit h;
+
+         if (!scene_cross_vol(&sc->vol[sc->order[i]], ray, &h))
+            continue;
+
+         scene_store(hits, num, max_hits, &h);
+         ++num;
+      }
+   }
+
+   return num;
+}
+
+void scene_segments_free(scene_segments *segs)
+{
+   free(segs->seg);
+   segs->seg = NULL;
+   segs->num = 0;
+   segs->cap = 0;
+}
+
+/* Append a segment in path order. The buffer only grows, so it stops
+   allocating once it is large enough for the busiest ray */
+static int scene_push(scene_segments *segs, const scene_hit *h)
+{
+   int i;
+
+   if (segs->num == segs->cap)
+   {
+      int        cap = (segs->cap > 0) ? 2*segs->cap : 16;
+      scene_hit *seg = realloc(segs->seg, sizeof(scene_hit)*cap);
+
+      if (NULL == seg)
+         return -1;
+      segs->seg = seg;
+      segs->cap = cap;
+   }
+
+   /* Mostly at the end: The nodes are visited front to back */
+   i = segs->num++;
+   while ((i > 0) && (segs->seg[i-1].translation[0] > h->translation[0]))
+   {
+      segs->seg[i] = segs->seg[i-1];
+      --i;
+   }
+   segs->seg[i] = *h;
+   return 0;
+}
+
+int scene_segment(scene_ctx ctx, const g_ray *ray, double t_min, double t_max,
+                  scene_segments *segs)
+{
+   const scct *sc = (const scct*)ctx;
+   int         stack[SCENE_STACK];
+   int         top = 0;
+   double      inv[3];
+   int         a;
+
+   segs->num = 0;
+   if (!sc->built)
+      return -1;
+   if ((sc->num == 0) || (t_min > t_max))
+      return 0;
+
+   for (a = 0; a < 3; a++)
+      inv[a] = 1.0 / ray->direction[a];
+
+   if (!scene_cross_bounds(&sc->node[0], ray, inv, t_min, t_max, NULL))
+      return 0;
+
+   stack[top++] = 0;
+   while (top > 0)
+   {
+      const scene_node *nd = &sc->node[stack[--top]];
+      int               i;
+
+      if (nd->count == 0)
+      {
+         /* Children that the range of the ray crosses, the nearer one on top */
+         int    left = (int)(nd - sc->node) + 1;
+         int    right = nd->first;
+         double e_l, e_r;
+         int    in_l = scene_cross_bounds(&sc->node[left], ray, inv, t_min, t_max, &e_l);
+         int    in_r = scene_cross_bounds(&sc->node[right], ray, inv, t_min, t_max, &e_r);
+
+         if (in_l && in_r && (e_l <= e_r))
+         {
+            stack[top++] = right;
+            stack[top++] = left;
+         }
+         else
+         {
+            if (in_l)
+               stack[top++] = left;
+            if (in_r)
+               stack[top++] = right;
+         }
+         continue;
+      }
+
+      for (i = nd->first; i < nd->first + nd->count; i++)
+      {
+         scene_hit h;
+
+         if (!scene_cross_vol(&sc->vol[sc->order[i]], ray, &h))
+            continue;
+
+         /* Only the part inside of the range */
+         if ((h.translation[1] < t_min) || (h.translation[0] > t_max))
+            continue;
+         h.translation[0] = fmax(h.translation[0], t_min);
+         h.translation[1] = fmin(h.translation[1], t_max);
+
+         if (0 != scene_push(segs, &h))
+            return -1;
+      }
+   }
+
+   return segs->num;
+}
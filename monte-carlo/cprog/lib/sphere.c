@@ -19,8 +19,12 @@
 
 #include "pdg/pdg.h"
 #include "vector/vector.h"
+#include "vmath/vmath.h"
 #include "sphere/sphere.h"
 
+/* Number of azimuth values handled at once */
+#define OMEGA_CHUNK 64
+
 /* Constants */
 const double pi = 3.14159265358979323846;
 
@@ -45,3 +49,26 @@ double val_omega(double th, double phi, const vec3 N, int flux,
    /* Return */
    return j_val(flux, th, phi) * fabs(r_vis) * delO;
 }
+
+void val_omega_n(double th, int n, const double *phi, const vec3 N, int flux,
+                 double delTh, double delPhi, double *out)
+{
+   double c[OMEGA_CHUNK], s[OMEGA_CHUNK];
+   double sin_t = sin(th);
+   double cos_t = cos(th);
+   double delO = sin_t * delTh * delPhi;
+   int    i, j, m;
+
+   for (i = 0; i < n; i += m)
+   {
+      m = (n - i < OMEGA_CHUNK) ? n - i : OMEGA_CHUNK;
+      vmath_sincos(m, phi + i, s, c);
+
+      for (j = 0; j < m; j++)
+      {
+         double r_vis = N[x_c]*c[j]*sin_t + N[y_c]*s[j]*sin_t + N[z_c]*cos_t;
+
+         out[i+j] = j_val(flux, th, phi[i+j]) * fabs(r_vis) * delO;
+      }
+   }
+}
@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rng/rng.h"
+#include "gun/gun.h"
+#include "strata/strata.h"
+
+struct strata_context;
+
+/* Position of a gun in the events of a pass */
+/**
+ ** 'dim0', 'dims' : Dimensions fed to the gun.
+ ** 'd'            : Next dimension of the current event, relative to 'dim0'.
+ ** 'h', 'pos'     : Stratum of the current event and its index in the stratum.
+ ** 'j'            : Index of the current event in the pass.
+ **/
+typedef struct strata_view
+{
+   struct strata_context *st;
+   int      dim0;
+   int      dims;
+   int      d;
+   int      h;
+   int      pos;
+   uint64_t j;
+} strata_view;
+
+typedef struct strata_context
+{
+   int      dims;
+   int      divs[STRATA_MAX_DIM];
+   int      stride[STRATA_MAX_DIM];
+   int      num;
+   int      lhs;
+   uint32_t key[2];
+   uint32_t pass;
+   /* Events of each stratum in the current pass */
+   int     *alloc;
+   /* Tallied values of each stratum over all passes, for the allocation */
+   double  *cnt;
+   double  *sum;
+   double  *sum2;
+   /* Tallied values of each stratum in the current pass */
+   double  *p_cnt;
+   double  *p_sum;
+   double  *p_sum2;
+   /* Estimates of the finished passes, weighted by their events */
+   double   est_n;
+   double   est_sum;
+   double   est_var;
+   /* Stratum and index of the next tallied event */
+   int      t_h;
+   int      t_pos;
+   int      num_views;
+   strata_view view[STRATA_MAX_GUNS];
+} sct;
+
+/* Scale 53 bit integer to [0,1) and the largest double below 1 */
+static const double strata_scale = 1.0 / 9007199254740992.0;
+static const double strata_below_1 = 1.0 - 1.0 / 9007199254740992.0;
+
+/* Share of the events that Neyman allocation still spreads evenly */
+static const double strata_defensive = 0.25;
+
+/* Counter word marking the random permutations of Latin hypercubes */
+static const uint32_t strata_lhs_tag = 0x1A7E5;
+
+/* Random permutation of 0 ... l-1 without a table, after A. Kensler (2013) */
+static uint32_t permute(uint32_t i, uint32_t l, uint32_t p)
+{
+   uint32_t w = l - 1;
+
+   w |= w >> 1;
+   w |= w >> 2;
+   w |= w >> 4;
+   w |= w >> 8;
+   w |= w >> 16;
+
+   /* Cycle walking: Repeat the hash of the power of 2 range until inside */
+   do
+   {
+      i ^= p;
+      i *= 0xe170893dU;
+      i ^= p >> 16;
+      i ^= (i & w) >> 4;
+      i ^= p >> 8;
+      i *= 0x0929eb3fU;
+      i ^= p >> 23;
+      i ^= (i & w) >> 1;
+      i *= 1 | p >> 27;
+      i *= 0x6935fa69U;
+      i ^= (i & w) >> 11;
+      i *= 0x74dcb303U;
+      i ^= (i & w) >> 2;
+      i *= 0x9e501cc3U;
+      i ^= (i & w) >> 2;
+      i *= 0xc860a3dfU;
+      i &= w;
+      i ^= i >> 5;
+   } while (i >= l);
+
+   return (i + p) % l;
+}
+
+/* Move to the next event of the pass, skipping strata without events */
+static void strata_step(const sct *st, int *h, int *pos)
+{
+   ++(*pos);
+   while ((*h < st->num) && (*pos >= st->alloc[*h]))
+   {
+      ++(*h);
+      *pos = 0;
+   }
+}
+
+/* Uniform value of dimension 'dim' for the current event of a view */
+static double strata_value(const sct *st, const strata_view *v, int dim)
+{
+   uint32_t ctr[4];
+   uint32_t out[4];
+   double   u, x;
+   int      cell;
+
+   /* Counter = (event, dimension, pass) */
+   ctr[0] = (uint32_t)v->j;
+   ctr[1] = (uint32_t)(v->j >> 32);
+   ctr[2] = (uint32_t)dim;
+   ctr[3] = st->pass;
+   rng_philox4x32(out, ctr, st->key);
+   u = (double)((((uint64_t)out[0] << 32) | out[1]) >> 11) * strata_scale;
+
+   /* Events beyond the pass are not stratified */
+   if (v->h >= st->num)
+      return u;
+
+   if (st->lhs && (st->alloc[v->h] > 1))
+   {
+      /* Same permutation for all events of the stratum */
+      ctr[0] = (uint32_t)v->h;
+      ctr[1] = strata_lhs_tag;
+      rng_philox4x32(out, ctr, st->key);
+
+      u = ((double)permute((uint32_t)v->pos, (uint32_t)st->alloc[v->h], out[0]) + u) /
+         (double)st->alloc[v->h];
+   }
+
+   cell = (v->h / st->stride[dim]) % st->divs[dim];
+   x = ((double)cell + u) / (double)st->divs[dim];
+
+   return (x < 1.0) ? x : strata_below_1;
+}
+
+static double strata_feed(void *src)
+{
+   strata_view *v = (strata_view*)src;
+   double u = strata_value(v->st, v, v->dim0 + v->d);
+
+   if (++v->d == v->dims)
+   {
+      v->d = 0;
+      ++v->j;
+      strata_step(v->st, &v->h, &v->pos);
+   }
+
+   return u;
+}
+
+strata_ctx strata_init(int dims, const int *divs, int lhs, uint64_t seed)
+{
+   sct *st;
+   int  d, num = 1;
+
+   if ((dims < 1) || (dims > STRATA_MAX_DIM) || (NULL == divs))
+      return NULL;
+
+   for (d = 0; d < dims; d++)
+   {
+      if ((divs[d] < 1) || (num > INT32_MAX / divs[d]))
+         return NULL;
+      num *= divs[d];
+   }
+
+   st = malloc(sizeof(sct));
+   memset(st, 0, sizeof(sct));
+
+   /* Index of the stratum: Dimension 0 runs fastest */
+   st->dims = dims;
+   st->num = num;
+   for (d = 0, num = 1; d < dims; d++)
+   {
+      st->divs[d] = divs[d];
+      st->stride[d] = num;
+      num *= divs[d];
+   }
+
+   st->lhs = lhs;
+   st->key[0] = (uint32_t)seed;
+   st->key[1] = (uint32_t)(seed >> 32);
+
+   st->alloc = calloc(st->num, sizeof(int));
+   st->cnt = calloc(st->num, sizeof(double));
+   st->sum = calloc(st->num, sizeof(double));
+   st->sum2 = calloc(st->num, sizeof(double));
+   st->p_cnt = calloc(st->num, sizeof(double));
+   st->p_sum = calloc(st->num, sizeof(double));
+   st->p_sum2 = calloc(st->num, sizeof(double));
+
+   /* No pass planned yet */
+   st->t_h = st->num;
+   return (strata_ctx)st;
+}
+
+void strata_delete(strata_ctx ctx)
+{
+   sct *st = (sct*)ctx;
+
+   if (NULL == st)
+      return;
+
+   free(st->alloc);
+   free(st->cnt);
+   free(st->sum);
+   free(st->sum2);
+   free(st->p_cnt);
+   free(st->p_sum);
+   free(st->p_sum2);
+   free(st);
+}
+
+int strata_num(strata_ctx ctx)
+{
+   sct *st = (sct*)ctx;
+
+   if (NULL == st)
+      return -1;
+
+   return st->num;
+}
+
+int strata_attach(strata_ctx ctx, gun_ctx gt, int dim0)
+{
+   sct *st = (sct*)ctx;
+   strata_view *v;
+   int draws = gun_draws(gt);
+
+   if ((NULL == st) || (draws < 1) || (dim0 < 0) || (dim0 + draws > st->dims) ||
+       (st->num_views == STRATA_MAX_GUNS))
+      return -1;
+
+   v = &st->view[st->num_views++];
+   v->st = st;
+   v->dim0 = dim0;
+   v->dims = draws;
+   v->h = st->num;
+
+   if (0 != gun_feed(gt, strata_feed, v))
+      return -1;
+
+   return dim0 + draws;
+}
+
+/* Sample variance of 'cnt' values with sum 'sum' and sum of squares 'sum2' */
+static double strata_var(double cnt, double sum, double sum2)
+{
+   double var;
+
+   if (cnt < 2.0)
+      return 0.0;
+
+   var = (sum2 - sum*sum/cnt) / (cnt - 1.0);
+   return (var > 0.0) ? var : 0.0;
+}
+
+/* Stratified estimate of the current pass, and the number of its events */
+static int strata_pass(const sct *st, double *mean, double *var, double *n)
+{
+   int h;
+
+   *mean = 0.0;
+   *var = 0.0;
+   *n = 0.0;
+
+   /* Strata of equal volume 1/num */
+   for (h = 0; h < st->num; h++)
+   {
+      if (st->p_cnt[h] < 1.0)
+         return -1;
+
+      *mean += st->p_sum[h] / st->p_cnt[h];
+      *var += strata_var(st->p_cnt[h], st->p_sum[h], st->p_sum2[h]) / st->p_cnt[h];
+      *n += st->p_cnt[h];
+   }
+
+   *mean /= (double)st->num;
+   *var /= (double)st->num * (double)st->num;
+   return 0;
+}
+
+int strata_plan(strata_ctx ctx, int n, int neyman)
+{
+   sct *st = (sct*)ctx;
+   double w_tot = 0.0;
+   int h, i, rest;
+
+   if ((NULL == st) || (n / 2 < st->num))
+      return -1;
+
+   /* Keep the estimate of the finished pass */
+   if (st->pass > 0)
+   {
+      double mean, var, m;
+
+      if (0 == strata_pass(st, &mean, &var, &m))
+      {
+         st->est_n += m;
+         st->est_sum += m * mean;
+         st->est_var += m * m * var;
+      }
+      memset(st->p_cnt, 0, st->num*sizeof(double));
+      memset(st->p_sum, 0, st->num*sizeof(double));
+      memset(st->p_sum2, 0, st->num*sizeof(double));
+   }
+
+   if (neyman)
+   {
+      for (h = 0; h < st->num; h++)
+         w_tot += sqrt(strata_var(st->cnt[h], st->sum[h], st->sum2[h]));
+   }
+
+   if (w_tot > 0.0)
+   {
+      /* Neyman: Equal volumes, so the events follow the standard deviations.
+         Strata that looked constant so far still get an even share, as their
+         variance may just not have shown up (e.g. rare hits) */
+      double spare = (double)(n - 2*st->num);
+
+      for (h = 0; h < st->num; h++)
+      {
+         double w = sqrt(strata_var(st->cnt[h], st->sum[h], st->sum2[h])) / w_tot;
+
+         w = strata_defensive / (double)st->num + (1.0 - strata_defensive) * w;
+         st->alloc[h] = 2 + (int)floor(spare * w);
+      }
+   }
+   else
+   {
+      for (h = 0; h < st->num; h++)
+         st->alloc[h] = n / st->num;
+   }
+
+   /* Round off: One more event for the first strata */
+   for (h = 0, rest = n; h < st->num; h++)
+      rest -= st->alloc[h];
+   for (h = 0; rest > 0; h = (h + 1) % st->num, rest--)
+      ++st->alloc[h];
+
+   /* Start all views and the tally at the first event of the new pass */
+   ++st->pass;
+   for (i = 0; i < st->num_views; i++)
+   {
+      strata_view *v = &st->view[i];
+
+      v->d = 0;
+      v->j = 0;
+      v->h = 0;
+      v->pos = -1;
+      strata_step(st, &v->h, &v->pos);
+   }
+   st->t_h = 0;
+   st->t_pos = -1;
+   strata_step(st, &st->t_h, &st->t_pos);
+
+   return 0;
+}
+
+int strata_tally(strata_ctx ctx, double value)
+{
+   sct *st = (sct*)ctx;
+
+   if ((NULL == st) || (st->t_h >= st->num))
+      return -1;
+
+   st->cnt[st->t_h] += 1.0;
+   st->sum[st->t_h] += value;
+   st->sum2[st->t_h] += value*value;
+   st->p_cnt[st->t_h] += 1.0;
+   st->p_sum[st->t_h] += value;
+   st->p_sum2[st->t_h] += value*value;
+
+   strata_step(st, &st->t_h, &st->t_pos);
+   return 0;
+}
+
+int strata_estimate(strata_ctx ctx, double *mean, double *err)
+{
+   sct *st = (sct*)ctx;
+   double m, var, n;
+   double e_n, e_sum, e_var;
+
+   if ((NULL == st) || (NULL == mean) || (NULL == err))
+      return -1;
+
+   /* Passes are combined by their number of events. The allocation of a pass
+      depends on the values before it, so pooling the values would bias the mean */
+   if (0 != strata_pass(st, &m, &var, &n))
+      return -1;
+
+   e_n = st->est_n + n;
+   e_sum = st->est_sum + n * m;
+   e_var = st->est_var + n * n * var;
+
+   *mean = e_sum / e_n;
+   *err = sqrt(e_var) / e_n;
+   return 0;
+}
@@ -29,6 +29,13 @@ void copy_vec(vec3 out, const vec3 in)
    out[2] = in[2];
 }
 
+void copy_vec_f(vec3f out, const vec3 in)
+{
+   out[0] = (float)in[0];
+   out[1] = (float)in[1];
+   out[2] = (float)in[2];
+}
+
 void scale_vec(vec3 v, double s)
 {
    v[0] = s*v[0];
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "vmath/vmath.h"
+
+/* Vector kernels for x86-64 need the GCC/Clang target attributes */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VMATH_X86 1
+#include <immintrin.h>
+#endif
+
+/* Bit patterns */
+static const int64_t vm_mant_mask = 0x000FFFFFFFFFFFFFLL;
+static const int64_t vm_one_bits = 0x3FF0000000000000LL;
+static const int64_t vm_magic_bits = 0x4330000000000000LL;
+static const int64_t vm_sign_bit = (int64_t)0x8000000000000000ULL;
+static const int64_t vm_high_mask = (int64_t)0xFFFFFFFF00000000ULL;
+
+/* 2^52, and 1.5*2^52 to round to integer */
+static const double vm_magic = 4503599627370496.0;
+static const double vm_magic_r = 6755399441055744.0;
+
+/* log: Coefficients after fdlibm (e_log.c) */
+static const double vm_sqrt2 = 1.41421356237309504880;
+static const double vm_ln2_hi = 6.93147180369123816490e-01;
+static const double vm_ln2_lo = 1.90821492927058770002e-10;
+static const double vm_lg1 = 6.666666666666735130e-01;
+static const double vm_lg2 = 3.999999999940941908e-01;
+static const double vm_lg3 = 2.857142874366239149e-01;
+static const double vm_lg4 = 2.222219843214978396e-01;
+static const double vm_lg5 = 1.818357216161805012e-01;
+static const double vm_lg6 = 1.531383769920937332e-01;
+static const double vm_lg7 = 1.479819860511658591e-01;
+
+/* cbrt: Least squares quadratic on [1,2) and cbrt(2^r) for r = 0, 1, 2 */
+static const double vm_cb0 = 0.6263622186128582;
+static const double vm_cb1 = 0.43355714863833006;
+static const double vm_cb2 = -0.05863558571346829;
+static const double vm_cbr1 = 0.2261415738056467;
+static const double vm_cbr2 = 0.03377947608922649;
+
+/* sincos: Reduction by pi/2 and kernels after fdlibm (k_sin.c, k_cos.c) */
+static const double vm_sincos_max = 1.0E5;
+static const double vm_2_pi = 6.36619772367581382433e-01;
+static const double vm_pio2_1 = 1.57079632673412561417e+00;
+static const double vm_pio2_2 = 6.07710050630396597660e-11;
+static const double vm_pio2_3 = 2.02226624879595063154e-21;
+static const double vm_s1 = -1.66666666666666324348e-01;
+static const double vm_s2 = 8.33333333332248946124e-03;
+static const double vm_s3 = -1.98412698298579493134e-04;
+static const double vm_s4 = 2.75573137070700676789e-06;
+static const double vm_s5 = -2.50507602534068634195e-08;
+static const double vm_s6 = 1.58969099521155010221e-10;
+static const double vm_c1 = 4.16666666666666019037e-02;
+static const double vm_c2 = -1.38888888888741095749e-03;
+static const double vm_c3 = 2.48015872894767294178e-05;
+static const double vm_c4 = -2.75573143513906633035e-07;
+static const double vm_c5 = 2.08757232129817482790e-09;
+static const double vm_c6 = -1.13596475577881948265e-11;
+
+/* acos: Rational approximation after fdlibm (e_acos.c) */
+static const double vm_pi = 3.14159265358979311600e+00;
+static const double vm_pio2_hi = 1.57079632679489655800e+00;
+static const double vm_pio2_lo = 6.12323399573676603587e-17;
+static const double vm_ps0 = 1.66666666666666657415e-01;
+static const double vm_ps1 = -3.25565818622400915405e-01;
+static const double vm_ps2 = 2.01212532134862925881e-01;
+static const double vm_ps3 = -4.00555345006794114027e-02;
+static const double vm_ps4 = 7.91534994289814532176e-04;
+static const double vm_ps5 = 3.47933107596021167570e-05;
+static const double vm_qs1 = -2.40339491173441421878e+00;
+static const double vm_qs2 = 2.02094576023350569471e+00;
+static const double vm_qs3 = -6.88283971605453293030e-01;
+static const double vm_qs4 = 7.70381505559019352791e-02;
+
+/* Scalar kernels: Vectors of one lane */
+#define VM_W 1
+#define VM_NAME(f) vm_##f##_scalar
+#define VM_ATTR
+#define VM_SQRT(v) ((vd){ sqrt((v)[0]) })
+#include "vmath_kernel.h"
+#undef VM_W
+#undef VM_NAME
+#undef VM_ATTR
+#undef VM_SQRT
+
+#ifdef VMATH_X86
+#define VM_W 4
+#define VM_NAME(f) vm_##f##_avx2
+#define VM_ATTR __attribute__((target("avx2,fma")))
+#define VM_SQRT(v) ((vd)_mm256_sqrt_pd((__m256d)(v)))
+#include "vmath_kernel.h"
+#undef VM_W
+#undef VM_NAME
+#undef VM_ATTR
+#undef VM_SQRT
+
+#define VM_W 8
+#define VM_NAME(f) vm_##f##_avx512
+#define VM_ATTR __attribute__((target("avx512f")))
+#define VM_SQRT(v) ((vd)_mm512_sqrt_pd((__m512d)(v)))
+#include "vmath_kernel.h"
+#undef VM_W
+#undef VM_NAME
+#undef VM_ATTR
+#undef VM_SQRT
+#endif
+
+/* The kernels of one instruction set */
+typedef struct vmath_set
+{
+   const char *name;
+   void (*log)(int n, const double *x, double *y);
+   void (*cbrt)(int n, const double *x, double *y);
+   void (*sincos)(int n, const double *x, double *s, double *c);
+   void (*acos)(int n, const double *x, double *y);
+} vmath_set;
+
+static const vmath_set vm_sets[] = {
+#ifdef VMATH_X86
+   { "avx512", vm_log_avx512, vm_cbrt_avx512, vm_sincos_avx512, vm_acos_avx512 },
+   { "avx2", vm_log_avx2, vm_cbrt_avx2, vm_sincos_avx2, vm_acos_avx2 },
+#endif
+   { "scalar", vm_log_scalar, vm_cbrt_scalar, vm_sincos_scalar, vm_acos_scalar },
+};
+
+static const int vm_num_sets = sizeof(vm_sets) / sizeof(vm_sets[0]);
+
+/* Kernel in use, chosen once on the first call of any thread */
+static const vmath_set *vm_set = NULL;
+static pthread_once_t vm_once = PTHREAD_ONCE_INIT;
+
+static int vm_supported(const vmath_set *set)
+{
+#ifdef VMATH_X86
+   if (0 == strcmp(set->name, "avx512"))
+      return __builtin_cpu_supports("avx512f");
+   if (0 == strcmp(set->name, "avx2"))
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+   return 1;
+}
+
+static void vm_choose(void)
+{
+   int i;
+
+#if defined(VMATH_KERNEL_AVX512) || defined(VMATH_KERNEL_AVX2) || defined(VMATH_KERNEL_SCALAR)
+   /* Fixed at build time */
+   for (i = 0; i < vm_num_sets; i++)
+   {
+#if defined(VMATH_KERNEL_AVX512)
+      if (0 == strcmp(vm_sets[i].name, "avx512"))
+#elif defined(VMATH_KERNEL_AVX2)
+      if (0 == strcmp(vm_sets[i].name, "avx2"))
+#else
+      if (0 == strcmp(vm_sets[i].name, "scalar"))
+#endif
+         vm_set = &vm_sets[i];
+   }
+
+   /* Built for a processor that is not this one: The scalar kernel runs anywhere */
+   if ((NULL != vm_set) && !vm_supported(vm_set))
+      vm_set = &vm_sets[vm_num_sets - 1];
+#endif
+
+   /* Widest kernel the processor runs, the scalar one comes last */
+   for (i = 0; (NULL == vm_set) && (i < vm_num_sets); i++)
+      if (vm_supported(&vm_sets[i]))
+         vm_set = &vm_sets[i];
+}
+
+static const vmath_set *vm_select(void)
+{
+   pthread_once(&vm_once, vm_choose);
+   return vm_set;
+}
+
+void vmath_log(int n, const double *x, double *y)
+{
+   (vm_select()->log)(n, x, y);
+}
+
+void vmath_cbrt(int n, const double *x, double *y)
+{
+   (vm_select()->cbrt)(n, x, y);
+}
+
+void vmath_sincos(int n, const double *x, double *s, double *c)
+{
+   (vm_select()->sincos)(n, x, s, c);
+}
+
+void vmath_acos(int n, const double *x, double *y)
+{
+   (vm_select()->acos)(n, x, y);
+}
+
+const char *vmath_kernel(void)
+{
+   return vm_select()->name;
+}
+
+int vmath_use(const char *name)
+{
+   int i;
+
+   /* The first choice must not come later and replace this one */
+   pthread_once(&vm_once, vm_choose);
+   for (i = 0; i < vm_num_sets; i++)
+      if ((0 == strcmp(vm_sets[i].name, name)) && vm_supported(&vm_sets[i]))
+      {
+         vm_set = &vm_sets[i];
+         return 0;
+      }
+
+   return -1;
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/**********************************************************/
+/* Kernels of 'vmath.c' for one vector width. Included    */
+/* once per instruction set, with these macros defined:   */
+/*   VM_W         : Number of lanes                       */
+/*   VM_NAME(f)   : Name of function 'f' for this width   */
+/*   VM_ATTR      : Function attributes (target ISA)      */
+/*   VM_SQRT(v)   : Square root of a vector               */
+/**********************************************************/
+
+typedef double  VM_NAME(vd) __attribute__((vector_size(8*VM_W)));
+typedef int64_t VM_NAME(vi) __attribute__((vector_size(8*VM_W)));
+
+#define vd VM_NAME(vd)
+#define vi VM_NAME(vi)
+
+/* Lanes of 'a' where 'm' is set, else lanes of 'b' */
+static inline VM_ATTR vd VM_NAME(blend)(vi m, vd a, vd b)
+{
+   return (vd)(((vi)a & m) | ((vi)b & ~m));
+}
+
+/* Load 'n' <= VM_W values, the missing lanes are set to 'pad' */
+static inline VM_ATTR vd VM_NAME(load)(const double *x, int n, double pad)
+{
+   vd  v = (vd){ 0 } + pad;
+   int l;
+
+   if (n == VM_W)
+   {
+      memcpy(&v, x, sizeof(vd));
+      return v;
+   }
+
+   for (l = 0; l < n; l++)
+      v[l] = x[l];
+   return v;
+}
+
+static inline VM_ATTR void VM_NAME(store)(double *y, vd v, int n)
+{
+   int l;
+
+   if (n == VM_W)
+   {
+      memcpy(y, &v, sizeof(vd));
+      return;
+   }
+
+   for (l = 0; l < n; l++)
+      y[l] = v[l];
+}
+
+/* Unbiased exponent (as double) and mantissa in [1,2) of positive normal 'x' */
+static inline VM_ATTR vd VM_NAME(frexp)(vd x, vd *m)
+{
+   vi bits = (vi)x;
+
+   *m = (vd)((bits & vm_mant_mask) | vm_one_bits);
+   return (vd)(((bits >> 52) & 0x7FF) | vm_magic_bits) - (vm_magic + 1023.0);
+}
+
+/* 2^q for integer valued 'q' within the normal range */
+static inline VM_ATTR vd VM_NAME(ldexp1)(vd q)
+{
+   vi k = (vi)(q + vm_magic_r) + 1023;
+
+   return (vd)(k << 52);
+}
+
+static inline VM_ATTR vd VM_NAME(log_v)(vd x)
+{
+   vd m, e, f, s, z, w, t1, t2, hfsq;
+   vi big;
+
+   e = VM_NAME(frexp)(x, &m);
+
+   /* Mantissa into [sqrt(1/2), sqrt(2)) */
+   big = (m > vm_sqrt2);
+   m = VM_NAME(blend)(big, m * 0.5, m);
+   e = e + VM_NAME(blend)(big, (vd){ 0 } + 1.0, (vd){ 0 });
+
+   /* log(1+f) = f - f^2/2 + s*(f^2/2 + R(s^2)),  s = f/(2+f) */
+   f = m - 1.0;
+   s = f / (2.0 + f);
+   z = s * s;
+   w = z * z;
+   t1 = w * (vm_lg2 + w * (vm_lg4 + w * vm_lg6));
+   t2 = z * (vm_lg1 + w * (vm_lg3 + w * (vm_lg5 + w * vm_lg7)));
+   hfsq = 0.5 * f * f;
+
+   return e * vm_ln2_hi - ((hfsq - (s * (hfsq + t1 + t2) + e * vm_ln2_lo)) - f);
+}
+
+static inline VM_ATTR vd VM_NAME(cbrt_v)(vd x)
+{
+   vd m, e, q, r, t, y, y3;
+
+   e = VM_NAME(frexp)(x, &m);
+
+   /* x = t * 2^(3q) with t in [1,8): q = floor(e/3) */
+   q = ((e - 1.0) * (1.0/3.0) + vm_magic_r) - vm_magic_r;
+   r = e - 3.0 * q;
+   t = m * (1.0 + r * (0.5 + 0.5 * r));
+
+   /* Start from a quadratic in m times cbrt(2^r). A Halley step, then a
+      Newton step as small correction to keep its round off small */
+   y = (vm_cb0 + m * (vm_cb1 + m * vm_cb2)) * (1.0 + r * (vm_cbr1 + r * vm_cbr2));
+   y3 = y * y * y;
+   y = y * (y3 + 2.0 * t) / (2.0 * y3 + t);
+   y = y + (t / (y * y) - y) * (1.0/3.0);
+
+   return y * VM_NAME(ldexp1)(q);
+}
+
+static inline VM_ATTR void VM_NAME(sincos_v)(vd x, vd *s, vd *c)
+{
+   vd t, k, r, z, sr, cr, hz, w;
+   vi q, swap;
+
+   /* Nearest multiple k of pi/2, its low bits give the quadrant */
+   t = x * vm_2_pi + vm_magic_r;
+   k = t - vm_magic_r;
+   q = (vi)t;
+
+   /* Cody-Waite: r = x - k*pi/2 in three parts */
+   r = ((x - k * vm_pio2_1) - k * vm_pio2_2) - k * vm_pio2_3;
+   z = r * r;
+
+   sr = r + r * z * (vm_s1 + z * (vm_s2 + z * (vm_s3 + z * (vm_s4 + z * (vm_s5 + z * vm_s6)))));
+
+   hz = 0.5 * z;
+   w = 1.0 - hz;
+   cr = w + (((1.0 - w) - hz) + z * z * (vm_c1 + z * (vm_c2 + z * (vm_c3 + z * (vm_c4 + z * (vm_c5 + z * vm_c6))))));
+
+   /* Odd quadrants swap sine and cosine, the sign follows the quadrant */
+   swap = ((q & 1) != 0);
+   *s = (vd)((vi)VM_NAME(blend)(swap, cr, sr) ^ ((q & 2) << 62));
+   *c = (vd)((vi)VM_NAME(blend)(swap, sr, cr) ^ (((q + 1) & 2) << 62));
+}
+
+static inline VM_ATTR vd VM_NAME(acos_v)(vd x)
+{
+   vd ax, z, s, p, qz, r, df, den, small_r, pos_r, neg_r;
+   vi small;
+
+   ax = (vd)((vi)x & ~vm_sign_bit);
+   small = (ax < 0.5);
+
+   /* Near 0: acos = pi/2 - asin(x). Else from z = (1-|x|)/2 and sqrt(z) */
+   z = VM_NAME(blend)(small, x * x, (1.0 - ax) * 0.5);
+   s = VM_SQRT(z);
+
+   p = z * (vm_ps0 + z * (vm_ps1 + z * (vm_ps2 + z * (vm_ps3 + z * (vm_ps4 + z * vm_ps5)))));
+   qz = 1.0 + z * (vm_qs1 + z * (vm_qs2 + z * (vm_qs3 + z * vm_qs4)));
+   r = p / qz;
+
+   small_r = vm_pio2_hi - (x - (vm_pio2_lo - x * r));
+
+   /* Positive side: sqrt(z) split into a high part and a correction */
+   df = (vd)((vi)s & vm_high_mask);
+   den = s + df;
+   den = VM_NAME(blend)(den == 0.0, (vd){ 0 } + 1.0, den);
+   pos_r = 2.0 * (df + (r * s + (z - df * df) / den));
+
+   neg_r = vm_pi - 2.0 * (s + (r * s - vm_pio2_lo));
+
+   return VM_NAME(blend)(small, small_r, VM_NAME(blend)(x < 0.0, neg_r, pos_r));
+}
+
+/* Loops over the arrays. Lanes outside of the domain of the kernel are
+   recomputed with libm, e.g. zero, negative or huge arguments and NaN */
+
+static VM_ATTR void VM_NAME(log)(int n, const double *x, double *y)
+{
+   int i, l, m;
+
+   for (i = 0; i < n; i += VM_W)
+   {
+      vd v, r;
+
+      m = (n - i < VM_W) ? n - i : VM_W;
+      v = VM_NAME(load)(x + i, m, 1.0);
+      r = VM_NAME(log_v)(v);
+
+      for (l = 0; l < m; l++)
+         if (!((v[l] >= DBL_MIN) && (v[l] <= DBL_MAX)))
+            r[l] = log(v[l]);
+
+      VM_NAME(store)(y + i, r, m);
+   }
+}
+
+static VM_ATTR void VM_NAME(cbrt)(int n, const double *x, double *y)
+{
+   int i, l, m;
+
+   for (i = 0; i < n; i += VM_W)
+   {
+      vd v, r;
+
+      m = (n - i < VM_W) ? n - i : VM_W;
+      v = VM_NAME(load)(x + i, m, 1.0);
+
+      /* Odd function: Root of |x|, then the sign of x */
+      r = VM_NAME(cbrt_v)((vd)((vi)v & ~vm_sign_bit));
+      r = (vd)((vi)r | ((vi)v & vm_sign_bit));
+
+      for (l = 0; l < m; l++)
+         if (!((fabs(v[l]) >= DBL_MIN) && (fabs(v[l]) <= DBL_MAX)))
+            r[l] = cbrt(v[l]);
+
+      VM_NAME(store)(y + i, r, m);
+   }
+}
+
+static VM_ATTR void VM_NAME(sincos)(int n, const double *x, double *s, double *c)
+{
+   int i, l, m;
+
+   for (i = 0; i < n; i += VM_W)
+   {
+      vd v, rs, rc;
+
+      m = (n - i < VM_W) ? n - i : VM_W;
+      v = VM_NAME(load)(x + i, m, 0.0);
+      VM_NAME(sincos_v)(v, &rs, &rc);
+
+      for (l = 0; l < m; l++)
+         if (!(fabs(v[l]) <= vm_sincos_max))
+         {
+            rs[l] = sin(v[l]);
+            rc[l] = cos(v[l]);
+         }
+
+      VM_NAME(store)(s + i, rs, m);
+      VM_NAME(store)(c + i, rc, m);
+   }
+}
+
+static VM_ATTR void VM_NAME(acos)(int n, const double *x, double *y)
+{
+   int i, l, m;
+
+   for (i = 0; i < n; i += VM_W)
+   {
+      vd v, r;
+
+      m = (n - i < VM_W) ? n - i : VM_W;
+      v = VM_NAME(load)(x + i, m, 0.0);
+      r = VM_NAME(acos_v)(v);
+
+      for (l = 0; l < m; l++)
+         if (!(fabs(v[l]) <= 1.0))
+            r[l] = acos(v[l]);
+
+      VM_NAME(store)(y + i, r, m);
+   }
+}
+
+#undef vd
+#undef vi
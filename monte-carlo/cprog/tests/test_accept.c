@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include "accept/accept.h"
+#include "pdg/pdg.h"
+#include "sphere/sphere.h"
+
+/* Integrand over the offsets (dx, dy), as given in the header */
+static double direct(double dx, double dy, double l, double w, double s, double theta, int n)
+{
+   double r2 = dx*dx + dy*dy + s*s;
+   double c = (sin(theta)*dy + cos(theta)*s) / sqrt(r2);
+
+   return (l - fabs(dx)) * (w - fabs(dy)) * s*s * pow(c, n) / (r2*r2);
+}
+
+static void test_limits(void **state)
+{
+   const double area = 0.01*0.02;
+   double g;
+
+   /* Far apart: Both areas seen under 1/s^2, times cos^n of the axis */
+   g = accept_tele(0.01, 0.02, 10.0, 0.0, 0);
+   assert_true(fabs(g / (area*area/100.0) - 1.0) < 1E-5);
+   g = accept_tele(0.01, 0.02, 10.0, 0.5, 2);
+   assert_true(fabs(g / (area*area/100.0*cos(0.5)*cos(0.5)) - 1.0) < 1E-5);
+
+   /* Close together: All of the flux through the first one is seen */
+   g = accept_tele(10.0, 5.0, 1E-4, 0.0, 0);
+   assert_true(fabs(g / (pi*50.0) - 1.0) < 1E-4);
+   g = accept_tele_rate(0, 10.0, 5.0, 1E-4, 0.8);
+   assert_true(fabs(g / r_tot_PDG(0.8, 50.0) - 1.0) < 1E-4);
+   g = accept_tele_rate(1, 10.0, 5.0, 1E-4, 0.8);
+   assert_true(fabs(g / (mu_iso_i*pi*50.0) - 1.0) < 1E-4);
+
+   /* Isotropic does not depend on the tilt, the sign of the tilt does not matter */
+   assert_true(fabs(accept_tele(0.1, 0.2, 0.3, 0.7, 0) / accept_tele(0.1, 0.2, 0.3, 0.0, 0) - 1.0) < 1E-12);
+   assert_true(fabs(accept_tele(0.1, 0.2, 0.3, 0.7, 4) / accept_tele(0.1, 0.2, 0.3, -0.7, 4) - 1.0) < 1E-12);
+
+   /* Wrong input */
+   assert_true(accept_tele(0.1, 0.1, 1.0, 0.0, 1) == -1.0);
+   assert_true(accept_tele(0.1, 0.1, 1.0, 0.0, -2) == -1.0);
+   assert_true(accept_tele(0.0, 0.1, 1.0, 0.0, 2) == -1.0);
+   assert_true(accept_tele(0.1, 0.1, -1.0, 0.0, 2) == -1.0);
+   assert_true(accept_tele_rate(2, 0.1, 0.1, 1.0, 0.0) == -1.0);
+}
+
+static void test_direct(void **state)
+{
+   const int    steps = 400;
+   const double l = 0.2, w = 0.1, s = 0.15;
+   const double theta[3] = { 0.0, 0.6, 1.3 };
+   int          t, n, i, j;
+
+   /* Midpoint rule over the quadrants of the offsets */
+   for (t = 0; t < 3; ++t)
+      for (n = 0; n <= 2; n += 2)
+      {
+         double hx = l/steps, hy = w/steps;
+         double sum = 0.0;
+
+         for (i = 0; i < steps; ++i)
+            for (j = 0; j < steps; ++j)
+            {
+               double dx = (i + 0.5)*hx, dy = (j + 0.5)*hy;
+
+               sum += direct(dx, dy, l, w, s, theta[t], n) + direct(-dx, dy, l, w, s, theta[t], n) +
+                  direct(dx, -dy, l, w, s, theta[t], n) + direct(-dx, -dy, l, w, s, theta[t], n);
+            }
+         sum *= hx*hy;
+         assert_true(fabs(accept_tele(l, w, s, theta[t], n) / sum - 1.0) < 1E-5);
+      }
+}
+
+int main(int argc, char**argv)
+{
+   const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_limits),
+      cmocka_unit_test(test_direct),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -22,10 +22,13 @@
 #include <cmocka.h>
 
 #include <math.h>
+#include <string.h>
 
 #include "sphere/sphere.h"
 #include "vector/vector.h"
 #include "geometry/geometry.h"
+#include "rng/rng.h"
+#include "vmath/vmath.h"
 
 static void test_rotate_vec(void **state)
 {
@@ -777,6 +780,1110 @@ static void test_intersect_box(void **state)
    assert_true(fabs(l3[1] - (-0.5)) < 1E-10);
 }
 
+static void test_val_omega(void **state)
+{
+   const vec3 N = { 0.3, -0.4, sqrt(0.75) };
+   double     phi[37], out[37];
+   int        i, t;
+
+   for (i = 0; i < 37; ++i)
+      phi[i] = 2.0 * pi * (i + 0.5) / 37.0;
+
+   /* A row of azimuth values gives the same elements as single calls */
+   for (t = 0; t < 2; ++t)
+   {
+      double th = (t == 0) ? 0.3 : 1.2;
+
+      val_omega_n(th, 37, phi, N, t, 0.01, 0.02, out);
+      for (i = 0; i < 37; ++i)
+      {
+         double ref = val_omega(th, phi[i], N, t, 0.01, 0.02);
+
+         assert_true(fabs(out[i] - ref) <= 1E-13 * ref);
+      }
+   }
+}
+
+static void test_box_prepared(void **state)
+{
+   const int  total = 100000;
+   rng_stream rng;
+   int        i, n;
+   int        n_hit = 0;
+
+   rng_seed(&rng, 11, 0);
+   for (i = 0; i < total; ++i)
+   {
+      g_box          box;
+      g_box_prepared prep;
+      g_line         line;
+      vec3           axis, out;
+      double         phi, cos_t, sin_t, angle;
+      int            hit, hit_p;
+      double         tr[2], l1[2], l2[2], l3[2];
+      double         tr_p[2], l1_p[2], l2_p[2], l3_p[2];
+
+      /* New box every 100 lines: Random size, position and orientation */
+      if (i % 100 == 0)
+      {
+         const vec3 e1 = { 1.0, 0.0, 0.0 };
+         const vec3 e2 = { 0.0, 1.0, 0.0 };
+         const vec3 e3 = { 0.0, 0.0, 1.0 };
+
+         cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+         sin_t = sqrt(1.0 - cos_t * cos_t);
+         phi = 2.0 * pi * rng_uniform(&rng);
+         axis[0] = sin_t * cos(phi);
+         axis[1] = sin_t * sin(phi);
+         axis[2] = cos_t;
+         angle = 2.0 * pi * rng_uniform(&rng);
+
+         rotate_vec(box.edge1, e1, axis, angle);
+         rotate_vec(box.edge2, e2, axis, angle);
+         rotate_vec(box.edge3, e3, axis, angle);
+         for (n = 0; n < 3; ++n)
+            box.origin[n] = 2.0 * rng_uniform(&rng) - 1.0;
+         box.edge1_len = 0.05 + rng_uniform(&rng);
+         box.edge2_len = 0.05 + rng_uniform(&rng);
+         box.edge3_len = 0.05 + rng_uniform(&rng);
+         prepare_box(&prep, &box);
+      }
+
+      /* Isotropic line through a point near the box */
+      for (n = 0; n < 3; ++n)
+         line.origin[n] = 4.0 * rng_uniform(&rng) - 2.0;
+      cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+      sin_t = sqrt(1.0 - cos_t * cos_t);
+      phi = 2.0 * pi * rng_uniform(&rng);
+      line.direction[0] = sin_t * cos(phi);
+      line.direction[1] = sin_t * sin(phi);
+      line.direction[2] = cos_t;
+
+      assert_int_equal(intersect_box(line, box, tr, &hit, l1, l2, l3), 0);
+      assert_int_equal(intersect_box_prepared(&line, &prep, tr_p, &hit_p, l1_p, l2_p, l3_p), 0);
+      assert_int_equal(hit, hit_p);
+      if (hit == 0)
+         continue;
+
+      /* Same crossings in the same order */
+      ++n_hit;
+      for (n = 0; n < 2; ++n)
+      {
+         assert_true(fabs(tr[n] - tr_p[n]) < 1E-9);
+         assert_true(fabs(l1[n] - l1_p[n]) < 1E-9);
+         assert_true(fabs(l2[n] - l2_p[n]) < 1E-9);
+         assert_true(fabs(l3[n] - l3_p[n]) < 1E-9);
+      }
+
+      /* Crossing points in the box frame lead back to the same points */
+      for (n = 0; n < 3; ++n)
+         out[n] = box.origin[n] + l1_p[0]*box.edge1[n] + l2_p[0]*box.edge2[n] + l3_p[0]*box.edge3[n];
+      for (n = 0; n < 3; ++n)
+         assert_true(fabs(out[n] - (line.origin[n] + tr_p[0]*line.direction[n])) < 1E-9);
+   }
+
+   /* A fair share of the lines hit */
+   assert_true(n_hit > total / 10);
+}
+
+static void test_rect_prepared(void **state)
+{
+   const int  total = 100000;
+   rng_stream rng;
+   int        i, n;
+   int        n_hit = 0;
+
+   rng_seed(&rng, 12, 0);
+   for (i = 0; i < total; ++i)
+   {
+      g_rectangle     rect;
+      g_rect_prepared prep;
+      g_ray           ray;
+      vec3            axis, cross, O;
+      double          phi, cos_t, sin_t, angle;
+      int             hit;
+      double          tr, l1, l2;
+
+      /* New rectangle every 100 rays: Random size, position and orientation */
+      if (i % 100 == 0)
+      {
+         const vec3 e1 = { 1.0, 0.0, 0.0 };
+         const vec3 e2 = { 0.0, 1.0, 0.0 };
+
+         cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+         sin_t = sqrt(1.0 - cos_t * cos_t);
+         phi = 2.0 * pi * rng_uniform(&rng);
+         axis[0] = sin_t * cos(phi);
+         axis[1] = sin_t * sin(phi);
+         axis[2] = cos_t;
+         angle = 2.0 * pi * rng_uniform(&rng);
+
+         rotate_vec(rect.edge1, e1, axis, angle);
+         rotate_vec(rect.edge2, e2, axis, angle);
+         cross_vec(rect.normal, rect.edge1, rect.edge2);
+         for (n = 0; n < 3; ++n)
+            rect.origin[n] = 2.0 * rng_uniform(&rng) - 1.0;
+         rect.edge1_len = 0.05 + rng_uniform(&rng);
+         rect.edge2_len = 0.05 + rng_uniform(&rng);
+         prepare_rect(&prep, &rect);
+      }
+
+      /* Isotropic ray from a point near the rectangle */
+      for (n = 0; n < 3; ++n)
+         ray.origin[n] = 4.0 * rng_uniform(&rng) - 2.0;
+      cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+      sin_t = sqrt(1.0 - cos_t * cos_t);
+      phi = 2.0 * pi * rng_uniform(&rng);
+      ray.direction[0] = sin_t * cos(phi);
+      ray.direction[1] = sin_t * sin(phi);
+      ray.direction[2] = cos_t;
+
+      if (0 != intersect_rect_prepared(&ray, &prep, &tr, &hit, &l1, &l2))
+         continue;
+
+      /* The crossing lies on the plane, with the local coordinates found from
+         the difference to the origin of the rectangle */
+      for (n = 0; n < 3; ++n)
+         cross[n] = ray.origin[n] + tr * ray.direction[n];
+      diff_vec(O, cross, rect.origin);
+      assert_true(fabs(dot_vec(O, rect.normal)) < 1E-9);
+      assert_true(fabs(dot_vec(O, rect.edge1) - l1) < 1E-9);
+      assert_true(fabs(dot_vec(O, rect.edge2) - l2) < 1E-9);
+      assert_int_equal(hit, (fabs(l1) <= rect.edge1_len) && (fabs(l2) <= rect.edge2_len));
+      n_hit += hit;
+   }
+
+   /* A fair share of the rays hit */
+   assert_true(n_hit > total / 50);
+}
+
+/* Odd length, to run through the padded tail of the vector kernels */
+#define NUM_RAYS 1001
+
+static void test_rect_n(void **state)
+{
+   static const char *kernels[] = { "scalar", "avx2", "avx512" };
+   const int          num = NUM_RAYS;
+   rng_stream         rng;
+   g_rectangle        rect;
+   g_rect_prepared    prep;
+   static double      org[3][NUM_RAYS], dir[3][NUM_RAYS];
+   static double      tr[NUM_RAYS], l1[NUM_RAYS], l2[NUM_RAYS];
+   static int         hit[NUM_RAYS];
+   const double      *origin[3] = { org[0], org[1], org[2] };
+   const double      *direction[3] = { dir[0], dir[1], dir[2] };
+   const vec3         e1 = { 1.0, 0.0, 0.0 };
+   const vec3         e2 = { 0.0, 1.0, 0.0 };
+   const vec3         axis = { 0.6, 0.0, 0.8 };
+   int                i, k, n;
+
+   /* Tilted rectangle, rays from a plane above it */
+   rotate_vec(rect.edge1, e1, axis, 0.7);
+   rotate_vec(rect.edge2, e2, axis, 0.7);
+   cross_vec(rect.normal, rect.edge1, rect.edge2);
+   rect.origin[0] = 0.1;
+   rect.origin[1] = -0.2;
+   rect.origin[2] = -0.5;
+   rect.edge1_len = 0.3;
+   rect.edge2_len = 0.2;
+   prepare_rect(&prep, &rect);
+
+   rng_seed(&rng, 13, 0);
+   for (i = 0; i < num; ++i)
+   {
+      double cos_t = 0.8 + 0.2 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+
+      org[0][i] = rng_uniform(&rng) - 0.5;
+      org[1][i] = rng_uniform(&rng) - 0.5;
+      org[2][i] = 0.5;
+      dir[0][i] = sin_t * cos(phi);
+      dir[1][i] = sin_t * sin(phi);
+      dir[2][i] = -cos_t;
+   }
+
+   /* One ray parallel to the plane of the rectangle */
+   for (n = 0; n < 3; ++n)
+      dir[n][7] = rect.edge1[n];
+
+   for (k = 0; k < 3; ++k)
+   {
+      int count = 0;
+
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      assert_true(intersect_rect_n(&prep, num, origin, direction, hit, tr, l1, l2) > num / 50);
+      for (i = 0; i < num; ++i)
+      {
+         g_ray  ray;
+         double tr_s, l1_s, l2_s;
+         int    hit_s = 0;
+
+         for (n = 0; n < 3; ++n)
+         {
+            ray.origin[n] = org[n][i];
+            ray.direction[n] = dir[n][i];
+         }
+
+         /* Same values as one ray at a time */
+         if (0 == intersect_rect_prepared(&ray, &prep, &tr_s, &hit_s, &l1_s, &l2_s))
+         {
+            assert_true(tr[i] == tr_s);
+            assert_true(l1[i] == l1_s);
+            assert_true(l2[i] == l2_s);
+         }
+         assert_int_equal(hit[i], hit_s);
+         count += hit[i];
+      }
+      assert_int_equal(count, intersect_rect_n(&prep, num, origin, direction, hit, NULL, NULL, NULL));
+   }
+}
+
+static void test_float_n(void **state)
+{
+   static const char *kernels[] = { "scalar", "avx2", "avx512" };
+   const int          num = NUM_RAYS;
+   const double       margin = 1E-5;
+   rng_stream         rng;
+   g_rectangle        rect;
+   g_box              box;
+   g_rect_prepared    rect_p, rect_in, rect_out;
+   g_box_prepared     box_p, box_in, box_out;
+   g_rect_prepared_f  rect_f;
+   g_box_prepared_f   box_f;
+   static float       org[3][NUM_RAYS], dir[3][NUM_RAYS];
+   static float       len_f[NUM_RAYS];
+   static int         hit[NUM_RAYS];
+   const float       *origin[3] = { org[0], org[1], org[2] };
+   const float       *direction[3] = { dir[0], dir[1], dir[2] };
+   const vec3         e1 = { 1.0, 0.0, 0.0 };
+   const vec3         e2 = { 0.0, 1.0, 0.0 };
+   const vec3         axis = { 0.0, 0.6, 0.8 };
+   int                i, k, n;
+
+   /* Tilted rectangle and box of cm size */
+   rotate_vec(rect.edge1, e1, axis, 0.4);
+   rotate_vec(rect.edge2, e2, axis, 0.4);
+   cross_vec(rect.normal, rect.edge1, rect.edge2);
+   rect.origin[0] = 0.01;
+   rect.origin[1] = 0.02;
+   rect.origin[2] = -0.5;
+   rect.edge1_len = 0.05;
+   rect.edge2_len = 0.03;
+
+   copy_vec(box.edge1, rect.edge1);
+   copy_vec(box.edge2, rect.edge2);
+   copy_vec(box.edge3, rect.normal);
+   copy_vec(box.origin, rect.origin);
+   box.edge1_len = 0.05;
+   box.edge2_len = 0.03;
+   box.edge3_len = 0.005;
+
+   prepare_rect(&rect_p, &rect);
+   prepare_rect_f(&rect_f, &rect_p);
+   prepare_box(&box_p, &box);
+   prepare_box_f(&box_f, &box_p);
+
+   /* Slightly smaller and larger shapes: A different float result is only allowed
+      for lines that pass closer to an edge than 'margin' */
+   rect_in = rect_p;
+   rect_out = rect_p;
+   box_in = box_p;
+   box_out = box_p;
+   for (n = 0; n < 3; ++n)
+   {
+      if (n < 2)
+      {
+         rect_in.len[n] -= margin;
+         rect_out.len[n] += margin;
+      }
+      box_in.len[n] -= margin;
+      box_out.len[n] += margin;
+   }
+
+   rng_seed(&rng, 14, 0);
+   for (i = 0; i < num; ++i)
+   {
+      double cos_t = 0.999 + 0.001 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+
+      org[0][i] = (float)(0.12 * rng_uniform(&rng) - 0.06);
+      org[1][i] = (float)(0.12 * rng_uniform(&rng) - 0.06);
+      org[2][i] = 0.5f;
+      dir[0][i] = (float)(sin_t * cos(phi));
+      dir[1][i] = (float)(sin_t * sin(phi));
+      dir[2][i] = (float)(-cos_t);
+   }
+
+   for (k = 0; k < 3; ++k)
+   {
+      int count_r = 0;
+      int count_b = 0;
+
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      assert_true(intersect_rect_nf(&rect_f, num, origin, direction, hit) > num / 10);
+      for (i = 0; i < num; ++i)
+      {
+         g_ray  ray;
+         double tr, l1, l2;
+         int    hit_d, hit_in, hit_out;
+
+         for (n = 0; n < 3; ++n)
+         {
+            ray.origin[n] = org[n][i];
+            ray.direction[n] = dir[n][i];
+         }
+         intersect_rect_prepared(&ray, &rect_p, &tr, &hit_d, &l1, &l2);
+         intersect_rect_prepared(&ray, &rect_in, &tr, &hit_in, &l1, &l2);
+         intersect_rect_prepared(&ray, &rect_out, &tr, &hit_out, &l1, &l2);
+         assert_true((hit[i] == hit_d) || (hit_in != hit_out));
+         count_r += hit[i];
+      }
+
+      assert_true(intersect_box_nf(&box_f, num, origin, direction, hit, len_f) > num / 10);
+      for (i = 0; i < num; ++i)
+      {
+         g_ray  ray;
+         double tr[2], l1[2], l2[2], l3[2];
+         int    hit_d, hit_in, hit_out;
+
+         for (n = 0; n < 3; ++n)
+         {
+            ray.origin[n] = org[n][i];
+            ray.direction[n] = dir[n][i];
+         }
+         intersect_box_prepared(&ray, &box_in, tr, &hit_in, l1, l2, l3);
+         intersect_box_prepared(&ray, &box_out, tr, &hit_out, l1, l2, l3);
+         intersect_box_prepared(&ray, &box_p, tr, &hit_d, l1, l2, l3);
+         assert_true((hit[i] == (hit_d == 2)) || (hit_in != hit_out));
+         if (hit[i] && hit_d)
+            assert_true(fabs(len_f[i] - fabs(tr[1] - tr[0])) < margin);
+         count_b += hit[i];
+      }
+
+      /* Length not needed */
+      assert_int_equal(count_r, intersect_rect_nf(&rect_f, num, origin, direction, hit));
+      assert_int_equal(count_b, intersect_box_nf(&box_f, num, origin, direction, hit, NULL));
+   }
+}
+
+static void test_pose(void **state)
+{
+   const vec3  axis_a = { 0.0, 0.6, 0.8 };
+   const vec3  axis_b = { 1.0, 0.0, 0.0 };
+   const vec3  p = { 0.3, -0.7, 1.1 };
+   static double x[NUM_RAYS], y[NUM_RAYS], z[NUM_RAYS];
+   g_pose      pa, pb, pc;
+   g_rectangle rect, placed;
+   g_line      line, moved;
+   vec3        r1, r2, r3;
+   int         i, n;
+
+   /* Same rotation as 'rotate_vec', identity does nothing */
+   pose_rotation(&pa, axis_a, 0.9);
+   pa.trans[0] = 0.5;
+   pa.trans[2] = -2.0;
+   rotate_vec(r1, p, axis_a, 0.9);
+   pose_apply_dir(r2, &pa, p);
+   for (n = 0; n < 3; ++n)
+      assert_true(fabs(r1[n] - r2[n]) < 1E-14);
+   pose_apply(r2, &pa, p);
+   assert_true(fabs(r2[2] - (r1[2] - 2.0)) < 1E-14);
+
+   pose_identity(&pc);
+   pose_apply(r1, &pc, p);
+   assert_int_equal(0, memcmp(r1, p, sizeof(vec3)));
+
+   /* Composition: 'pa' after 'pb', also in place */
+   pose_rotation(&pb, axis_b, -0.4);
+   pb.trans[1] = 0.25;
+   pose_apply(r1, &pb, p);
+   pose_apply(r2, &pa, r1);
+   pose_compose(&pc, &pa, &pb);
+   pose_apply(r3, &pc, p);
+   for (n = 0; n < 3; ++n)
+      assert_true(fabs(r2[n] - r3[n]) < 1E-14);
+   pose_compose(&pb, &pa, &pb);
+   assert_int_equal(0, memcmp(&pb, &pc, sizeof(g_pose)));
+
+   /* Batched, with and without z, in place */
+   for (i = 0; i < NUM_RAYS; ++i)
+   {
+      x[i] = 0.001 * i;
+      y[i] = -0.002 * i;
+      z[i] = (i % 3) ? 0.5 : 0.0;
+   }
+   {
+      const double *in[3] = { x, y, z };
+      double *const out[3] = { x, y, z };
+
+      pose_apply_n(&pc, NUM_RAYS, in, out);
+   }
+   for (i = 0; i < NUM_RAYS; ++i)
+   {
+      vec3 q = { 0.001 * i, -0.002 * i, (i % 3) ? 0.5 : 0.0 };
+
+      pose_apply(r1, &pc, q);
+      assert_true((fabs(r1[0] - x[i]) < 1E-14) && (fabs(r1[1] - y[i]) < 1E-14) && (fabs(r1[2] - z[i]) < 1E-14));
+   }
+   {
+      const double *in[3] = { x, y, NULL };
+      double *const out[3] = { x, y, z };
+
+      x[0] = p[0];
+      y[0] = p[1];
+      pose_apply_n(&pc, 1, in, out);
+      r3[0] = p[0];
+      r3[1] = p[1];
+      r3[2] = 0.0;
+      pose_apply(r1, &pc, r3);
+      assert_true((fabs(r1[0] - x[0]) < 1E-14) && (fabs(r1[1] - y[0]) < 1E-14) && (fabs(r1[2] - z[0]) < 1E-14));
+   }
+
+   /* A placed rectangle is hit by the placed line as the original one */
+   for (n = 0; n < 3; ++n)
+   {
+      rect.origin[n] = 0.0;
+      rect.normal[n] = (n == 2) ? 1.0 : 0.0;
+      rect.edge1[n] = (n == 0) ? 1.0 : 0.0;
+      rect.edge2[n] = (n == 1) ? 1.0 : 0.0;
+      line.origin[n] = (n == 2) ? 1.0 : 0.1;
+      line.direction[n] = (n == 2) ? -0.8 : 0.6 * (n == 0);
+   }
+   rect.edge1_len = 1.0;
+   rect.edge2_len = 0.2;
+   pose_rect(&placed, &pc, &rect);
+   pose_apply(moved.origin, &pc, line.origin);
+   pose_apply_dir(moved.direction, &pc, line.direction);
+   {
+      double t1, t2, a1, a2, b1, b2;
+      int    h1, h2;
+
+      assert_int_equal(0, intersect_rect(line, rect, &t1, &h1, &a1, &b1));
+      assert_int_equal(0, intersect_rect(moved, placed, &t2, &h2, &a2, &b2));
+      assert_int_equal(1, h1);
+      assert_int_equal(h1, h2);
+      assert_true((fabs(t1 - t2) < 1E-12) && (fabs(a1 - a2) < 1E-12) && (fabs(b1 - b2) < 1E-12));
+   }
+}
+
+static void test_disk(void **state)
+{
+   static const char *kernels[] = { "scalar", "avx2", "avx512" };
+   const int          num = NUM_RAYS;
+   const vec3         axis = { 0.6, 0.0, 0.8 };
+   rng_stream         rng;
+   g_disk             disk;
+   g_disk_prepared    prep;
+   g_rectangle        rect;
+   g_line             line;
+   static double      org[3][NUM_RAYS], dir[3][NUM_RAYS];
+   static double      tr[NUM_RAYS], l1[NUM_RAYS], l2[NUM_RAYS];
+   static int         hit[NUM_RAYS];
+   const double      *origin[3] = { org[0], org[1], org[2] };
+   const double      *direction[3] = { dir[0], dir[1], dir[2] };
+   double             t, a, b;
+   int                i, k, n, h;
+
+   /* Flat disk of radius 0.5 at z = -1 */
+   for (n = 0; n < 3; ++n)
+   {
+      disk.origin[n] = (n == 2) ? -1.0 : 0.0;
+      disk.normal[n] = (n == 2) ? 1.0 : 0.0;
+      disk.edge1[n] = (n == 0) ? 1.0 : 0.0;
+      disk.edge2[n] = (n == 1) ? 1.0 : 0.0;
+      line.origin[n] = 0.0;
+      line.direction[n] = (n == 2) ? 1.0 : 0.0;
+   }
+   disk.radius = 0.5;
+
+   line.origin[0] = 0.3;
+   line.origin[1] = -0.3;
+   assert_int_equal(0, intersect_disk(line, disk, &t, &h, &a, &b));
+   assert_int_equal(1, h);
+   assert_true((fabs(t + 1.0) < 1E-14) && (fabs(a - 0.3) < 1E-14) && (fabs(b + 0.3) < 1E-14));
+
+   /* Inside of the square around it, but outside of the radius */
+   line.origin[0] = 0.45;
+   assert_int_equal(0, intersect_disk(line, disk, &t, &h, &a, &b));
+   assert_int_equal(0, h);
+
+   /* Parallel, in the plane or not */
+   line.direction[0] = 1.0;
+   line.direction[2] = 0.0;
+   assert_int_equal(-1, intersect_disk(line, disk, &t, &h, &a, &b));
+   line.origin[2] = -1.0;
+   assert_int_equal(-2, intersect_disk(line, disk, &t, &h, &a, &b));
+
+   /* Tilted disk inside of its square: A hit of the disk is a hit of the square */
+   rotate_vec(disk.edge1, disk.edge1, axis, 0.7);
+   rotate_vec(disk.edge2, disk.edge2, axis, 0.7);
+   cross_vec(disk.normal, disk.edge1, disk.edge2);
+   copy_vec(rect.origin, disk.origin);
+   copy_vec(rect.normal, disk.normal);
+   copy_vec(rect.edge1, disk.edge1);
+   copy_vec(rect.edge2, disk.edge2);
+   rect.edge1_len = disk.radius;
+   rect.edge2_len = disk.radius;
+   prepare_disk(&prep, &disk);
+
+   rng_seed(&rng, 19, 0);
+   for (i = 0; i < num; ++i)
+   {
+      double cos_t = 0.8 + 0.2 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+
+      org[0][i] = 2.0 * rng_uniform(&rng) - 1.0;
+      org[1][i] = 2.0 * rng_uniform(&rng) - 1.0;
+      org[2][i] = 0.5;
+      dir[0][i] = sin_t * cos(phi);
+      dir[1][i] = sin_t * sin(phi);
+      dir[2][i] = -cos_t;
+   }
+   for (n = 0; n < 3; ++n)
+      dir[n][7] = disk.edge1[n];
+
+   for (k = 0; k < 3; ++k)
+   {
+      int count = 0;
+
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      assert_true(intersect_disk_n(&prep, num, origin, direction, hit, tr, l1, l2) > num / 50);
+      for (i = 0; i < num; ++i)
+      {
+         g_ray  ray;
+         double tr_s, l1_s, l2_s;
+         int    hit_s = 0, hit_r = 0;
+
+         for (n = 0; n < 3; ++n)
+         {
+            ray.origin[n] = org[n][i];
+            ray.direction[n] = dir[n][i];
+         }
+
+         /* Same values as one ray at a time */
+         if (0 == intersect_disk_prepared(&ray, &prep, &tr_s, &hit_s, &l1_s, &l2_s))
+         {
+            assert_true(tr[i] == tr_s);
+            assert_true(l1[i] == l1_s);
+            assert_true(l2[i] == l2_s);
+            assert_int_equal(0, intersect_rect(ray, rect, &tr_s, &hit_r, &l1_s, &l2_s));
+            assert_true(hit_r || !hit_s);
+         }
+         assert_int_equal(hit[i], hit_s);
+         count += hit[i];
+      }
+      assert_int_equal(count, intersect_disk_n(&prep, num, origin, direction, hit, NULL, NULL, NULL));
+   }
+}
+
+static void test_cylinder(void **state)
+{
+   static const char  *kernels[] = { "scalar", "avx2", "avx512" };
+   const int           num = NUM_RAYS;
+   const vec3          axis = { 0.0, 0.6, 0.8 };
+   rng_stream          rng;
+   g_cylinder          cyl;
+   g_cylinder_prepared prep;
+   g_pose              pose;
+   g_line              line;
+   static double       org[3][NUM_RAYS], dir[3][NUM_RAYS];
+   static double       t1[NUM_RAYS], t2[NUM_RAYS];
+   static int          hit[NUM_RAYS];
+   const double       *origin[3] = { org[0], org[1], org[2] };
+   const double       *direction[3] = { dir[0], dir[1], dir[2] };
+   double              t[2], a[2], b[2], c[2];
+   int                 i, k, n, h;
+
+   /* Upright cylinder of radius 1 and length 4 at the origin */
+   for (n = 0; n < 3; ++n)
+   {
+      cyl.origin[n] = 0.0;
+      cyl.axis[n] = (n == 2) ? 1.0 : 0.0;
+      cyl.edge1[n] = (n == 0) ? 1.0 : 0.0;
+      cyl.edge2[n] = (n == 1) ? 1.0 : 0.0;
+   }
+   cyl.radius = 1.0;
+   cyl.axis_len = 2.0;
+
+   /* Through the wall, along x */
+   line.origin[0] = -5.0;
+   line.origin[1] = 0.0;
+   line.origin[2] = 0.5;
+   line.direction[0] = 1.0;
+   line.direction[1] = 0.0;
+   line.direction[2] = 0.0;
+   assert_int_equal(0, intersect_cylinder(line, cyl, t, &h, a, b, c));
+   assert_int_equal(2, h);
+   assert_true((fabs(t[0] - 4.0) < 1E-14) && (fabs(t[1] - 6.0) < 1E-14));
+   assert_true((fabs(a[0] + 1.0) < 1E-14) && (fabs(a[1] - 1.0) < 1E-14) && (c[0] == 0.5));
+
+   /* Through both caps, along the axis: Exactly on the caps */
+   line.direction[0] = 0.0;
+   line.direction[2] = -1.0;
+   line.origin[0] = 0.5;
+   line.origin[2] = 3.0;
+   assert_int_equal(0, intersect_cylinder(line, cyl, t, &h, a, b, c));
+   assert_int_equal(2, h);
+   assert_true((fabs(t[0] - 1.0) < 1E-14) && (fabs(t[1] - 5.0) < 1E-14));
+   assert_true((c[0] == 2.0) && (c[1] == -2.0) && (a[0] == 0.5));
+
+   /* Parallel to the axis outside, across the axis beyond the caps, and passing by */
+   line.origin[0] = 1.5;
+   assert_int_equal(0, intersect_cylinder(line, cyl, t, &h, a, b, c));
+   assert_int_equal(0, h);
+   line.origin[0] = -5.0;
+   line.origin[2] = 2.5;
+   line.direction[0] = 1.0;
+   line.direction[2] = 0.0;
+   assert_int_equal(0, intersect_cylinder(line, cyl, t, &h, a, b, c));
+   assert_int_equal(0, h);
+   line.origin[1] = 1.1;
+   line.origin[2] = 0.0;
+   assert_int_equal(0, intersect_cylinder(line, cyl, t, &h, a, b, c));
+   assert_int_equal(0, h);
+
+   /* Placed and tilted: Crossings on the surface, the midpoint inside */
+   cyl.radius = 0.3;
+   cyl.axis_len = 0.4;
+   pose_rotation(&pose, axis, 0.9);
+   pose.trans[0] = 0.1;
+   pose.trans[2] = -0.2;
+   pose_cylinder(&cyl, &pose, &cyl);
+   prepare_cylinder(&prep, &cyl);
+
+   rng_seed(&rng, 23, 0);
+   for (i = 0; i < num; ++i)
+   {
+      double cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+
+      for (n = 0; n < 3; ++n)
+         org[n][i] = rng_uniform(&rng) - 0.5;
+      dir[0][i] = sin_t * cos(phi);
+      dir[1][i] = sin_t * sin(phi);
+      dir[2][i] = cos_t;
+   }
+   for (n = 0; n < 3; ++n)
+   {
+      dir[n][5] = cyl.axis[n];
+      dir[n][9] = cyl.edge1[n];
+   }
+
+   for (k = 0; k < 3; ++k)
+   {
+      int count = 0;
+
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      assert_true(intersect_cylinder_n(&prep, num, origin, direction, hit, t1, t2) > num / 10);
+      for (i = 0; i < num; ++i)
+      {
+         g_ray ray;
+
+         for (n = 0; n < 3; ++n)
+         {
+            ray.origin[n] = org[n][i];
+            ray.direction[n] = dir[n][i];
+         }
+
+         assert_int_equal(0, intersect_cylinder_prepared(&ray, &prep, t, &h, a, b, c));
+         assert_int_equal(hit[i], h / 2);
+         if (h)
+         {
+            double mid_r, mid_z;
+
+            /* Same values as one ray at a time */
+            assert_true((t1[i] == t[0]) && (t2[i] == t[1]));
+            assert_true(t[0] <= t[1]);
+            for (n = 0; n < 2; ++n)
+            {
+               double r2 = a[n]*a[n] + b[n]*b[n];
+
+               assert_true((fabs(r2 - 0.09) < 1E-12) || (fabs(fabs(c[n]) - 0.4) < 1E-12));
+               assert_true((r2 <= 0.09 + 1E-12) && (fabs(c[n]) <= 0.4 + 1E-12));
+            }
+            mid_r = (a[0] + a[1])*(a[0] + a[1]) + (b[0] + b[1])*(b[0] + b[1]);
+            mid_z = c[0] + c[1];
+            assert_true((mid_r <= 4.0*0.09 + 1E-12) && (fabs(mid_z) <= 0.8 + 1E-12));
+         }
+         count += hit[i];
+      }
+      assert_int_equal(count, intersect_cylinder_n(&prep, num, origin, direction, hit, NULL, NULL));
+   }
+}
+
+/* Face of a polyhedron through 'point' with the outer 'normal' */
+static void poly_face(g_polyhedron *poly, const vec3 point, const vec3 normal)
+{
+   g_plane *f = &poly->face[poly->faces++];
+
+   copy_vec(f->origin, point);
+   copy_vec(f->normal, normal);
+}
+
+static void test_poly(void **state)
+{
+   static const char *kernels[] = { "scalar", "avx2", "avx512" };
+   const int          num = NUM_RAYS;
+   const vec3         axis = { 0.0, 0.6, 0.8 };
+   const double       slope = 0.1 / sqrt(1.01);
+   rng_stream         rng;
+   g_polyhedron       bar, cube;
+   g_poly_prepared    prep;
+   g_box              box;
+   g_box_prepared     box_p;
+   g_pose             pose;
+   g_line             line;
+   static double      org[3][NUM_RAYS], dir[3][NUM_RAYS];
+   static double      tr1[NUM_RAYS], tr2[NUM_RAYS];
+   static int         hit[NUM_RAYS];
+   const double      *origin[3] = { org[0], org[1], org[2] };
+   const double      *direction[3] = { dir[0], dir[1], dir[2] };
+   double             t[2], t_b[2], l1[2], l2[2], l3[2];
+   vec3               p, nv;
+   int                face[2];
+   int                i, k, n, h;
+
+   /* Trapezoidal bar along y: 0.4 wide at z = -0.5, 0.2 wide at z = 0.5, 2 long */
+   bar.faces = 0;
+   p[0] = 0.0; p[1] = 0.0; p[2] = 0.5;
+   nv[0] = 0.0; nv[1] = 0.0; nv[2] = 1.0;
+   poly_face(&bar, p, nv);
+   p[2] = -0.5; nv[2] = -1.0;
+   poly_face(&bar, p, nv);
+   p[1] = 1.0; p[2] = 0.0; nv[1] = 1.0; nv[2] = 0.0;
+   poly_face(&bar, p, nv);
+   p[1] = -1.0; nv[1] = -1.0;
+   poly_face(&bar, p, nv);
+   p[0] = 0.15; p[1] = 0.0; nv[0] = 1.0 / sqrt(1.01); nv[1] = 0.0; nv[2] = slope;
+   poly_face(&bar, p, nv);
+   p[0] = -0.15; nv[0] = -nv[0];
+   poly_face(&bar, p, nv);
+
+   /* Across the bar at its middle, where it is 0.3 wide */
+   for (n = 0; n < 3; ++n)
+   {
+      line.origin[n] = (n == 0) ? -1.0 : 0.0;
+      line.direction[n] = (n == 0) ? 1.0 : 0.0;
+   }
+   assert_int_equal(0, intersect_poly(line, bar, t, &h, face));
+   assert_int_equal(2, h);
+   assert_true((fabs(t[0] - 0.85) < 1E-14) && (fabs(t[1] - 1.15) < 1E-14));
+   assert_true((face[0] == 5) && (face[1] == 4));
+
+   /* Narrower towards the top, and nothing above it */
+   line.origin[2] = 0.4;
+   assert_int_equal(0, intersect_poly(line, bar, t, &h, NULL));
+   assert_true((fabs(t[0] - 0.89) < 1E-14) && (fabs(t[1] - 1.11) < 1E-14));
+   line.origin[2] = 0.6;
+   assert_int_equal(0, intersect_poly(line, bar, t, &h, face));
+   assert_int_equal(0, h);
+
+   /* Along the bar: Parallel to four faces, through the two ends */
+   line.origin[0] = 0.1;
+   line.origin[1] = 0.0;
+   line.origin[2] = -0.3;
+   line.direction[0] = 0.0;
+   line.direction[1] = -1.0;
+   assert_int_equal(0, intersect_poly(line, bar, t, &h, face));
+   assert_int_equal(2, h);
+   assert_true((t[0] == -1.0) && (t[1] == 1.0) && (face[0] == 2) && (face[1] == 3));
+   line.origin[0] = 0.2;
+   line.origin[2] = 0.3;
+   assert_int_equal(0, intersect_poly(line, bar, t, &h, face));
+   assert_int_equal(0, h);
+
+   /* Moved along with the line: Same crossings */
+   pose_rotation(&pose, axis, 0.8);
+   pose.trans[0] = 0.3;
+   pose.trans[2] = -2.0;
+   pose_poly(&bar, &pose, &bar);
+   line.origin[0] = 0.1;
+   pose_apply(line.origin, &pose, line.origin);
+   pose_apply_dir(line.direction, &pose, line.direction);
+   assert_int_equal(0, intersect_poly(line, bar, t, &h, face));
+   assert_int_equal(2, h);
+   assert_true((fabs(t[0] + 1.0) < 1E-14) && (fabs(t[1] - 1.0) < 1E-14));
+
+   bar.faces = 0;
+   assert_int_equal(-1, intersect_poly(line, bar, t, &h, face));
+   assert_int_equal(0, h);
+   assert_int_equal(-1, prepare_poly(&prep, &bar));
+
+   /* Tilted box as six faces, same crossings as the box */
+   for (n = 0; n < 3; ++n)
+   {
+      box.origin[n] = 0.1 * n;
+      box.edge1[n] = (n == 0) ? 1.0 : 0.0;
+      box.edge2[n] = (n == 1) ? 1.0 : 0.0;
+      box.edge3[n] = (n == 2) ? 1.0 : 0.0;
+   }
+   rotate_vec(box.edge1, box.edge1, axis, 0.5);
+   rotate_vec(box.edge2, box.edge2, axis, 0.5);
+   rotate_vec(box.edge3, box.edge3, axis, 0.5);
+   box.edge1_len = 0.3;
+   box.edge2_len = 0.2;
+   box.edge3_len = 0.4;
+   prepare_box(&box_p, &box);
+
+   cube.faces = 0;
+   for (k = 0; k < 6; ++k)
+   {
+      const double *e = (k / 2 == 0) ? box.edge1 : ((k / 2 == 1) ? box.edge2 : box.edge3);
+      double        len = (k / 2 == 0) ? box.edge1_len : ((k / 2 == 1) ? box.edge2_len : box.edge3_len);
+
+      scale_vec2(nv, e, (k % 2) ? -1.0 : 1.0);
+      scale_vec2(p, nv, len);
+      add_vec(p, p, box.origin);
+      poly_face(&cube, p, nv);
+   }
+   assert_int_equal(0, prepare_poly(&prep, &cube));
+
+   rng_seed(&rng, 29, 0);
+   for (i = 0; i < num; ++i)
+   {
+      double cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+
+      for (n = 0; n < 3; ++n)
+         org[n][i] = rng_uniform(&rng) - 0.5;
+      dir[0][i] = sin_t * cos(phi);
+      dir[1][i] = sin_t * sin(phi);
+      dir[2][i] = cos_t;
+   }
+   for (n = 0; n < 3; ++n)
+      dir[n][7] = box.edge2[n];
+
+   for (k = 0; k < 3; ++k)
+   {
+      int count = 0;
+
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      assert_true(intersect_poly_n(&prep, num, origin, direction, hit, tr1, tr2) > num / 10);
+      for (i = 0; i < num; ++i)
+      {
+         g_ray ray;
+         int   hit_s, hit_b;
+
+         for (n = 0; n < 3; ++n)
+         {
+            ray.origin[n] = org[n][i];
+            ray.direction[n] = dir[n][i];
+         }
+
+         /* Same values as one ray at a time, and as the box up to rounding */
+         assert_int_equal(0, intersect_poly_prepared(&ray, &prep, t, &hit_s, face));
+         assert_int_equal(hit[i] ? 2 : 0, hit_s);
+         assert_int_equal(0, intersect_box_prepared(&ray, &box_p, t_b, &hit_b, l1, l2, l3));
+         assert_int_equal(hit_b, hit_s);
+         if (hit_s)
+         {
+            assert_true((tr1[i] == t[0]) && (tr2[i] == t[1]));
+            assert_true(fabs(t[0] - fmin(t_b[0], t_b[1])) < 1E-12);
+            assert_true(fabs(t[1] - fmax(t_b[0], t_b[1])) < 1E-12);
+         }
+         count += hit[i];
+      }
+      assert_int_equal(count, intersect_poly_n(&prep, num, origin, direction, hit, NULL, NULL));
+   }
+}
+
+static void test_stack(void **state)
+{
+   static const char *kernels[] = { "scalar", "avx2", "avx512" };
+   const int          num = NUM_RAYS;
+   const int          layers = 8;
+   const vec3         axis = { 0.6, 0.0, 0.8 };
+   rng_stream         rng;
+   g_rectangle        rect[8];
+   g_rect_prepared    rect_p[8];
+   g_stack_prepared   prep;
+   g_ray              ray;
+   static double      org[3][NUM_RAYS], dir[3][NUM_RAYS];
+   static double      tr[8*NUM_RAYS], l1[8*NUM_RAYS], l2[8*NUM_RAYS];
+   static int         hit[8*NUM_RAYS];
+   const double      *origin[3] = { org[0], org[1], org[2] };
+   const double      *direction[3] = { dir[0], dir[1], dir[2] };
+   double             t_s[8], l1_s[8], l2_s[8];
+   int                hit_s[8];
+   int                i, k, n, j;
+
+   /* Tilted hodoscope: Layers of paddles along edge 1 and edge 2 in turn */
+   for (j = 0; j < layers; ++j)
+   {
+      for (n = 0; n < 3; ++n)
+      {
+         rect[j].normal[n] = (n == 2) ? 1.0 : 0.0;
+         rect[j].edge1[n] = (n == 0) ? 1.0 : 0.0;
+         rect[j].edge2[n] = (n == 1) ? 1.0 : 0.0;
+      }
+      rotate_vec(rect[j].normal, rect[j].normal, axis, 0.3);
+      rotate_vec(rect[j].edge1, rect[j].edge1, axis, 0.3);
+      rotate_vec(rect[j].edge2, rect[j].edge2, axis, 0.3);
+      scale_vec2(rect[j].origin, rect[j].normal, -0.2 * j);
+      rect[j].origin[0] += 0.01 * j;
+      rect[j].edge1_len = (j % 2) ? 0.5 : 0.1;
+      rect[j].edge2_len = (j % 2) ? 0.1 : 0.5;
+      prepare_rect(&rect_p[j], &rect[j]);
+   }
+
+   assert_int_equal(-1, prepare_stack(&prep, rect, 0));
+   assert_int_equal(-1, prepare_stack(&prep, rect, G_STACK_MAX + 1));
+   rect[3].edge1[1] += 1.0E-9;
+   assert_int_equal(-1, prepare_stack(&prep, rect, layers));
+   rect[3].edge1[1] -= 1.0E-9;
+   assert_int_equal(0, prepare_stack(&prep, rect, layers));
+
+   /* Along the normal through the centers of all layers */
+   copy_vec(ray.origin, rect[0].origin);
+   copy_vec(ray.direction, rect[0].normal);
+   assert_int_equal(layers, intersect_stack_prepared(&ray, &prep, t_s, hit_s, l1_s, l2_s));
+   for (j = 0; j < layers; ++j)
+      assert_true(fabs(t_s[j] + 0.2 * j - 0.01 * j * rect[0].normal[0]) < 1E-14);
+
+   /* Parallel to the layers */
+   copy_vec(ray.direction, rect[0].edge1);
+   assert_int_equal(-1, intersect_stack_prepared(&ray, &prep, t_s, hit_s, NULL, NULL));
+   for (j = 0; j < layers; ++j)
+      assert_int_equal(0, hit_s[j]);
+
+   rng_seed(&rng, 23, 0);
+   for (i = 0; i < num; ++i)
+   {
+      double cos_t = 0.995 + 0.005 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+      vec3   o, d;
+
+      /* Down the stack, close to its normal */
+      o[0] = 0.3 * rng_uniform(&rng) - 0.15;
+      o[1] = 0.3 * rng_uniform(&rng) - 0.15;
+      o[2] = 0.5;
+      d[0] = sin_t * cos(phi);
+      d[1] = sin_t * sin(phi);
+      d[2] = -cos_t;
+      rotate_vec(o, o, axis, 0.3);
+      rotate_vec(d, d, axis, 0.3);
+      for (n = 0; n < 3; ++n)
+      {
+         org[n][i] = o[n];
+         dir[n][i] = d[n];
+      }
+   }
+   for (n = 0; n < 3; ++n)
+      dir[n][7] = rect[0].edge2[n];
+
+   for (k = 0; k < 3; ++k)
+   {
+      int all = 0;
+
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      assert_true(intersect_stack_n(&prep, num, origin, direction, hit, tr, l1, l2) > num / 20);
+      for (i = 0; i < num; ++i)
+      {
+         int count = 0;
+
+         for (n = 0; n < 3; ++n)
+         {
+            ray.origin[n] = org[n][i];
+            ray.direction[n] = dir[n][i];
+         }
+
+         /* Same values as one ray at a time */
+         if (intersect_stack_prepared(&ray, &prep, t_s, hit_s, l1_s, l2_s) >= 0)
+            for (j = 0; j < layers; ++j)
+            {
+               double t_r, l1_r, l2_r;
+               int    hit_r;
+
+               assert_true(tr[j*num + i] == t_s[j]);
+               assert_true(l1[j*num + i] == l1_s[j]);
+               assert_true(l2[j*num + i] == l2_s[j]);
+
+               /* And as the layers one at a time, up to rounding */
+               assert_int_equal(0, intersect_rect_prepared(&ray, &rect_p[j], &t_r, &hit_r, &l1_r, &l2_r));
+               assert_true(fabs(t_r - t_s[j]) < 1E-12);
+               assert_true((fabs(l1_r - l1_s[j]) < 1E-12) && (fabs(l2_r - l2_s[j]) < 1E-12));
+               assert_int_equal(hit_r, hit_s[j]);
+            }
+         for (j = 0; j < layers; ++j)
+         {
+            assert_int_equal(hit[j*num + i], hit_s[j]);
+            count += hit_s[j];
+         }
+         all += (count == layers);
+      }
+      assert_int_equal(all, intersect_stack_n(&prep, num, origin, direction, hit, NULL, NULL, NULL));
+   }
+}
+
+static void test_accept_cone(void **state)
+{
+   const vec3  axis = { 0.3, 0.0, 0.95393920141694566 };
+   rng_stream  rng;
+   g_pose      pose;
+   g_rectangle r1, r2;
+   double      cos_max;
+   int         i, n;
+
+   rng_seed(&rng, 17, 0);
+
+   /* Telescope of 0.2 x 0.1 rectangles, 1.0 apart: Bound from opposite corners */
+   for (n = 0; n < 3; ++n)
+   {
+      r1.origin[n] = (n == 2) ? 0.5 : 0.0;
+      r1.normal[n] = (n == 2) ? 1.0 : 0.0;
+      r1.edge1[n] = (n == 0) ? 1.0 : 0.0;
+      r1.edge2[n] = (n == 1) ? 1.0 : 0.0;
+   }
+   r1.edge1_len = 0.1;
+   r1.edge2_len = 0.05;
+   r2 = r1;
+   r2.origin[2] = -0.5;
+   cos_max = 1.0 / sqrt(1.0 + 4.0*(0.1*0.1 + 0.05*0.05));
+   assert_true(fabs(accept_cos_rect(&r1, &r2) - cos_max) < 1E-14);
+
+   /* Same for the placed telescope, and lines through both are inside */
+   pose_rotation(&pose, axis, 0.7);
+   pose.trans[0] = 3.0;
+   pose_rect(&r1, &pose, &r1);
+   pose_rect(&r2, &pose, &r2);
+   assert_true(fabs(accept_cos_rect(&r1, &r2) - cos_max) < 1E-12);
+   for (i = 0; i < NUM_RAYS; ++i)
+   {
+      double a1 = 2.0*rng_uniform(&rng) - 1.0, b1 = 2.0*rng_uniform(&rng) - 1.0;
+      double a2 = 2.0*rng_uniform(&rng) - 1.0, b2 = 2.0*rng_uniform(&rng) - 1.0;
+      vec3   v;
+
+      for (n = 0; n < 3; ++n)
+         v[n] = (r2.origin[n] + a2*r2.edge1_len*r2.edge1[n] + b2*r2.edge2_len*r2.edge2[n])
+            - (r1.origin[n] + a1*r1.edge1_len*r1.edge1[n] + b1*r1.edge2_len*r1.edge2[n]);
+      assert_true(fabs(dot_vec(v, r1.normal)) / sqrt(dot_vec(v, v)) >= cos_max - 1E-12);
+   }
+
+   /* No bound for rectangles that are not parallel */
+   r2.normal[0] = 0.6;
+   r2.normal[1] = 0.0;
+   r2.normal[2] = 0.8;
+   assert_true(accept_cos_rect(&r1, &r2) == 0.0);
+}
+
 int main(int argc, char**argv)
 {
    const struct CMUnitTest tests[] = {
@@ -784,6 +1891,17 @@ int main(int argc, char**argv)
       cmocka_unit_test(test_intersect_plane),
       cmocka_unit_test(test_intersect_rect),
       cmocka_unit_test(test_intersect_box),
+      cmocka_unit_test(test_rect_prepared),
+      cmocka_unit_test(test_rect_n),
+      cmocka_unit_test(test_float_n),
+      cmocka_unit_test(test_pose),
+      cmocka_unit_test(test_accept_cone),
+      cmocka_unit_test(test_disk),
+      cmocka_unit_test(test_cylinder),
+      cmocka_unit_test(test_stack),
+      cmocka_unit_test(test_poly),
+      cmocka_unit_test(test_box_prepared),
+      cmocka_unit_test(test_val_omega),
    };
 
    return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "sphere/sphere.h"
+#include "vector/vector.h"
+#include "gun/gun.h"
+#include "gun/gun_range.h"
+#include "gun/gun_pdg.h"
+#include "gun/gun_decay.h"
+#include "gun/gun_iso.h"
+#include "gun/gun_table.h"
+#include "gun/gun_energy.h"
+#include "pdg/pdg.h"
+
+static void test_range_instances(void **state)
+{
+   gun_ctx ctx_1 = gun_range_init(-1.0, 1.0);
+   gun_ctx ctx_2 = gun_range_init(10.0, 20.0);
+   double  x;
+   int     i;
+
+   /* The second gun must not change the range of the first one */
+   for (i = 0; i < 1000; ++i)
+   {
+      assert_int_equal(gun_event(ctx_1, &x), 0);
+      assert_true((-1.0 <= x) && (x < 1.0));
+
+      assert_int_equal(gun_event(ctx_2, &x), 0);
+      assert_true((10.0 <= x) && (x < 20.0));
+   }
+
+   gun_delete(ctx_1);
+   gun_delete(ctx_2);
+}
+
+static void test_pdg_instances(void **state)
+{
+   gun_ctx   ctx_c = gun_pdg_init(1);
+   gun_ctx   ctx_t = gun_pdg_init(0);
+   pdg_event evt_c;
+   pdg_event evt_t;
+   int       i;
+
+   /* Same sequence, one gun returns cos(theta), the other theta */
+   gun_seed(ctx_c, 5, 0);
+   gun_seed(ctx_t, 5, 0);
+   for (i = 0; i < 1000; ++i)
+   {
+      assert_int_equal(gun_event(ctx_c, evt_c.pars), 0);
+      assert_int_equal(gun_event(ctx_t, evt_t.pars), 0);
+      assert_true(fabs(cos(evt_t.out_t.theta) - evt_c.out_c.cos_theta) < 1E-10);
+      assert_true(evt_t.out_t.phi == evt_c.out_c.phi);
+   }
+
+   gun_delete(ctx_c);
+   gun_delete(ctx_t);
+}
+
+static void test_seed(void **state)
+{
+   gun_ctx ctx_1 = gun_range_init(0.0, 1.0);
+   gun_ctx ctx_2 = gun_range_init(0.0, 1.0);
+   double  x_1, x_2;
+   int     i;
+
+   /* Guns created without seed run on different streams */
+   gun_event(ctx_1, &x_1);
+   gun_event(ctx_2, &x_2);
+   assert_true(x_1 != x_2);
+
+   /* Skipping one stream ahead is the same as drawing from it */
+   gun_seed(ctx_1, 9, 4);
+   gun_seed(ctx_2, 9, 4);
+   for (i = 0; i < 3; ++i)
+      gun_event(ctx_1, &x_1);
+   gun_skip(ctx_2, 3);
+   gun_event(ctx_1, &x_1);
+   gun_event(ctx_2, &x_2);
+   assert_true(x_1 == x_2);
+
+   gun_delete(ctx_1);
+   gun_delete(ctx_2);
+}
+
+static int gun_const(const void *par, rng_stream *rng, double* out)
+{
+   *out = 2.0 + rng_uniform(rng);
+   return 0;
+}
+
+static void test_event_n(void **state)
+{
+   const int n = 101;
+   gun_ctx   ctx_s = gun_range_init(-2.0, 3.0);
+   gun_ctx   ctx_b = gun_range_init(-2.0, 3.0);
+   gun_ctx   ctx_p = gun_pdg_init(1);
+   gun_ctx   ctx_d = gun_decay_init(2.0);
+   gun_ctx   ctx_f = gun_init(2);
+   double    x[101], ct[101], phi[101];
+   double    *cols[2];
+   double    val[2];
+   int       i;
+
+   /* One parameter: The batch is the sequence of single events */
+   gun_seed(ctx_s, 1, 2);
+   gun_seed(ctx_b, 1, 2);
+   cols[0] = x;
+   assert_int_equal(gun_event_n(ctx_b, n, cols), 0);
+   for (i = 0; i < n; ++i)
+   {
+      assert_int_equal(gun_event(ctx_s, val), 0);
+      assert_true(val[0] == x[i]);
+   }
+
+   /* Two parameters: Columns in range */
+   cols[0] = ct;
+   cols[1] = phi;
+   assert_int_equal(gun_event_n(ctx_p, n, cols), 0);
+   for (i = 0; i < n; ++i)
+   {
+      assert_true((0.0 <= ct[i]) && (ct[i] <= 1.0));
+      assert_true((0.0 <= phi[i]) && (phi[i] < 2.0*pi));
+   }
+
+   /* Batched logarithm: Same events as single ones up to round off */
+   gun_seed(ctx_d, 3, 0);
+   cols[0] = x;
+   assert_int_equal(gun_event_n(ctx_d, n, cols), 0);
+   gun_seed(ctx_d, 3, 0);
+   for (i = 0; i < n; ++i)
+   {
+      assert_int_equal(gun_event(ctx_d, val), 0);
+      assert_true(x[i] >= 0.0);
+      assert_true(fabs(x[i] - val[0]) <= 1E-15 * val[0]);
+   }
+
+   /* Without batch transform, each parameter falls back to single calls */
+   gun_config(ctx_f, 0, gun_const);
+   gun_config(ctx_f, 1, gun_const);
+   cols[0] = ct;
+   cols[1] = phi;
+   assert_int_equal(gun_event_n(ctx_f, n, cols), 0);
+   for (i = 0; i < n; ++i)
+   {
+      assert_true((2.0 <= ct[i]) && (ct[i] < 3.0));
+      assert_true((2.0 <= phi[i]) && (phi[i] < 3.0));
+   }
+
+   /* Missing column */
+   cols[1] = NULL;
+   assert_int_equal(gun_event_n(ctx_f, n, cols), -1);
+
+   gun_delete(ctx_s);
+   gun_delete(ctx_b);
+   gun_delete(ctx_p);
+   gun_delete(ctx_d);
+   gun_delete(ctx_f);
+}
+
+static void test_dir(void **state)
+{
+   const int n = 64;
+   gun_ctx   ctx_a = gun_pdg_init(1);
+   gun_ctx   ctx_d = gun_pdg_dir_init();
+   gun_ctx   ctx_i = gun_iso_dir_init();
+   pdg_event evt_a;
+   dir_event evt_d;
+   double    ux[64], uy[64], uz[64];
+   double    *cols[3] = { ux, uy, uz };
+   int       i;
+
+   /* Same draws as the angle gun, returned as unit vector */
+   gun_seed(ctx_a, 8, 0);
+   gun_seed(ctx_d, 8, 0);
+   for (i = 0; i < 1000; ++i)
+   {
+      double phi;
+
+      assert_int_equal(gun_event(ctx_a, evt_a.pars), 0);
+      assert_int_equal(gun_event(ctx_d, evt_d.pars), 0);
+
+      phi = atan2(evt_d.out.uy, evt_d.out.ux);
+      if (phi < 0.0)
+         phi += 2.0*pi;
+      assert_true(fabs(evt_d.out.uz - evt_a.out_c.cos_theta) < 1E-10);
+      assert_true(fabs(phi - evt_a.out_c.phi) < 1E-9);
+   }
+
+   /* Batch of unit vectors, upper half for PDG */
+   assert_int_equal(gun_event_n(ctx_d, n, cols), 0);
+   for (i = 0; i < n; ++i)
+   {
+      assert_true(fabs(ux[i]*ux[i] + uy[i]*uy[i] + uz[i]*uz[i] - 1.0) < 1E-10);
+      assert_true(uz[i] >= 0.0);
+   }
+
+   assert_int_equal(gun_event_n(ctx_i, n, cols), 0);
+   for (i = 0; i < n; ++i)
+      assert_true(fabs(ux[i]*ux[i] + uy[i]*uy[i] + uz[i]*uz[i] - 1.0) < 1E-10);
+
+   gun_delete(ctx_a);
+   gun_delete(ctx_d);
+   gun_delete(ctx_i);
+}
+
+static void test_flux(void **state)
+{
+   const int  total = 100000;
+   const vec3 n_z = { 0.0, 0.0, 1.0 };
+   const vec3 n_t = { 0.0, -sin(0.8), cos(0.8) };
+   gun_ctx    ctx_p = gun_pdg_flux_init(n_z);
+   gun_ctx    ctx_i = gun_iso_flux_init(n_t);
+   dir_event  evt;
+   double     sum_p = 0.0;
+   double     sum_i = 0.0;
+   int        i;
+
+   for (i = 0; i < total; ++i)
+   {
+      assert_int_equal(gun_event(ctx_p, evt.pars), 0);
+      assert_true(fabs(dot_vec(evt.pars, evt.pars) - 1.0) < 1E-10);
+      assert_true(evt.out.uz >= 0.0);
+      sum_p += evt.out.uz;
+
+      assert_int_equal(gun_event(ctx_i, evt.pars), 0);
+      assert_true(fabs(dot_vec(evt.pars, evt.pars) - 1.0) < 1E-10);
+      assert_true(evt.out.uz >= 0.0);
+      sum_i += fabs(dot_vec(evt.pars, n_t));
+   }
+
+   /* PDG through a flat surface ~ cos^3: <cos> = 4/5 */
+   assert_true(fabs(sum_p/total - 0.8) < 3E-3);
+
+   /* Isotropic through any surface ~ |cos|: <|cos|> = 2/3 */
+   assert_true(fabs(sum_i/total - 2.0/3.0) < 3E-3);
+
+   gun_delete(ctx_p);
+   gun_delete(ctx_i);
+}
+
+static void test_flux_cone(void **state)
+{
+   const int    total = 200000;
+   const double cos_max = 0.9;
+   const vec3   n_t = { 0.0, -sin(0.6), cos(0.6) };
+   gun_ctx      ctx[4];
+   double       weight[2];
+   dir_event    evt;
+   int          j, i;
+
+   ctx[0] = gun_pdg_flux_init(n_t);
+   ctx[1] = gun_iso_flux_init(n_t);
+   ctx[2] = gun_pdg_flux_cone_init(n_t, cos_max);
+   ctx[3] = gun_iso_flux_cone_init(n_t, cos_max);
+   weight[0] = gun_pdg_flux_cone_weight(n_t, cos_max);
+   weight[1] = gun_iso_flux_cone_weight(n_t, cos_max);
+
+   /* No cone, and no limit */
+   assert_null(gun_iso_flux_cone_init(n_t, 1.5));
+   assert_null(gun_pdg_flux_cone_init(n_t, 1.5));
+   assert_true(fabs(gun_pdg_flux_cone_weight(n_t, 0.0) - 1.0) < 1E-12);
+   assert_true(fabs(weight[1] - (1.0 - cos_max*cos_max)) < 1E-12);
+
+   for (j = 0; j < 2; ++j)
+   {
+      int    inside = 0;
+      double sum_f = 0.0;
+      double sum_c = 0.0;
+      double p;
+
+      for (i = 0; i < total; ++i)
+      {
+         /* Full flux: Share and mean height of the directions inside of the cone */
+         assert_int_equal(gun_event(ctx[j], evt.pars), 0);
+         if (fabs(dot_vec(evt.pars, n_t)) >= cos_max)
+         {
+            ++inside;
+            sum_f += evt.out.uz;
+         }
+
+         /* Cone: Only directions inside, with the same distribution */
+         assert_int_equal(gun_event(ctx[j + 2], evt.pars), 0);
+         assert_true(fabs(dot_vec(evt.pars, evt.pars) - 1.0) < 1E-10);
+         assert_true(fabs(dot_vec(evt.pars, n_t)) >= cos_max - 1E-12);
+         sum_c += evt.out.uz;
+      }
+
+      p = (double)inside/(double)total;
+      assert_true(fabs(p - weight[j]) < 4.0*sqrt(weight[j]*(1.0 - weight[j])/(double)total));
+      assert_true(fabs(sum_f/inside - sum_c/total) < 2E-3);
+   }
+
+   for (j = 0; j < 4; ++j)
+      gun_delete(ctx[j]);
+}
+
+static double j_none(double theta, double phi)
+{
+   return 0.0;
+}
+
+static void test_table(void **state)
+{
+   const int  total = 100000;
+   const vec3 n_z = { 0.0, 0.0, 1.0 };
+   const vec3 n_t = { 0.0, -sin(0.7), cos(0.7) };
+   gun_ctx    ctx_z = gun_table_init(j_val_PDG, n_z, 1, 512, 128);
+   gun_ctx    ctx_t = gun_table_init(j_val_PDG, n_t, 1, 512, 128);
+   dir_event  evt;
+   double     sum_z = 0.0;
+   double     sum_t = 0.0;
+   int        i;
+
+   assert_non_null(ctx_z);
+   assert_non_null(ctx_t);
+
+   /* No table or nothing to sample */
+   assert_null(gun_table_init(j_val_PDG, n_z, 1, 0, 128));
+   assert_null(gun_table_init(j_none, n_z, 1, 16, 16));
+
+   /* Rate through a unit area, compare to the closed form */
+   assert_true(fabs(gun_table_norm(ctx_z) / r_tot_PDG(0.0, 1.0) - 1.0) < 1E-4);
+   assert_true(fabs(gun_table_norm(ctx_t) / r_tot_PDG(0.7, 1.0) - 1.0) < 1E-4);
+
+   for (i = 0; i < total; ++i)
+   {
+      assert_int_equal(gun_event(ctx_z, evt.pars), 0);
+      assert_true(fabs(dot_vec(evt.pars, evt.pars) - 1.0) < 1E-10);
+      assert_true(evt.out.uz >= 0.0);
+      sum_z += evt.out.uz;
+
+      assert_int_equal(gun_event(ctx_t, evt.pars), 0);
+      sum_t += evt.out.uz;
+   }
+
+   /* PDG through a flat surface ~ cos^3: <cos> = 4/5 */
+   assert_true(fabs(sum_z/total - 0.8) < 3E-3);
+
+   /* Same mean as the direct sampler of the tilted surface */
+   gun_delete(ctx_z);
+   ctx_z = gun_pdg_flux_init(n_t);
+   for (i = 0; i < total; ++i)
+   {
+      assert_int_equal(gun_event(ctx_z, evt.pars), 0);
+      sum_t -= evt.out.uz;
+   }
+   assert_true(fabs(sum_t/total) < 5E-3);
+
+   gun_delete(ctx_z);
+   gun_delete(ctx_t);
+}
+
+static void test_copy(void **state)
+{
+   const vec3 n_t = { 0.0, -sin(0.7), cos(0.7) };
+   gun_ctx    ctx_t = gun_table_init(j_val_PDG, n_t, 1, 64, 32);
+   gun_ctx    ctx_c = gun_copy(ctx_t);
+   double     col_t[3][16], col_c[3][16];
+   double     *out_t[3] = { col_t[0], col_t[1], col_t[2] };
+   double     *out_c[3] = { col_c[0], col_c[1], col_c[2] };
+   int        i, d;
+
+   assert_non_null(ctx_c);
+   assert_null(gun_copy(NULL));
+   assert_int_equal(gun_draws(ctx_c), gun_draws(ctx_t));
+   assert_true(gun_table_norm(ctx_c) == gun_table_norm(ctx_t));
+
+   /* Own stream of a new gun */
+   assert_int_equal(gun_event_n(ctx_t, 16, out_t), 0);
+   assert_int_equal(gun_event_n(ctx_c, 16, out_c), 0);
+   assert_true(col_t[2][0] != col_c[2][0]);
+
+   /* Same events on the same stream */
+   gun_seed(ctx_t, 6, 1);
+   gun_seed(ctx_c, 6, 1);
+   assert_int_equal(gun_event_n(ctx_t, 16, out_t), 0);
+   assert_int_equal(gun_event_n(ctx_c, 16, out_c), 0);
+   for (d = 0; d < 3; ++d)
+      for (i = 0; i < 16; ++i)
+         assert_true(col_t[d][i] == col_c[d][i]);
+
+   /* Independent of the original */
+   gun_delete(ctx_t);
+   assert_int_equal(gun_event_n(ctx_c, 16, out_c), 0);
+   gun_delete(ctx_c);
+}
+
+#define GUN_THREADS 4
+#define GUN_PER_THREAD 256
+
+/* Create and copy guns, and keep their sub-streams */
+static void *gun_make(void *arg)
+{
+   uint64_t *stream = (uint64_t*)arg;
+   gun_ctx   ctx = gun_range_init(0.0, 1.0);
+   int       i;
+
+   for (i = 0; i < GUN_PER_THREAD; ++i)
+   {
+      gun_ctx copy = gun_copy(ctx);
+
+      stream[i] = gun_rng(copy)->stream;
+      gun_delete(copy);
+   }
+   gun_delete(ctx);
+   return NULL;
+}
+
+static void test_threads(void **state)
+{
+   static uint64_t stream[GUN_THREADS][GUN_PER_THREAD];
+   pthread_t thread[GUN_THREADS];
+   int       t, i, u, j;
+
+   for (t = 0; t < GUN_THREADS; ++t)
+      assert_int_equal(pthread_create(&thread[t], NULL, gun_make, stream[t]), 0);
+   for (t = 0; t < GUN_THREADS; ++t)
+      pthread_join(thread[t], NULL);
+
+   /* No two guns on the same default stream */
+   for (t = 0; t < GUN_THREADS; ++t)
+      for (i = 0; i < GUN_PER_THREAD; ++i)
+         for (u = t; u < GUN_THREADS; ++u)
+            for (j = (u == t) ? i + 1 : 0; j < GUN_PER_THREAD; ++j)
+               assert_true(stream[t][i] != stream[u][j]);
+}
+
+static void test_energy(void **state)
+{
+   const int   total = 100000;
+   const vec3  n_z = { 0.0, 0.0, 1.0 };
+   const char *cache = "test_energy.cache";
+   const double l_max = log(1E5);
+   gun_ctx     ctx_1 = gun_energy_init(1, n_z, 1, 1.0, 1E5, NULL);
+   gun_ctx     ctx_10 = gun_energy_init(1, n_z, 1, 10.0, 1E5, NULL);
+   gun_ctx     ctx_c;
+   double      evt[4], evt_c[4];
+   double      norm = 0.0;
+   double      sum_1 = 0.0;
+   double      sum_10 = 0.0;
+   double      f_10, f_100;
+   int         n_10 = 0;
+   int         n_100 = 0;
+   int         i, i_c, i_e;
+
+   assert_non_null(ctx_1);
+   assert_non_null(ctx_10);
+
+   /* Unknown model or no energy range */
+   assert_null(gun_energy_init(2, n_z, 1, 1.0, 1E5, NULL));
+   assert_null(gun_energy_init(1, n_z, 1, 0.0, 1E5, NULL));
+   assert_null(gun_energy_init(1, n_z, 1, 10.0, 10.0, NULL));
+
+   /* Rate through a unit area: Midpoint sums in cos(theta) and log(E) */
+   for (i_c = 0; i_c < 200; ++i_c)
+   {
+      double c = ((double)i_c + 0.5) / 200.0;
+
+      for (i_e = 0; i_e < 2000; ++i_e)
+      {
+         double e = exp(((double)i_e + 0.5) * l_max / 2000.0);
+
+         norm += j_spec_reyna(e, acos(c)) * e * c;
+      }
+   }
+   norm *= 2.0 * pi / 200.0 * l_max / 2000.0;
+   assert_true(fabs(gun_energy_norm(ctx_1) / norm - 1.0) < 1E-3);
+
+   for (i = 0; i < total; ++i)
+   {
+      assert_int_equal(gun_event(ctx_1, evt), 0);
+      assert_true(fabs(dot_vec(evt, evt) - 1.0) < 1E-10);
+      assert_true(evt[2] >= 0.0);
+      assert_true((1.0 <= evt[3]) && (evt[3] <= 1E5));
+
+      if (evt[3] > 10.0)
+      {
+         ++n_10;
+         sum_1 += evt[2];
+      }
+      if (evt[3] > 100.0)
+         ++n_100;
+
+      assert_int_equal(gun_event(ctx_10, evt), 0);
+      assert_true(evt[3] >= 10.0);
+      sum_10 += evt[2];
+   }
+
+   /* Fractions above a threshold, with binomial errors */
+   f_10 = gun_energy_norm(ctx_10) / gun_energy_norm(ctx_1);
+   assert_true(fabs((double)n_10 / total - f_10) < 5.0 * sqrt(f_10 / total));
+
+   gun_delete(ctx_10);
+   ctx_10 = gun_energy_init(1, n_z, 1, 100.0, 1E5, NULL);
+   f_100 = gun_energy_norm(ctx_10) / gun_energy_norm(ctx_1);
+   assert_true(fabs((double)n_100 / total - f_100) < 5.0 * sqrt(f_100 / total));
+
+   /* Energy and direction are joint: Above 10 GeV, the muons come from the same directions */
+   assert_true(fabs(sum_1 / n_10 - sum_10 / total) < 5E-3);
+
+   /* Tables written to the cache, then read from it give the same events */
+   remove(cache);
+   ctx_c = gun_energy_init(1, n_z, 1, 1.0, 1E5, cache);
+   gun_delete(ctx_c);
+   ctx_c = gun_energy_init(1, n_z, 1, 1.0, 1E5, cache);
+   assert_non_null(ctx_c);
+   gun_seed(ctx_1, 4, 0);
+   gun_seed(ctx_c, 4, 0);
+   for (i = 0; i < 1000; ++i)
+   {
+      assert_int_equal(gun_event(ctx_1, evt), 0);
+      assert_int_equal(gun_event(ctx_c, evt_c), 0);
+      assert_true((evt[2] == evt_c[2]) && (evt[3] == evt_c[3]));
+   }
+   gun_delete(ctx_c);
+
+   /* A cache of another setup is rebuilt */
+   ctx_c = gun_energy_init(0, n_z, 1, 1.0, 1E5, cache);
+   assert_non_null(ctx_c);
+   assert_true(gun_energy_norm(ctx_c) > 2.0 * gun_energy_norm(ctx_1));
+   remove(cache);
+
+   gun_delete(ctx_c);
+   gun_delete(ctx_1);
+   gun_delete(ctx_10);
+}
+
+int main(int argc, char**argv)
+{
+   const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_range_instances),
+      cmocka_unit_test(test_pdg_instances),
+      cmocka_unit_test(test_seed),
+      cmocka_unit_test(test_event_n),
+      cmocka_unit_test(test_dir),
+      cmocka_unit_test(test_flux),
+      cmocka_unit_test(test_flux_cone),
+      cmocka_unit_test(test_table),
+      cmocka_unit_test(test_copy),
+      cmocka_unit_test(test_threads),
+      cmocka_unit_test(test_energy),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
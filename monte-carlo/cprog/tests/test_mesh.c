@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sphere/sphere.h"
+#include "vector/vector.h"
+#include "geometry/geometry.h"
+#include "rng/rng.h"
+#include "mesh/mesh.h"
+
+/* Sphere of triangles between NUM_THETA rings and NUM_PHI meridians */
+#define NUM_THETA 64
+#define NUM_PHI   128
+#define MAX_TRI   (2*NUM_THETA*NUM_PHI)
+
+static float tris[MAX_TRI][3][3];
+static int   num_tris;
+
+/* Keep a triangle, turned so that it faces away from 'center' */
+static void put_tri(const vec3 v0, const vec3 v1, const vec3 v2, const vec3 center)
+{
+   vec3 e1, e2, n, c;
+   int  a;
+
+   diff_vec(e1, v1, v0);
+   diff_vec(e2, v2, v0);
+   cross_vec(n, e1, e2);
+   if (dot_vec(n, n) == 0.0)
+      return;
+
+   diff_vec(c, v0, center);
+   for (a = 0; a < 3; a++)
+   {
+      const int turn = (dot_vec(n, c) < 0.0);
+
+      tris[num_tris][0][a] = (float)v0[a];
+      tris[num_tris][1][a] = (float)(turn ? v2[a] : v1[a]);
+      tris[num_tris][2][a] = (float)(turn ? v1[a] : v2[a]);
+   }
+   ++num_tris;
+}
+
+static void sphere_point(vec3 p, int i, int j)
+{
+   double theta = pi * i / NUM_THETA;
+   double phi = 2.0 * pi * j / NUM_PHI;
+
+   p[0] = sin(theta) * cos(phi);
+   p[1] = sin(theta) * sin(phi);
+   p[2] = cos(theta);
+}
+
+static void make_sphere(void)
+{
+   const vec3 center = { 0.0, 0.0, 0.0 };
+   int        i, j;
+
+   num_tris = 0;
+   for (i = 0; i < NUM_THETA; ++i)
+      for (j = 0; j < NUM_PHI; ++j)
+      {
+         vec3 p00, p10, p11, p01;
+
+         sphere_point(p00, i, j);
+         sphere_point(p10, i + 1, j);
+         sphere_point(p11, i + 1, j + 1);
+         sphere_point(p01, i, j + 1);
+         put_tri(p00, p10, p11, center);
+         put_tri(p00, p11, p01, center);
+      }
+}
+
+static void add_tris(mesh_ctx m)
+{
+   int t, c, a;
+
+   for (t = 0; t < num_tris; ++t)
+   {
+      vec3 v[3];
+
+      for (c = 0; c < 3; ++c)
+         for (a = 0; a < 3; ++a)
+            v[c][a] = tris[t][c][a];
+      assert_int_equal(t, mesh_add_tri(m, v[0], v[1], v[2]));
+   }
+}
+
+static void write_ascii(const char *name)
+{
+   FILE *f = fopen(name, "w");
+   int   t, c;
+
+   assert_non_null(f);
+   fprintf(f, "solid test\n");
+   for (t = 0; t < num_tris; ++t)
+   {
+      fprintf(f, "  facet normal 0 0 0\n    outer loop\n");
+      for (c = 0; c < 3; ++c)
+         fprintf(f, "      vertex %.9g %.9g %.9g\n", tris[t][c][0], tris[t][c][1], tris[t][c][2]);
+      fprintf(f, "    endloop\n  endfacet\n");
+   }
+   fprintf(f, "endsolid test\n");
+   fclose(f);
+}
+
+static void put_le32(unsigned char *b, uint32_t u)
+{
+   b[0] = u & 0xff;
+   b[1] = (u >> 8) & 0xff;
+   b[2] = (u >> 16) & 0xff;
+   b[3] = (u >> 24) & 0xff;
+}
+
+static void write_binary(const char *name, int num)
+{
+   FILE          *f = fopen(name, "wb");
+   unsigned char  head[84];
+   unsigned char  rec[50];
+   int            t, c, a;
+
+   assert_non_null(f);
+
+   /* Starts as an ASCII file would */
+   memset(head, ' ', 80);
+   memcpy(head, "solid binary", 12);
+   put_le32(head + 80, (uint32_t)num);
+   fwrite(head, 1, 84, f);
+
+   for (t = 0; t < num; ++t)
+   {
+      memset(rec, 0, sizeof(rec));
+      for (c = 0; c < 3; ++c)
+         for (a = 0; a < 3; ++a)
+         {
+            uint32_t u;
+
+            memcpy(&u, &tris[t][c][a], sizeof(u));
+            put_le32(rec + 12 + 12*c + 4*a, u);
+         }
+      fwrite(rec, 1, 50, f);
+   }
+   fclose(f);
+}
+
+/* Cube of side 2 around the coordinate origin */
+static void make_cube(void)
+{
+   const vec3 center = { 0.0, 0.0, 0.0 };
+   int        a, s;
+
+   num_tris = 0;
+   for (a = 0; a < 3; ++a)
+      for (s = -1; s <= 1; s += 2)
+      {
+         vec3 c[4];
+         int  k;
+
+         /* Corners of the face around, its diagonal through the center */
+         for (k = 0; k < 4; ++k)
+         {
+            c[k][a] = s;
+            c[k][(a + 1) % 3] = (k == 1 || k == 2) ? 1.0 : -1.0;
+            c[k][(a + 2) % 3] = (k >= 2) ? 1.0 : -1.0;
+         }
+         put_tri(c[0], c[1], c[2], center);
+         put_tri(c[0], c[2], c[3], center);
+      }
+}
+
+static void test_cube(void **state)
+{
+   mesh_ctx       m = mesh_init();
+   mesh_crossings cr = { NULL, 0, 0 };
+   g_ray          ray;
+   double         thick;
+
+   make_cube();
+   assert_int_equal(12, num_tris);
+   add_tris(m);
+   assert_int_equal(12, mesh_num(m));
+
+   ray.origin[0] = -5.0;
+   ray.origin[1] = 0.3;
+   ray.origin[2] = 0.2;
+   ray.direction[0] = 1.0;
+   ray.direction[1] = 0.0;
+   ray.direction[2] = 0.0;
+   assert_int_equal(-1, mesh_cross(m, &ray, 0.0, HUGE_VAL, &cr, &thick));
+   assert_int_equal(0, mesh_build(m, 1));
+
+   /* Through, then from the inside */
+   assert_int_equal(2, mesh_cross(m, &ray, 0.0, HUGE_VAL, &cr, &thick));
+   assert_true((cr.hit[0].enter == 1) && (cr.hit[1].enter == 0));
+   assert_true((cr.hit[0].translation == 4.0) && (cr.hit[1].translation == 6.0));
+   assert_true(thick == 2.0);
+
+   assert_int_equal(1, mesh_cross(m, &ray, 5.5, HUGE_VAL, &cr, &thick));
+   assert_true(thick == 0.5);
+   assert_int_equal(0, mesh_cross(m, &ray, 4.5, 5.0, &cr, &thick));
+   assert_true(thick == 0.5);
+   assert_int_equal(2, mesh_cross(m, &ray, -HUGE_VAL, HUGE_VAL, &cr, NULL));
+
+   /* Backwards: Nothing behind the origin */
+   ray.direction[0] = -1.0;
+   assert_int_equal(0, mesh_cross(m, &ray, 0.0, HUGE_VAL, &cr, &thick));
+   assert_true(thick == 0.0);
+
+   /* Through the centers of two faces, on the diagonals between their triangles */
+   ray.origin[1] = 0.0;
+   ray.origin[2] = 0.0;
+   ray.direction[0] = 1.0;
+   assert_int_equal(2, mesh_cross(m, &ray, 0.0, HUGE_VAL, &cr, &thick));
+   assert_true(thick == 2.0);
+
+   /* Past it */
+   ray.origin[2] = 1.5;
+   assert_int_equal(0, mesh_cross(m, &ray, -HUGE_VAL, HUGE_VAL, &cr, &thick));
+
+   mesh_crossings_free(&cr);
+   assert_null(cr.hit);
+   mesh_delete(m);
+}
+
+static void test_sphere(void **state)
+{
+   mesh_ctx       m_1 = mesh_init();
+   mesh_ctx       m_n = mesh_init();
+   mesh_ctx       m_a = mesh_init();
+   mesh_ctx       m_b = mesh_init();
+   mesh_crossings cr_1 = { NULL, 0, 0 };
+   mesh_crossings cr_n = { NULL, 0, 0 };
+   mesh_crossings cr_f = { NULL, 0, 0 };
+   g_pose         pose;
+   rng_stream     rng;
+   g_ray          ray;
+   int            i, k, n;
+
+   make_sphere();
+   add_tris(m_1);
+   add_tris(m_n);
+
+   /* Same triangles from the files, the binary ones moved along z */
+   write_ascii("test_mesh_ascii.stl");
+   write_binary("test_mesh_binary.stl", num_tris);
+   pose_identity(&pose);
+   pose.trans[2] = 2.0;
+   assert_int_equal(num_tris, mesh_load_stl(m_a, "test_mesh_ascii.stl", NULL));
+   assert_int_equal(num_tris, mesh_load_stl(m_b, "test_mesh_binary.stl", &pose));
+   assert_int_equal(num_tris, mesh_num(m_b));
+   remove("test_mesh_ascii.stl");
+   remove("test_mesh_binary.stl");
+
+   /* The same tree on one thread or many */
+   assert_int_equal(0, mesh_build(m_1, 1));
+   assert_int_equal(0, mesh_build(m_n, 8));
+   assert_int_equal(0, mesh_build(m_a, 0));
+   assert_int_equal(0, mesh_build(m_b, 3));
+
+   rng_seed(&rng, 31, 0);
+   for (i = 0; i < 20000; ++i)
+   {
+      double cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+      double thick_1, thick_n, thick_f, b2;
+      vec3   d;
+
+      for (n = 0; n < 3; ++n)
+         ray.origin[n] = 3.0 * rng_uniform(&rng) - 1.5;
+      ray.direction[0] = sin_t * cos(phi);
+      ray.direction[1] = sin_t * sin(phi);
+      ray.direction[2] = cos_t;
+
+      k = mesh_cross(m_1, &ray, -HUGE_VAL, HUGE_VAL, &cr_1, &thick_1);
+      assert_int_equal(k, mesh_cross(m_n, &ray, -HUGE_VAL, HUGE_VAL, &cr_n, &thick_n));
+      assert_true(thick_1 == thick_n);
+      for (n = 0; n < k; ++n)
+      {
+         assert_int_equal(cr_1.hit[n].tri, cr_n.hit[n].tri);
+         assert_true(cr_1.hit[n].translation == cr_n.hit[n].translation);
+      }
+
+      /* Thickness of the whole line: The chord of the sphere, up to its facets */
+      cross_vec(d, ray.origin, ray.direction);
+      b2 = dot_vec(d, d);
+      if (b2 < 0.8)
+      {
+         assert_int_equal(2, k);
+         assert_true(fabs(thick_1 - 2.0 * sqrt(1.0 - b2)) < 0.01);
+      }
+      else if (b2 > 1.0)
+         assert_int_equal(0, k);
+      assert_true(k % 2 == 0);
+
+      /* Forward only: Inside of the sphere at the origin, or not */
+      mesh_cross(m_1, &ray, 0.0, HUGE_VAL, &cr_1, &thick_1);
+      if ((b2 < 0.8) && (dot_vec(ray.origin, ray.origin) < 0.8))
+      {
+         double t_out = -dot_vec(ray.origin, ray.direction) + sqrt(1.0 - b2);
+
+         assert_int_equal(1, cr_1.num);
+         assert_true(fabs(thick_1 - t_out) < 0.01);
+      }
+
+      /* From the files: The moved one is rounded to single precision again */
+      assert_int_equal(cr_1.num, mesh_cross(m_a, &ray, 0.0, HUGE_VAL, &cr_f, &thick_f));
+      assert_true(thick_1 == thick_f);
+      ray.origin[2] += 2.0;
+      assert_int_equal(cr_1.num, mesh_cross(m_b, &ray, 0.0, HUGE_VAL, &cr_f, &thick_f));
+      assert_true(fabs(thick_1 - thick_f) < 1E-4);
+   }
+
+   mesh_crossings_free(&cr_1);
+   mesh_crossings_free(&cr_n);
+   mesh_crossings_free(&cr_f);
+   mesh_delete(m_1);
+   mesh_delete(m_n);
+   mesh_delete(m_a);
+   mesh_delete(m_b);
+}
+
+static void test_stl_errors(void **state)
+{
+   mesh_ctx m = mesh_init();
+   FILE    *f;
+
+   make_cube();
+   add_tris(m);
+
+   assert_int_equal(-1, mesh_load_stl(m, "test_mesh_missing.stl", NULL));
+
+   /* A facet of two corners: Nothing of the file is kept */
+   f = fopen("test_mesh_broken.stl", "w");
+   assert_non_null(f);
+   fprintf(f, "solid broken\n facet normal 0 0 1\n outer loop\n");
+   fprintf(f, "  vertex 0 0 0\n  vertex 1 0 0\n  vertex 0 1 0\n endloop\n endfacet\n");
+   fprintf(f, " facet normal 0 0 1\n outer loop\n");
+   fprintf(f, "  vertex 0 0 0\n  vertex 1 0 0\n endloop\n endfacet\nendsolid broken\n");
+   fclose(f);
+   assert_int_equal(-1, mesh_load_stl(m, "test_mesh_broken.stl", NULL));
+   assert_int_equal(12, mesh_num(m));
+   remove("test_mesh_broken.stl");
+
+   /* A binary file without triangles */
+   write_binary("test_mesh_empty.stl", 0);
+   assert_int_equal(0, mesh_load_stl(m, "test_mesh_empty.stl", NULL));
+   assert_int_equal(12, mesh_num(m));
+   remove("test_mesh_empty.stl");
+
+   mesh_delete(m);
+}
+
+int main(int argc, char**argv)
+{
+   const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_cube),
+      cmocka_unit_test(test_sphere),
+      cmocka_unit_test(test_stl_errors),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include "rng/rng.h"
+#include "rng/qmc.h"
+
+static void test_philox(void **state)
+{
+   /* Known answer tests of the Philox4x32-10 reference implementation */
+   const uint32_t c_1[4] = { 0, 0, 0, 0 };
+   const uint32_t k_1[2] = { 0, 0 };
+   const uint32_t r_1[4] = { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 };
+
+   const uint32_t c_2[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff };
+   const uint32_t k_2[2] = { 0xffffffff, 0xffffffff };
+   const uint32_t r_2[4] = { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd };
+
+   const uint32_t c_3[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+   const uint32_t k_3[2] = { 0xa4093822, 0x299f31d0 };
+   const uint32_t r_3[4] = { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 };
+
+   uint32_t out[4];
+   int      i;
+
+   rng_philox4x32(out, c_1, k_1);
+   for (i = 0; i < 4; ++i)
+      assert_int_equal(out[i], r_1[i]);
+
+   rng_philox4x32(out, c_2, k_2);
+   for (i = 0; i < 4; ++i)
+      assert_int_equal(out[i], r_2[i]);
+
+   rng_philox4x32(out, c_3, k_3);
+   for (i = 0; i < 4; ++i)
+      assert_int_equal(out[i], r_3[i]);
+}
+
+static void test_uniform(void **state)
+{
+   const int  total = 100000;
+   rng_stream rng;
+   double     sum = 0.0;
+   double     sum2 = 0.0;
+   int        i;
+
+   rng_seed(&rng, 42, 0);
+   for (i = 0; i < total; ++i)
+   {
+      double u = rng_uniform(&rng);
+
+      assert_true((0.0 <= u) && (u < 1.0));
+      sum += u;
+      sum2 += u*u;
+   }
+
+   /* Mean 1/2 and variance 1/12, well inside 5 sigma */
+   assert_true(fabs(sum/total - 0.5) < 5.0*sqrt(1.0/(12.0*total)));
+   assert_true(fabs(sum2/total - sum*sum/((double)total*total) - 1.0/12.0) < 1E-3);
+   assert_int_equal(rng_position(&rng), total);
+}
+
+static void test_skip(void **state)
+{
+   rng_stream rng_a;
+   rng_stream rng_b;
+   int        i, n;
+
+   /* Skipping must land on the same value as drawing, for even and odd offsets */
+   for (n = 0; n < 7; ++n)
+   {
+      rng_seed(&rng_a, 7, 3);
+      rng_seed(&rng_b, 7, 3);
+
+      for (i = 0; i < n; ++i)
+         rng_uniform(&rng_a);
+      rng_skip(&rng_b, n);
+      assert_int_equal(rng_position(&rng_b), n);
+
+      for (i = 0; i < 5; ++i)
+         assert_true(rng_uniform(&rng_a) == rng_uniform(&rng_b));
+   }
+
+   /* Skipping from a position inside a block */
+   rng_seed(&rng_a, 7, 3);
+   rng_seed(&rng_b, 7, 3);
+   rng_uniform(&rng_b);
+   rng_skip(&rng_b, 1000000001ULL);
+   rng_skip(&rng_a, 1000000002ULL);
+   assert_true(rng_uniform(&rng_a) == rng_uniform(&rng_b));
+}
+
+static void test_uniform_n(void **state)
+{
+   rng_stream rng_a;
+   rng_stream rng_b;
+   double     buf[9];
+   int        i, n;
+
+   /* Batches of any length and start position continue the same sequence */
+   rng_seed(&rng_a, 3, 1);
+   rng_seed(&rng_b, 3, 1);
+   for (n = 0; n < 9; ++n)
+   {
+      rng_uniform_n(&rng_b, n, buf);
+      for (i = 0; i < n; ++i)
+         assert_true(rng_uniform(&rng_a) == buf[i]);
+      assert_int_equal(rng_position(&rng_a), rng_position(&rng_b));
+   }
+}
+
+static void test_streams(void **state)
+{
+   rng_stream rng_a;
+   rng_stream rng_b;
+   int        i, same = 0;
+
+   /* Same seed, different streams => different sequences */
+   rng_seed(&rng_a, 11, 0);
+   rng_seed(&rng_b, 11, 1);
+   for (i = 0; i < 100; ++i)
+      if (rng_uniform(&rng_a) == rng_uniform(&rng_b))
+         ++same;
+   assert_int_equal(same, 0);
+
+   /* Same seed and stream => identical sequence */
+   rng_seed(&rng_a, 11, 1);
+   rng_seed(&rng_b, 11, 1);
+   for (i = 0; i < 100; ++i)
+      assert_true(rng_uniform(&rng_a) == rng_uniform(&rng_b));
+}
+
+static void test_qmc(void **state)
+{
+   const int n = 256;
+   int       bins_1d[4][256] = { { 0 } };
+   int       bins_2d[16][16] = { { 0 } };
+   qmc_view  view, part;
+   rng_stream rng;
+   int       i, d;
+
+   assert_int_equal(-1, qmc_init(&view, 5, 0, 10, QMC_MAX_DIM));
+
+   /* Points of all dimensions are read through the stream */
+   rng_seed(&rng, 5, 0);
+   assert_int_equal(0, qmc_init(&view, 5, 0, 0, 4));
+   rng.feed = qmc_feed;
+   rng.src = &view;
+
+   /* A view on dimensions 2, 3 of the same replica */
+   assert_int_equal(0, qmc_init(&part, 5, 0, 2, 2));
+
+   for (i = 0; i < n; ++i)
+   {
+      double u[4];
+
+      rng_uniform_n(&rng, 4, u);
+      for (d = 0; d < 4; ++d)
+      {
+         assert_true((u[d] >= 0.0) && (u[d] < 1.0));
+         ++bins_1d[d][(int)(u[d]*n)];
+      }
+      ++bins_2d[(int)(u[0]*16)][(int)(u[1]*16)];
+
+      assert_true(u[2] == qmc_next(&part));
+      assert_true(u[3] == qmc_next(&part));
+   }
+
+   /* Scrambled Sobol points are stratified in every dimension ... */
+   for (d = 0; d < 4; ++d)
+      for (i = 0; i < n; ++i)
+         assert_int_equal(1, bins_1d[d][i]);
+
+   /* ... and in the squares of the first two dimensions */
+   for (i = 0; i < 16; ++i)
+      for (d = 0; d < 16; ++d)
+         assert_int_equal(1, bins_2d[i][d]);
+
+   /* Reseeding returns to the pseudo-random sequence */
+   rng_seed(&rng, 5, 0);
+   assert_null(rng.feed);
+}
+
+int main(int argc, char**argv)
+{
+   const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_philox),
+      cmocka_unit_test(test_uniform),
+      cmocka_unit_test(test_skip),
+      cmocka_unit_test(test_uniform_n),
+      cmocka_unit_test(test_streams),
+      cmocka_unit_test(test_qmc),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include "sphere/sphere.h"
+#include "vector/vector.h"
+#include "geometry/geometry.h"
+#include "rng/rng.h"
+#include "scene/scene.h"
+
+/* Hodoscope: Layers of paddles along x and y, with a box between the layers */
+#define NUM_LAYERS  4
+#define NUM_PADDLES 16
+#define NUM_VOLUMES (NUM_LAYERS*NUM_PADDLES + 1)
+
+static g_rectangle rects[NUM_LAYERS*NUM_PADDLES];
+static g_box       box;
+
+static scene_ctx make_hodoscope(void)
+{
+   scene_ctx sc = scene_init();
+   int       l, p, i;
+
+   for (l = 0; l < NUM_LAYERS; ++l)
+      for (p = 0; p < NUM_PADDLES; ++p)
+      {
+         g_rectangle *r = &rects[l*NUM_PADDLES + p];
+         const double pos = 0.1 * (p - (NUM_PADDLES - 1) / 2.0);
+
+         for (i = 0; i < 3; ++i)
+         {
+            r->origin[i] = 0.0;
+            r->normal[i] = (i == 2) ? 1.0 : 0.0;
+            r->edge1[i] = (i == 0) ? 1.0 : 0.0;
+            r->edge2[i] = (i == 1) ? 1.0 : 0.0;
+         }
+         r->origin[2] = 0.3 * l;
+         r->origin[(l % 2) ? 1 : 0] = pos;
+         r->edge1_len = (l % 2) ? 0.8 : 0.05;
+         r->edge2_len = (l % 2) ? 0.05 : 0.8;
+
+         assert_int_equal(l*NUM_PADDLES + p, scene_add_rect(sc, 100*l + p, r));
+      }
+
+   for (i = 0; i < 3; ++i)
+   {
+      box.origin[i] = (i == 2) ? 0.45 : 0.0;
+      box.edge1[i] = (i == 0) ? 1.0 : 0.0;
+      box.edge2[i] = (i == 1) ? 1.0 : 0.0;
+      box.edge3[i] = (i == 2) ? 1.0 : 0.0;
+   }
+   box.edge1_len = 0.3;
+   box.edge2_len = 0.2;
+   box.edge3_len = 0.05;
+   assert_int_equal(NUM_VOLUMES - 1, scene_add_box(sc, 999, &box));
+
+   return sc;
+}
+
+static void test_build(void **state)
+{
+   scene_ctx sc = scene_init();
+   g_ray     ray = { { 0.0, 0.0, 1.0 }, { 0.0, 0.0, -1.0 } };
+   scene_hit hits[4];
+
+   /* Empty scene */
+   assert_int_equal(0, scene_num(sc));
+   assert_int_equal(-1, scene_intersect(sc, &ray, hits, 4));
+   assert_int_equal(0, scene_build(sc));
+   assert_int_equal(0, scene_intersect(sc, &ray, hits, 4));
+   scene_delete(sc);
+
+   /* Not built after adding a volume */
+   sc = make_hodoscope();
+   assert_int_equal(NUM_VOLUMES, scene_num(sc));
+   assert_int_equal(-1, scene_intersect(sc, &ray, hits, 4));
+   assert_int_equal(0, scene_build(sc));
+
+   /* Straight down near the center: Paddle 8 of each layer, from the top one.
+      The box is crossed between layers 2 and 1. Only the first four are stored */
+   ray.origin[0] = 0.01;
+   ray.origin[1] = 0.02;
+   assert_int_equal(5, scene_intersect(sc, &ray, hits, 4));
+   assert_int_equal(308, hits[0].id);
+   assert_int_equal(208, hits[1].id);
+   assert_int_equal(999, hits[2].id);
+   assert_int_equal(2, hits[2].hit);
+   assert_true(fabs(hits[2].translation[0] - 0.5) < 1E-12);
+   assert_true(fabs(hits[2].translation[1] - 0.6) < 1E-12);
+   assert_int_equal(108, hits[3].id);
+   assert_int_equal(1, hits[3].hit);
+   assert_true(fabs(hits[3].translation[0] - 0.7) < 1E-12);
+
+   scene_delete(sc);
+}
+
+static void test_brute_force(void **state)
+{
+   const int  total = 20000;
+   scene_ctx  sc = make_hodoscope();
+   rng_stream rng;
+   int        i, n, v;
+   int        n_multi = 0;
+
+   assert_int_equal(0, scene_build(sc));
+   rng_seed(&rng, 15, 0);
+   for (i = 0; i < total; ++i)
+   {
+      g_ray     ray;
+      scene_hit hits[NUM_VOLUMES];
+      scene_hit first[2];
+      double    cos_t = 1.0 - 2.0 * rng_uniform(&rng);
+      double    sin_t = sqrt(1.0 - cos_t * cos_t);
+      double    phi = 2.0 * pi * rng_uniform(&rng);
+      int       num, num_ref = 0;
+
+      for (n = 0; n < 3; ++n)
+         ray.origin[n] = 2.0 * rng_uniform(&rng) - 1.0;
+      ray.direction[0] = sin_t * cos(phi);
+      ray.direction[1] = sin_t * sin(phi);
+      ray.direction[2] = cos_t;
+
+      /* Every ray is also axis parallel once in a while */
+      if (i % 100 == 0)
+      {
+         ray.direction[0] = 0.0;
+         ray.direction[1] = 0.0;
+         ray.direction[2] = 1.0;
+      }
+
+      num = scene_intersect(sc, &ray, hits, NUM_VOLUMES);
+      assert_true(num >= 0);
+
+      /* Path order */
+      for (n = 1; n < num; ++n)
+         assert_true(hits[n-1].translation[0] <= hits[n].translation[0]);
+
+      /* Same volumes as testing all of them */
+      for (v = 0; v < NUM_VOLUMES; ++v)
+      {
+         int found = 0;
+         int hit;
+
+         if (v < NUM_VOLUMES - 1)
+         {
+            double tr, l1, l2;
+
+            if ((0 != intersect_rect(ray, rects[v], &tr, &hit, &l1, &l2)) || !hit)
+               continue;
+            for (n = 0; n < num; ++n)
+               found |= (hits[n].id == 100*(v / NUM_PADDLES) + v % NUM_PADDLES)
+                  && (hits[n].translation[0] == tr);
+         }
+         else
+         {
+            double tr[2], l1[2], l2[2], l3[2];
+
+            intersect_box(ray, box, tr, &hit, l1, l2, l3);
+            if (hit != 2)
+               continue;
+            for (n = 0; n < num; ++n)
+               found |= (hits[n].id == 999)
+                  && (fabs(hits[n].translation[1] - hits[n].translation[0] - fabs(tr[1] - tr[0])) < 1E-9);
+         }
+         assert_true(found);
+         ++num_ref;
+      }
+      assert_int_equal(num, num_ref);
+
+      /* Only the first ones, same as the start of the full list */
+      if (num > 2)
+      {
+         ++n_multi;
+         assert_int_equal(num, scene_intersect(sc, &ray, first, 2));
+         for (n = 0; n < 2; ++n)
+            assert_true(first[n].translation[0] == hits[n].translation[0]);
+      }
+   }
+
+   assert_true(n_multi > total / 100);
+   scene_delete(sc);
+}
+
+/* Stack of slabs along z, walked from inside of one of them */
+static void test_segment_stack(void **state)
+{
+   scene_ctx      sc = scene_init();
+   scene_segments segs = { NULL, 0, 0 };
+   g_ray          ray;
+   g_box          slab;
+   scene_hit     *seg;
+   int            i, k, cap;
+
+   /* Added out of order, so the path order comes from the walk */
+   for (k = 0; k < 5; ++k)
+   {
+      const int l = (3*k) % 5;
+
+      for (i = 0; i < 3; ++i)
+      {
+         slab.origin[i] = (i == 2) ? 0.2 * l : 0.0;
+         slab.edge1[i] = (i == 0) ? 1.0 : 0.0;
+         slab.edge2[i] = (i == 1) ? 1.0 : 0.0;
+         slab.edge3[i] = (i == 2) ? 1.0 : 0.0;
+      }
+      slab.edge1_len = 1.0;
+      slab.edge2_len = 1.0;
+      slab.edge3_len = 0.05;
+      assert_int_equal(k, scene_add_box(sc, l, &slab));
+   }
+
+   for (i = 0; i < 3; ++i)
+   {
+      ray.origin[i] = (i == 2) ? 0.22 : 0.1;
+      ray.direction[i] = (i == 2) ? 1.0 : 0.0;
+   }
+
+   assert_int_equal(-1, scene_segment(sc, &ray, 0.0, HUGE_VAL, &segs));
+   assert_int_equal(0, scene_build(sc));
+
+   /* Forward from inside of slab 1: Its rest, then 2, 3, 4 */
+   assert_int_equal(4, scene_segment(sc, &ray, 0.0, HUGE_VAL, &segs));
+   seg = segs.seg;
+   for (k = 0; k < 4; ++k)
+   {
+      assert_int_equal(k + 1, seg[k].id);
+      assert_true(fabs(seg[k].translation[1] - (0.2*(k + 1) + 0.05 - 0.22)) < 1E-12);
+      if (k > 0)
+      {
+         assert_true(fabs(seg[k].translation[0] - (0.2*(k + 1) - 0.05 - 0.22)) < 1E-12);
+         assert_true(seg[k-1].translation[1] <= seg[k].translation[0]);
+      }
+   }
+   assert_true(seg[0].translation[0] == 0.0);
+
+   /* Limited range: Only the start of slab 4 */
+   assert_int_equal(1, scene_segment(sc, &ray, 0.5, 0.55, &segs));
+   assert_int_equal(4, segs.seg[0].id);
+   assert_true(fabs(segs.seg[0].translation[0] - 0.53) < 1E-12);
+   assert_true(segs.seg[0].translation[1] == 0.55);
+   assert_int_equal(0, scene_segment(sc, &ray, 0.3, 0.32, &segs));
+   assert_int_equal(0, scene_segment(sc, &ray, 1.0, 0.0, &segs));
+
+   /* The whole line, and the buffer stays the same */
+   assert_int_equal(5, scene_segment(sc, &ray, -HUGE_VAL, HUGE_VAL, &segs));
+   seg = segs.seg;
+   cap = segs.cap;
+   for (k = 0; k < 100; ++k)
+      assert_int_equal(5, scene_segment(sc, &ray, -HUGE_VAL, HUGE_VAL, &segs));
+   assert_true(seg == segs.seg);
+   assert_int_equal(cap, segs.cap);
+   for (k = 0; k < 5; ++k)
+      assert_int_equal(k, segs.seg[k].id);
+
+   scene_segments_free(&segs);
+   assert_null(segs.seg);
+   scene_delete(sc);
+}
+
+/* Same as the full list of 'scene_intersect', clipped to the range */
+static void test_segment_hodoscope(void **state)
+{
+   scene_ctx      sc = make_hodoscope();
+   scene_segments segs = { NULL, 0, 0 };
+   scene_hit      hits[NUM_VOLUMES];
+   rng_stream     rng;
+   g_ray          ray;
+   int            i, n;
+
+   assert_int_equal(0, scene_build(sc));
+   rng_seed(&rng, 11, 0);
+
+   for (i = 0; i < 20000; ++i)
+   {
+      double cos_t = 2.0 * rng_uniform(&rng) - 1.0;
+      double sin_t = sqrt(1.0 - cos_t * cos_t);
+      double phi = 2.0 * pi * rng_uniform(&rng);
+      int    num, m = 0;
+
+      for (n = 0; n < 3; ++n)
+         ray.origin[n] = 2.0 * rng_uniform(&rng) - 1.0;
+      ray.direction[0] = sin_t * cos(phi);
+      ray.direction[1] = sin_t * sin(phi);
+      ray.direction[2] = cos_t;
+
+      num = scene_intersect(sc, &ray, hits, NUM_VOLUMES);
+      assert_int_equal(num, scene_segment(sc, &ray, -HUGE_VAL, HUGE_VAL, &segs));
+      for (n = 0; n < num; ++n)
+         assert_true(segs.seg[n].translation[0] == hits[n].translation[0]);
+
+      /* Forward only */
+      assert_true(scene_segment(sc, &ray, 0.0, HUGE_VAL, &segs) >= 0);
+      for (n = 0; n < num; ++n)
+      {
+         if (hits[n].translation[1] < 0.0)
+            continue;
+         assert_true(m < segs.num);
+         assert_int_equal(hits[n].id, segs.seg[m].id);
+         assert_true(segs.seg[m].translation[0] == fmax(hits[n].translation[0], 0.0));
+         assert_true(segs.seg[m].translation[1] == hits[n].translation[1]);
+         ++m;
+      }
+      assert_int_equal(m, segs.num);
+   }
+
+   scene_segments_free(&segs);
+   scene_delete(sc);
+}
+
+int main(int argc, char**argv)
+{
+   const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_build),
+      cmocka_unit_test(test_brute_force),
+      cmocka_unit_test(test_segment_stack),
+      cmocka_unit_test(test_segment_hodoscope),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include "sphere/sphere.h"
+#include "gun/gun.h"
+#include "gun/gun_range.h"
+#include "strata/strata.h"
+
+static void test_plan(void **state)
+{
+   const int  divs[3] = { 2, 3, 1 };
+   strata_ctx st = strata_init(3, divs, 0, 42);
+   gun_ctx    ctx_x = gun_range_init(0.0, 1.0);
+   gun_ctx    ctx_y = gun_range_init(0.0, 1.0);
+   double     x[13], y[13];
+   double     *col_x = x, *col_y = y;
+   int        i, h;
+
+   assert_non_null(st);
+   assert_int_equal(6, strata_num(st));
+   assert_int_equal(1, strata_attach(st, ctx_x, 0));
+   assert_int_equal(2, strata_attach(st, ctx_y, 1));
+   assert_int_equal(-1, strata_attach(st, ctx_y, 3));
+
+   /* Less than 2 events per stratum */
+   assert_int_equal(-1, strata_plan(st, 11, 0));
+
+   /* 13 events: 3 in the first stratum, 2 in all others */
+   assert_int_equal(0, strata_plan(st, 13, 0));
+   assert_int_equal(0, gun_event_n(ctx_x, 13, &col_x));
+   assert_int_equal(0, gun_event_n(ctx_y, 13, &col_y));
+
+   for (i = 0; i < 13; ++i)
+   {
+      h = (i < 3) ? 0 : 1 + (i - 3)/2;
+
+      assert_true(floor(x[i]*2.0) == (double)(h % 2));
+      assert_true(floor(y[i]*3.0) == (double)(h / 2));
+      assert_int_equal(0, strata_tally(st, x[i]));
+   }
+
+   /* Pass is complete */
+   assert_int_equal(-1, strata_tally(st, 0.0));
+
+   gun_delete(ctx_x);
+   gun_delete(ctx_y);
+   strata_delete(st);
+}
+
+static void test_estimate(void **state)
+{
+   const int  n = 4000;
+   const int  divs[2] = { 8, 8 };
+   strata_ctx st = strata_init(2, divs, 1, 7);
+   gun_ctx    ctx_x = gun_range_init(0.0, 1.0);
+   gun_ctx    ctx_y = gun_range_init(0.0, 1.0);
+   double     x[4000], y[4000];
+   double     *col_x = x, *col_y = y;
+   double     mean, err, err_pilot;
+   int        i, pass;
+
+   strata_attach(st, ctx_x, 0);
+   strata_attach(st, ctx_y, 1);
+
+   /* Indicator of a disk: Only strata on its border have a variance */
+   for (pass = 0; pass < 2; ++pass)
+   {
+      assert_int_equal(0, strata_plan(st, n, pass));
+      gun_event_n(ctx_x, n, &col_x);
+      gun_event_n(ctx_y, n, &col_y);
+
+      for (i = 0; i < n; ++i)
+         strata_tally(st, (x[i]*x[i] + y[i]*y[i] < 1.0) ? 1.0 : 0.0);
+
+      assert_int_equal(0, strata_estimate(st, &mean, &err));
+      assert_true(fabs(mean - pi/4.0) < 4.0*err);
+
+      if (pass == 0)
+         err_pilot = err;
+   }
+
+   /* Far below plain sampling, sqrt(p (1-p) / n). Reallocation helps */
+   assert_true(err_pilot < 0.5 * sqrt(pi/4.0 * (1.0 - pi/4.0) / (double)n));
+   assert_true(err < 0.6 * err_pilot);
+
+   gun_delete(ctx_x);
+   gun_delete(ctx_y);
+   strata_delete(st);
+}
+
+int main(int argc, char**argv)
+{
+   const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_plan),
+      cmocka_unit_test(test_estimate),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -23,7 +23,9 @@
 
 #include <math.h>
 
-#include "vector/vector.h"
+/* The tests above call the exported functions, 'test_inline' the inline ones */
+#define VECTOR_NO_INLINE
+#include "vector/vector_inline.h"
 
 static void test_scale(void **state)
 {
@@ -146,6 +148,37 @@ static void test_mul_matrix(void **state)
    assert_true(fabs(out[2] - 1.0) < 1E-10);
 }
 
+static void test_inline(void **state)
+{
+   const vec3  a = { 0.3, -1.7, 2.9 };
+   const vec3  b = { -4.1, 0.01, 0.77 };
+   const mat33 M = { { 0.1, 0.2, -0.3 }, { 1.5, -2.5, 0.5 }, { 0.0, 3.0, 7.0 } };
+   vec3        r1, r2;
+
+   /* Bit for bit the exported results */
+   add_vec(r1, a, b);
+   add_vec_inline(r2, a, b);
+   assert_true((r1[0] == r2[0]) && (r1[1] == r2[1]) && (r1[2] == r2[2]));
+   diff_vec(r1, a, b);
+   diff_vec_inline(r2, a, b);
+   assert_true((r1[0] == r2[0]) && (r1[1] == r2[1]) && (r1[2] == r2[2]));
+   scale_vec2(r1, a, 1.3);
+   scale_vec2_inline(r2, a, 1.3);
+   assert_true((r1[0] == r2[0]) && (r1[1] == r2[1]) && (r1[2] == r2[2]));
+   scale_vec(r1, -0.7);
+   scale_vec_inline(r2, -0.7);
+   assert_true((r1[0] == r2[0]) && (r1[1] == r2[1]) && (r1[2] == r2[2]));
+   cross_vec(r1, a, b);
+   cross_vec_inline(r2, a, b);
+   assert_true((r1[0] == r2[0]) && (r1[1] == r2[1]) && (r1[2] == r2[2]));
+   mul_matrix(r1, M, a);
+   mul_matrix_inline(r2, M, a);
+   assert_true((r1[0] == r2[0]) && (r1[1] == r2[1]) && (r1[2] == r2[2]));
+   copy_vec_inline(r2, a);
+   assert_true((a[0] == r2[0]) && (a[1] == r2[1]) && (a[2] == r2[2]));
+   assert_true(dot_vec(a, b) == dot_vec_inline(a, b));
+}
+
 int main(int argc, char**argv)
 {
    const struct CMUnitTest tests[] = {
@@ -155,6 +188,7 @@ int main(int argc, char**argv)
       cmocka_unit_test(test_dot),
       cmocka_unit_test(test_cross),
       cmocka_unit_test(test_mul_matrix),
+      cmocka_unit_test(test_inline),
    };
 
    return cmocka_run_group_tests(tests, NULL, NULL);
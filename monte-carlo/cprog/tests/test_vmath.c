@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2024 Andreas H. Wolf
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "rng/rng.h"
+#include "vmath/vmath.h"
+
+/* Odd length, to run through the padded tail of the vector kernels */
+#define NUM_VALUES 10001
+
+static const char *kernels[] = { "scalar", "avx2", "avx512" };
+static const int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+static double x[NUM_VALUES];
+static double y[NUM_VALUES];
+static double z[NUM_VALUES];
+
+/* Distance of 'a' to the exact value 'r' in units in the last place of 'a' */
+static double ulp_error(double a, long double r)
+{
+   double d = (double)r;
+   double u = nextafter(fabs(d), INFINITY) - fabs(d);
+
+   return (double)(fabsl((long double)a - r) / u);
+}
+
+/* Uniform values in [lo,hi), or log uniform if 'expo' is set */
+static void fill(rng_stream *rng, double lo, double hi, int expo)
+{
+   int i;
+
+   rng_uniform_n(rng, NUM_VALUES, x);
+   for (i = 0; i < NUM_VALUES; ++i)
+      x[i] = expo ? exp(log(lo) + x[i]*(log(hi) - log(lo))) : lo + x[i]*(hi - lo);
+}
+
+static void test_log(void **state)
+{
+   rng_stream rng;
+   int        i, k;
+
+   rng_seed(&rng, 1, 0);
+   for (k = 0; k < num_kernels; ++k)
+   {
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      fill(&rng, 1E-300, 1E300, 1);
+      vmath_log(NUM_VALUES, x, y);
+      for (i = 0; i < NUM_VALUES; ++i)
+         assert_true(ulp_error(y[i], logl(x[i])) <= 1.0);
+
+      /* Near 1, where the result is small. In place */
+      fill(&rng, 0.5, 2.0, 0);
+      memcpy(z, x, sizeof(x));
+      vmath_log(NUM_VALUES, z, z);
+      for (i = 0; i < NUM_VALUES; ++i)
+         assert_true(ulp_error(z[i], logl(x[i])) <= 1.0);
+   }
+}
+
+static void test_cbrt(void **state)
+{
+   rng_stream rng;
+   int        i, k;
+
+   rng_seed(&rng, 2, 0);
+   for (k = 0; k < num_kernels; ++k)
+   {
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      fill(&rng, 1E-300, 1E300, 1);
+      for (i = 0; i < NUM_VALUES; i += 2)
+         x[i] = -x[i];
+      vmath_cbrt(NUM_VALUES, x, y);
+      for (i = 0; i < NUM_VALUES; ++i)
+         assert_true(ulp_error(y[i], cbrtl(x[i])) <= 1.0);
+
+      fill(&rng, 0.0, 1.0, 0);
+      vmath_cbrt(NUM_VALUES, x, y);
+      for (i = 0; i < NUM_VALUES; ++i)
+         assert_true(ulp_error(y[i], cbrtl(x[i])) <= 1.0);
+   }
+}
+
+static void test_sincos(void **state)
+{
+   rng_stream rng;
+   int        i, k;
+
+   rng_seed(&rng, 3, 0);
+   for (k = 0; k < num_kernels; ++k)
+   {
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      fill(&rng, -2.0*M_PI, 2.0*M_PI, 0);
+      vmath_sincos(NUM_VALUES, x, y, z);
+      for (i = 0; i < NUM_VALUES; ++i)
+      {
+         assert_true(ulp_error(y[i], sinl(x[i])) <= 2.0);
+         assert_true(ulp_error(z[i], cosl(x[i])) <= 2.0);
+      }
+
+      fill(&rng, -1E5, 1E5, 0);
+      vmath_sincos(NUM_VALUES, x, y, z);
+      for (i = 0; i < NUM_VALUES; ++i)
+      {
+         assert_true(ulp_error(y[i], sinl(x[i])) <= 3.0);
+         assert_true(ulp_error(z[i], cosl(x[i])) <= 3.0);
+      }
+   }
+}
+
+static void test_acos(void **state)
+{
+   rng_stream rng;
+   int        i, k;
+
+   rng_seed(&rng, 4, 0);
+   for (k = 0; k < num_kernels; ++k)
+   {
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      fill(&rng, -1.0, 1.0, 0);
+      vmath_acos(NUM_VALUES, x, y);
+      for (i = 0; i < NUM_VALUES; ++i)
+         assert_true(ulp_error(y[i], acosl(x[i])) <= 1.0);
+   }
+}
+
+static void test_special(void **state)
+{
+   const double in[] = { 0.0, -0.0, 1.0, -1.0, 4.9E-324, -8.0, 1E300, INFINITY, -INFINITY, NAN };
+   const int    num = sizeof(in) / sizeof(in[0]);
+   double       out[sizeof(in) / sizeof(in[0])];
+   double       out_c[sizeof(in) / sizeof(in[0])];
+   int          i, k;
+
+   for (k = 0; k < num_kernels; ++k)
+   {
+      if (0 != vmath_use(kernels[k]))
+         continue;
+
+      /* Outside of the kernel ranges the result of libm is taken over */
+      vmath_log(num, in, out);
+      for (i = 0; i < num; ++i)
+      {
+         double ref = log(in[i]);
+         assert_int_equal(0, memcmp(&out[i], &ref, sizeof(double)));
+      }
+
+      vmath_cbrt(num, in, out);
+      for (i = 0; i < num; ++i)
+         assert_true(ulp_error(out[i], cbrtl(in[i])) <= 1.0 || isnan(out[i]) || isinf(out[i])
+                     || (out[i] == in[i]));
+      assert_true(signbit(out[1]) && (out[5] == -2.0) && isnan(out[9]));
+
+      vmath_sincos(num, in, out, out_c);
+      for (i = 0; i < num; ++i)
+         assert_true(isnan(in[i]) || isinf(in[i])
+                     ? (isnan(out[i]) && isnan(out_c[i]))
+                     : (ulp_error(out[i], sinl(in[i])) <= 3.0) && (ulp_error(out_c[i], cosl(in[i])) <= 3.0));
+
+      vmath_acos(num, in, out);
+      assert_true((out[2] == 0.0) && (out[3] == acos(-1.0)) && isnan(out[5]) && isnan(out[9]));
+   }
+
+   assert_int_equal(-1, vmath_use("sse"));
+}
+
+int main(int argc, char**argv)
+{
+   const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_log),
+      cmocka_unit_test(test_cbrt),
+      cmocka_unit_test(test_sincos),
+      cmocka_unit_test(test_acos),
+      cmocka_unit_test(test_special),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}